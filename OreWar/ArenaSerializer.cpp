@@ -0,0 +1,804 @@
+#include "ArenaSerializer.h"
+#include "EventChannel.h"
+#include "MappedSnapshot.h"
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+/** The alignment of every table in a save */
+const size_t TABLE_ALIGNMENT = 8;
+
+/** @return The size of the passed table's records (0 for tables this version doesn't know) */
+unsigned int recordSize(unsigned int table)
+{
+	switch(table) {
+	case TABLE_ARENA:
+		return sizeof(ArenaRecord);
+	case TABLE_SHIPS:
+		return sizeof(ShipRecord);
+	case TABLE_WEAPONS:
+		return sizeof(WeaponRecord);
+	case TABLE_BODIES:
+		return sizeof(BodyRecord);
+	case TABLE_PROJECTILES:
+		return sizeof(ProjectileRecord);
+	case TABLE_CONSTRAINTS:
+		return sizeof(ConstraintRecord);
+	case TABLE_TIMERS:
+		return sizeof(TimerRecord);
+	case TABLE_ORBITS:
+		return sizeof(OrbitRecord);
+	case TABLE_GALAXY:
+		return sizeof(GalaxyRecord);
+	case TABLE_SECTORS:
+		return sizeof(SectorRecord);
+	case TABLE_PAGES:
+		return sizeof(PageRecord);
+	case TABLE_PAGED_BODIES:
+		return sizeof(BodyRecord);
+	}
+	return 0;
+}
+
+/** Appends a table of records to a save being built, recording it in the directory */
+template<class T>
+void appendTable(std::vector<char> & data, std::vector<TableEntry> & directory, ArenaTable table,
+	const std::vector<T> & records)
+{
+	data.resize((data.size() + TABLE_ALIGNMENT - 1) & ~(TABLE_ALIGNMENT - 1), 0);
+
+	TableEntry entry;
+	std::memset(&entry, 0, sizeof(entry));
+	entry.table = table;
+	entry.count = records.size();
+	entry.recordSize = sizeof(T);
+	entry.offset = data.size();
+	directory.push_back(entry);
+
+	if(!records.empty()) {
+		data.resize(data.size() + records.size() * sizeof(T));
+		std::memcpy(&data[(size_t)entry.offset], &records[0], records.size() * sizeof(T));
+	}
+}
+
+/** Copies a vector into a record's array */
+void writeVector(Real * out, const Vector3 & vector)
+{
+	out[0] = vector.x;
+	out[1] = vector.y;
+	out[2] = vector.z;
+}
+
+/** @return The vector held in a record's array */
+Vector3 readVector(const Real * in)
+{
+	return Vector3(in[0], in[1], in[2]);
+}
+
+/** Copies the state shared by every object into a record */
+void writeObject(const GameObject & object, ObjectRecord & record)
+{
+	std::memset(&record, 0, sizeof(record));
+	record.serial = object.phys()->serial();
+	record.type = object.type();
+
+	const TransformComponent & transform = object.phys()->transform();
+	writeVector(record.position, transform.position);
+	record.orientation[0] = transform.orientation.w;
+	record.orientation[1] = transform.orientation.x;
+	record.orientation[2] = transform.orientation.y;
+	record.orientation[3] = transform.orientation.z;
+
+	const PhysicsComponent & physics = object.phys()->physicsComponent();
+	record.lastStep = physics.lastStep;
+	writeVector(record.velocity, physics.velocity);
+	writeVector(record.acceleration, physics.acceleration);
+	writeVector(record.force, physics.force);
+	writeVector(record.tempForce, physics.tempForce);
+	record.mass = physics.mass;
+	record.radius = physics.radius;
+	record.idleTime = physics.idleTime;
+	record.asleep = physics.asleep;
+	record.kinematic = physics.kinematic;
+
+	const HealthComponent & health = object.healthComponent();
+	record.health = health.health;
+	record.maxHealth = health.maxHealth;
+	record.energy = health.energy;
+	record.maxEnergy = health.maxEnergy;
+	record.rechargeRate = health.rechargeRate;
+}
+
+/** Copies the components held in a record into an object */
+void readObject(const ObjectRecord & record, GameObject & object)
+{
+	TransformComponent & transform = object.phys()->transform();
+	transform.position = readVector(record.position);
+	transform.orientation = Quaternion(record.orientation[0], record.orientation[1],
+		record.orientation[2], record.orientation[3]);
+
+	PhysicsComponent & physics = object.phys()->physicsComponent();
+	physics.lastStep = (unsigned long)record.lastStep;
+	physics.velocity = readVector(record.velocity);
+	physics.acceleration = readVector(record.acceleration);
+	physics.force = readVector(record.force);
+	physics.tempForce = readVector(record.tempForce);
+	physics.mass = record.mass;
+	physics.radius = record.radius;
+	physics.idleTime = record.idleTime;
+	physics.asleep = record.asleep != 0;
+	physics.kinematic = record.kinematic != 0;
+
+	HealthComponent & health = object.healthComponent();
+	health.health = record.health;
+	health.maxHealth = record.maxHealth;
+	health.energy = record.energy;
+	health.maxEnergy = record.maxEnergy;
+	health.rechargeRate = record.rechargeRate;
+}
+
+/** Appends a record of a ship, and of each of its weapons */
+void writeShip(SpaceShip * ship, std::vector<ShipRecord> & ships, std::vector<WeaponRecord> & weapons)
+{
+	ShipRecord record;
+	writeObject(*ship, record.object);
+	record.numWeapons = ship->numWeapons();
+	record.padding = 0;
+	ships.push_back(record);
+
+	for(int i = 0; i < ship->numWeapons(); i++) {
+		WeaponRecord weaponRecord;
+		std::memset(&weaponRecord, 0, sizeof(weaponRecord));
+		const WeaponComponent & weapon = ship->weapon(i)->weaponComponent();
+		weaponRecord.reloadTime = weapon.reloadTime;
+		weaponRecord.lastShotCounter = weapon.lastShotCounter;
+		weaponRecord.energyCost = weapon.energyCost;
+		weaponRecord.canShoot = weapon.canShoot;
+
+		PlasmaCannon * cannon = dynamic_cast<PlasmaCannon *>(ship->weapon(i));
+		weaponRecord.kind = cannon != NULL ? WEAPON_PLASMA_CANNON : WEAPON_ANCHOR_LAUNCHER;
+		weaponRecord.shootLeft = cannon != NULL && cannon->shootLeft();
+		weapons.push_back(weaponRecord);
+	}
+}
+
+/** @return The position of a constraint in its origin's constraint list */
+int originIndex(Constraint * constraint)
+{
+	PhysicsObject * origin = constraint->getOrigin();
+	int index = 0;
+	for(Constraint * other = origin->constraints(); other != constraint; other = other->next(origin)) {
+		index++;
+	}
+	return index;
+}
+
+/** @return The position of a body in its center's satellite list (0 if it has no center) */
+int satelliteIndex(CelestialBody * body)
+{
+	if(body->center() == NULL) {
+		return 0;
+	}
+
+	int index = 0;
+	for(CelestialBody * other = body->center()->satellites(); other != body; other = other->nextSatellite()) {
+		index++;
+	}
+	return index;
+}
+
+/** Copies a body and its orbit into a record */
+void writeBody(CelestialBody * body, BodyRecord & record)
+{
+	std::memset(&record, 0, sizeof(record));
+	writeObject(*body, record.object);
+	record.center = body->center() != NULL ? body->center()->phys()->serial() : 0;
+	record.satelliteIndex = satelliteIndex(body);
+	record.radius = body->radius();
+	record.sector = body->sector();
+
+	const OrbitComponent & orbit = body->orbitComponent();
+	record.onRails = orbit.onRails;
+	writeVector(record.axisU, orbit.axisU);
+	writeVector(record.axisV, orbit.axisV);
+	record.distance = orbit.distance;
+	record.angularSpeed = orbit.angularSpeed;
+	record.epoch = orbit.epoch;
+	record.time = orbit.time;
+}
+
+/** @return The position of an object in its arena list (-1 for NULL) */
+int listIndex(const GameObject * object)
+{
+	return object != NULL ? object->arenaIndex() : -1;
+}
+
+/** @return The number of centers above a body */
+int orbitDepth(const CelestialBody * body)
+{
+	int depth = 0;
+	for(CelestialBody * center = body->center(); center != NULL; center = center->center()) {
+		depth++;
+	}
+	return depth;
+}
+
+/** A reference waiting to be fixed up, applied in order of descending list position */
+struct Link
+{
+	int index;
+	int listIndex;
+
+	bool operator<(const Link & other) const
+	{
+		if(listIndex != other.listIndex) {
+			return listIndex > other.listIndex;
+		}
+		return index < other.index;
+	}
+};
+
+
+// ========================================================================
+// ArenaSerializer Implementation
+// ========================================================================
+bool ArenaSerializer::validate(const char * data, size_t size)
+{
+	if(data == NULL || size < sizeof(ArenaHeader)) {
+		return false;
+	}
+
+	const ArenaHeader * header = reinterpret_cast<const ArenaHeader *>(data);
+	if(header->magic != MAGIC || header->version != VERSION || header->realSize != sizeof(Real)
+		|| header->numTables > (size - sizeof(ArenaHeader)) / sizeof(TableEntry))
+	{
+		return false;
+	}
+
+	const TableEntry * directory = reinterpret_cast<const TableEntry *>(data + sizeof(ArenaHeader));
+	for(unsigned int i = 0; i < header->numTables; i++) {
+		const TableEntry & entry = directory[i];
+		if(entry.offset % TABLE_ALIGNMENT != 0 || entry.offset > size
+			|| (unsigned long long)entry.count * entry.recordSize > size - entry.offset)
+		{
+			return false;
+		}
+
+		// Tables this version doesn't know are skipped, but known tables must match exactly
+		if(entry.table < NUM_ARENA_TABLES && entry.recordSize != recordSize(entry.table)) {
+			return false;
+		}
+	}
+
+	unsigned int count = 0;
+	return findTable(data, TABLE_ARENA, count) != NULL && count == 1;
+}
+
+const char * ArenaSerializer::findTable(const char * data, ArenaTable table, unsigned int & count)
+{
+	const ArenaHeader * header = reinterpret_cast<const ArenaHeader *>(data);
+	const TableEntry * directory = reinterpret_cast<const TableEntry *>(data + sizeof(ArenaHeader));
+	for(unsigned int i = 0; i < header->numTables; i++) {
+		if(directory[i].table == table) {
+			count = directory[i].count;
+			return data + directory[i].offset;
+		}
+	}
+
+	count = 0;
+	return NULL;
+}
+
+void ArenaSerializer::restoreObject(GameArena & arena, GameObject * object, const ObjectRecord & record,
+	bool attach)
+{
+	if(attach) {
+		object->attach(&arena.m_entities, arena.m_entities.createEntity());
+	}
+	object->phys()->serial((unsigned long)record.serial);
+	readObject(record, *object);
+
+	if(!arena.mp_eventChannels.empty()) {
+		arena.publishEvent(ArenaEvent(EVENT_OBJECT_SPAWNED, *object));
+	}
+	arena.notifyObjectCreation(object);
+}
+
+void ArenaSerializer::restoreBodies(GameArena & arena, const BodyRecord * records, unsigned int count,
+	std::map<unsigned long long, GameObject * > & objects)
+{
+	// Bodies are restored free standing, then placed in their centers' satellite lists
+	// (last first, so each list is rebuilt in its saved order)
+	unsigned int firstBody = arena.mp_bodies.size();
+	std::vector<Link> centerLinks;
+	for(unsigned int i = 0; i < count; i++) {
+		const BodyRecord & record = records[i];
+		CelestialBody * p_body = arena.m_memory.storeObject(CelestialBody((ObjectType)record.object.type,
+			record.object.mass, record.radius, readVector(record.object.position), arena.memoryManager()));
+		restoreObject(arena, p_body, record.object, true);
+		p_body->sector(record.sector);
+		p_body->arenaIndex(arena.mp_bodies.size());
+		arena.mp_bodies.push_back(p_body);
+		objects[record.object.serial] = p_body;
+
+		Link link = { (int)i, record.satelliteIndex };
+		centerLinks.push_back(link);
+	}
+
+	std::sort(centerLinks.begin(), centerLinks.end());
+	for(std::vector<Link>::iterator linkIter = centerLinks.begin();
+		linkIter != centerLinks.end();
+		linkIter++)
+	{
+		const BodyRecord & record = records[linkIter->index];
+		CelestialBody * p_body = arena.mp_bodies[firstBody + linkIter->index];
+		std::map<unsigned long long, GameObject * >::iterator center = objects.find(record.center);
+		if(record.center != 0 && center != objects.end() && center->second->type() >= STAR) {
+			p_body->center(static_cast<CelestialBody *>(center->second));
+		}
+
+		// The orbit (and the kinematic flag, which follows it) are restored once the center is set
+		OrbitComponent & orbit = p_body->orbitComponent();
+		orbit.onRails = record.onRails != 0;
+		orbit.axisU = readVector(record.axisU);
+		orbit.axisV = readVector(record.axisV);
+		orbit.distance = record.distance;
+		orbit.angularSpeed = record.angularSpeed;
+		orbit.epoch = record.epoch;
+		orbit.time = record.time;
+		p_body->phys()->physicsComponent().kinematic = record.object.kinematic != 0;
+	}
+	arena.m_sectorBodiesDirty = true;
+}
+
+void ArenaSerializer::saveBodies(const std::vector<CelestialBody *> & bodies, std::vector<char> & data)
+{
+	data.assign(bodies.size() * sizeof(BodyRecord), 0);
+	for(unsigned int i = 0; i < bodies.size(); i++) {
+		BodyRecord record;
+		writeBody(bodies[i], record);
+		std::memcpy(&data[i * sizeof(BodyRecord)], &record, sizeof(record));
+	}
+}
+
+void ArenaSerializer::loadBodies(GameArena & arena, const char * data, size_t size)
+{
+	// Centers which weren't saved with the bodies are looked for among the arena's bodies
+	std::map<unsigned long long, GameObject * > objects;
+	for(std::vector<CelestialBody * >::iterator bodyIter = arena.mp_bodies.begin();
+		bodyIter != arena.mp_bodies.end();
+		bodyIter++)
+	{
+		objects[(*bodyIter)->phys()->serial()] = *bodyIter;
+	}
+
+	unsigned int firstBody = arena.mp_bodies.size();
+	restoreBodies(arena, reinterpret_cast<const BodyRecord *>(data), size / sizeof(BodyRecord), objects);
+
+	for(unsigned int i = firstBody; i < arena.mp_bodies.size(); i++) {
+		CelestialBody * p_body = arena.mp_bodies[i];
+		if(p_body->hasCenter() && !p_body->onRails()) {
+			arena.addConstraint(p_body->constraint());
+		}
+	}
+}
+
+void ArenaSerializer::save(GameArena & arena, std::vector<char> & data)
+{
+	// Arena settings and simulation state
+	std::vector<ArenaRecord> arenaRecords(1);
+	ArenaRecord & arenaRecord = arenaRecords[0];
+	std::memset(&arenaRecord, 0, sizeof(arenaRecord));
+	arenaRecord.simTime = arena.m_simTime;
+	arenaRecord.stepCount = arena.m_stepCount;
+	arenaRecord.lastSerial = arena.m_lastSerial;
+	arenaRecord.worldRandom = arena.m_worldRandom.state();
+	arenaRecord.simRandom = arena.m_simRandom.state();
+	arenaRecord.size = arena.m_arenaSize;
+	arenaRecord.fixedStep = arena.m_fixedStep;
+	arenaRecord.stepAccumulator = arena.m_stepAccumulator;
+	arenaRecord.reducedTime = arena.m_reducedTime;
+	arenaRecord.npcRespawnDelay = arena.m_npcRespawnDelay;
+	arenaRecord.inputPitch = arena.m_playerInput.pitch;
+	arenaRecord.inputYaw = arena.m_playerInput.yaw;
+	arenaRecord.inputControls = arena.m_playerInput.controls();
+	arenaRecord.pendingRespawns = arena.m_pendingRespawns;
+	arenaRecord.npcShipTarget = arena.m_npcShipTarget;
+	arenaRecord.constraintIterations = arena.constraintIterations();
+	arenaRecord.analyticOrbits = arena.m_analyticOrbits;
+	arenaRecord.hasPlayerShip = arena.mp_playerShip != NULL;
+	arenaRecord.grapple = arena.mp_grapple != NULL ? arena.mp_grapple->arenaIndex() : -1;
+	for(int type = 0; type < NUM_OBJECT_TYPES; type++) {
+		arenaRecord.collisionMasks[type] = arena.m_collisionMatrix.mask((ObjectType)type);
+		if(arena.m_collisionMatrix.ownerCollides((ObjectType)type)) {
+			arenaRecord.ownerMask |= 1 << type;
+		}
+	}
+
+	// Ships and their weapons (the entity of each weapon is recorded, so reload timers can
+	// be matched to the weapon's ship and position)
+	std::vector<ShipRecord> ships;
+	std::vector<WeaponRecord> weapons;
+	std::map<EntityId, std::pair<unsigned long, int> > weaponOwners;
+	std::vector<SpaceShip * > allShips;
+	if(arena.mp_playerShip != NULL) {
+		allShips.push_back(arena.mp_playerShip);
+	}
+	allShips.insert(allShips.end(), arena.mp_npcShips.begin(), arena.mp_npcShips.end());
+	for(std::vector<SpaceShip * >::iterator shipIter = allShips.begin();
+		shipIter != allShips.end();
+		shipIter++)
+	{
+		writeShip(*shipIter, ships, weapons);
+		for(int i = 0; i < (*shipIter)->numWeapons(); i++) {
+			weaponOwners[(*shipIter)->weapon(i)->entity()] = std::make_pair((*shipIter)->phys()->serial(), i);
+		}
+	}
+
+	std::vector<BodyRecord> bodies;
+	std::vector<OrbitRecord> orbits;
+	for(std::vector<CelestialBody * >::iterator bodyIter = arena.mp_bodies.begin();
+		bodyIter != arena.mp_bodies.end();
+		bodyIter++)
+	{
+		CelestialBody * body = *bodyIter;
+		BodyRecord record;
+		writeBody(body, record);
+		bodies.push_back(record);
+
+		// Bodies are saved in arena order, so each pointer becomes its body's arena index
+		OrbitRecord orbitRecord;
+		orbitRecord.center = listIndex(body->center());
+		orbitRecord.firstSatellite = listIndex(body->satellites());
+		orbitRecord.nextSatellite = listIndex(body->nextSatellite());
+		orbitRecord.depth = orbitDepth(body);
+		orbits.push_back(orbitRecord);
+	}
+
+	std::vector<ProjectileRecord> projectiles;
+	for(std::vector<Projectile * >::iterator projIter = arena.mp_projectiles.begin();
+		projIter != arena.mp_projectiles.end();
+		projIter++)
+	{
+		Projectile * projectile = *projIter;
+		ProjectileRecord record;
+		std::memset(&record, 0, sizeof(record));
+		writeObject(*projectile, record.object);
+		record.owner = projectile->owner();
+		record.damage = projectile->damage();
+		record.slot = (unsigned int)(projectile->id() & 0xFFFFFFFF);
+
+		const LifetimeComponent & lifetime = projectile->lifetimeComponent();
+		record.lifeTime = lifetime.lifeTime;
+		record.elapsedTime = lifetime.elapsedTime;
+		record.expired = lifetime.expired;
+		projectiles.push_back(record);
+	}
+
+	std::vector<ConstraintRecord> constraints;
+	for(std::vector<Constraint * >::iterator conIter = arena.mp_constraints.begin();
+		conIter != arena.mp_constraints.end();
+		conIter++)
+	{
+		Constraint * constraint = *conIter;
+		ConstraintRecord record;
+		std::memset(&record, 0, sizeof(record));
+		record.origin = constraint->getOrigin()->serial();
+		record.target = constraint->getTarget()->serial();
+		record.distance = constraint->distance();
+		record.rigidSpeed = constraint->rigidSpeed();
+		record.rigid = constraint->isRigid();
+		record.originIndex = originIndex(constraint);
+		constraints.push_back(record);
+	}
+
+	// Only the galaxy's layout, the sectors already generated and the bodies of frozen sectors
+	// are saved, as the rest of it is generated from the seed
+	std::vector<GalaxyRecord> galaxies;
+	std::vector<SectorRecord> sectors;
+	std::vector<PageRecord> pages;
+	std::vector<BodyRecord> pagedBodies;
+	if(arena.m_galaxy.active()) {
+		GalaxyRecord record;
+		std::memset(&record, 0, sizeof(record));
+		record.seed = arena.m_galaxy.seed();
+		record.sectorsPerSide = arena.m_galaxy.sectorsPerSide();
+		record.sectorSize = arena.m_galaxy.sectorSize();
+		record.density = arena.m_galaxy.density();
+		record.generateRadius = arena.m_galaxy.generateRadius();
+		galaxies.push_back(record);
+
+		std::vector<char> page;
+		for(std::map<int, SectorState>::const_iterator sectorIter = arena.m_galaxy.sectors().begin();
+			sectorIter != arena.m_galaxy.sectors().end();
+			sectorIter++)
+		{
+			SectorRecord sector;
+			sector.sector = sectorIter->first;
+			sectors.push_back(sector);
+
+			if(sectorIter->second.activity != SECTOR_FROZEN || !arena.m_galaxy.page(sectorIter->first, page)) {
+				continue;
+			}
+			PageRecord pageRecord;
+			pageRecord.sector = sectorIter->first;
+			pageRecord.firstBody = pagedBodies.size();
+			pageRecord.numBodies = page.size() / sizeof(BodyRecord);
+			pageRecord.padding = 0;
+			pages.push_back(pageRecord);
+
+			const BodyRecord * records = reinterpret_cast<const BodyRecord *>(page.empty() ? NULL : &page[0]);
+			pagedBodies.insert(pagedBodies.end(), records, records + pageRecord.numBodies);
+		}
+	}
+
+	// Timers whose targets are already gone would be ignored when they fire, so are dropped
+	std::vector<TimerEvent> events;
+	arena.m_timers.pending(events);
+	std::vector<TimerRecord> timers;
+	for(std::vector<TimerEvent>::iterator eventIter = events.begin();
+		eventIter != events.end();
+		eventIter++)
+	{
+		TimerRecord record;
+		record.time = eventIter->time;
+		record.type = eventIter->type;
+		record.target = 0;
+		record.weapon = 0;
+		if(eventIter->type == TIMER_PROJECTILE_EXPIRY) {
+			Projectile * projectile = arena.m_projectilePool.get(eventIter->id);
+			if(projectile == NULL) {
+				continue;
+			}
+			record.target = projectile->phys()->serial();
+		} else if(eventIter->type == TIMER_WEAPON_RELOAD) {
+			std::map<EntityId, std::pair<unsigned long, int> >::iterator owner = weaponOwners.find(eventIter->id);
+			if(owner == weaponOwners.end()) {
+				continue;
+			}
+			record.target = owner->second.first;
+			record.weapon = owner->second.second;
+		}
+		timers.push_back(record);
+	}
+
+	// Lay out the header, directory and tables
+	std::vector<TableEntry> directory;
+	data.assign(sizeof(ArenaHeader) + NUM_ARENA_TABLES * sizeof(TableEntry), 0);
+	appendTable(data, directory, TABLE_ARENA, arenaRecords);
+	appendTable(data, directory, TABLE_SHIPS, ships);
+	appendTable(data, directory, TABLE_WEAPONS, weapons);
+	appendTable(data, directory, TABLE_BODIES, bodies);
+	appendTable(data, directory, TABLE_PROJECTILES, projectiles);
+	appendTable(data, directory, TABLE_CONSTRAINTS, constraints);
+	appendTable(data, directory, TABLE_TIMERS, timers);
+	appendTable(data, directory, TABLE_ORBITS, orbits);
+	appendTable(data, directory, TABLE_GALAXY, galaxies);
+	appendTable(data, directory, TABLE_SECTORS, sectors);
+	appendTable(data, directory, TABLE_PAGES, pages);
+	appendTable(data, directory, TABLE_PAGED_BODIES, pagedBodies);
+
+	ArenaHeader header;
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.realSize = sizeof(Real);
+	header.numTables = directory.size();
+	std::memcpy(&data[0], &header, sizeof(header));
+	std::memcpy(&data[sizeof(header)], &directory[0], directory.size() * sizeof(TableEntry));
+}
+
+bool ArenaSerializer::load(GameArena & arena, const char * data, size_t size)
+{
+	if(!validate(data, size)) {
+		return false;
+	}
+
+	arena.clear();
+	std::map<unsigned long long, GameObject * > objects;
+
+	// Arena settings and simulation state
+	unsigned int count = 0;
+	const ArenaRecord & arenaRecord = *reinterpret_cast<const ArenaRecord *>(findTable(data, TABLE_ARENA, count));
+	arena.m_simTime = arenaRecord.simTime;
+	arena.m_stepCount = (unsigned long)arenaRecord.stepCount;
+	arena.m_worldRandom.state(arenaRecord.worldRandom);
+	arena.m_simRandom.state(arenaRecord.simRandom);
+	arena.m_arenaSize = arenaRecord.size;
+	arena.m_fixedStep = arenaRecord.fixedStep;
+	arena.m_stepAccumulator = arenaRecord.stepAccumulator;
+	arena.m_reducedTime = arenaRecord.reducedTime;
+	arena.m_npcRespawnDelay = arenaRecord.npcRespawnDelay;
+	arena.m_pendingRespawns = arenaRecord.pendingRespawns;
+	arena.m_npcShipTarget = arenaRecord.npcShipTarget;
+	arena.m_analyticOrbits = arenaRecord.analyticOrbits != 0;
+	arena.constraintIterations(arenaRecord.constraintIterations);
+	arena.m_playerInput = PlayerInput();
+	arena.m_playerInput.controls(arenaRecord.inputControls);
+	arena.m_playerInput.pitch = arenaRecord.inputPitch;
+	arena.m_playerInput.yaw = arenaRecord.inputYaw;
+	for(int a = 0; a < NUM_OBJECT_TYPES; a++) {
+		for(int b = 0; b < NUM_OBJECT_TYPES; b++) {
+			arena.m_collisionMatrix.collides((ObjectType)a, (ObjectType)b,
+				(arenaRecord.collisionMasks[a] & (1 << b)) != 0);
+		}
+		arena.m_collisionMatrix.ownerCollides((ObjectType)a, (arenaRecord.ownerMask & (1 << a)) != 0);
+	}
+	arena.m_timers.reset(arena.m_simTime);
+
+	const GalaxyRecord * galaxy = reinterpret_cast<const GalaxyRecord *>(findTable(data, TABLE_GALAXY, count));
+	if(galaxy != NULL && count == 1) {
+		arena.m_galaxy.create(galaxy->seed, galaxy->sectorsPerSide, galaxy->sectorSize, galaxy->density);
+		arena.m_galaxy.generateRadius(galaxy->generateRadius);
+
+		const SectorRecord * sectors = reinterpret_cast<const SectorRecord *>(findTable(data, TABLE_SECTORS, count));
+		for(unsigned int i = 0; i < count; i++) {
+			arena.m_galaxy.markGenerated(sectors[i].sector);
+		}
+
+		// Frozen sectors are paged out again, rather than restored into the arena
+		unsigned int numPagedBodies = 0;
+		const BodyRecord * pagedBodies = reinterpret_cast<const BodyRecord *>(
+			findTable(data, TABLE_PAGED_BODIES, numPagedBodies));
+		const PageRecord * pages = reinterpret_cast<const PageRecord *>(findTable(data, TABLE_PAGES, count));
+		for(unsigned int i = 0; i < count; i++) {
+			if(pages[i].firstBody > numPagedBodies || pages[i].numBodies > numPagedBodies - pages[i].firstBody) {
+				continue;
+			}
+			const char * page = reinterpret_cast<const char *>(pagedBodies + pages[i].firstBody);
+			arena.m_galaxy.pageOut(pages[i].sector,
+				std::vector<char>(page, page + pages[i].numBodies * sizeof(BodyRecord)));
+		}
+	}
+
+	// Ships, with their weapons equipped before they are attached (so the weapons are given
+	// entities along with their ship)
+	unsigned int numWeapons = 0;
+	const WeaponRecord * weapons = reinterpret_cast<const WeaponRecord *>(findTable(data, TABLE_WEAPONS, numWeapons));
+	const ShipRecord * ships = reinterpret_cast<const ShipRecord *>(findTable(data, TABLE_SHIPS, count));
+	unsigned int nextWeapon = 0;
+	for(unsigned int i = 0; i < count; i++) {
+		const ObjectRecord & object = ships[i].object;
+		SpaceShip ship((ObjectType)object.type, object.mass, readVector(object.position),
+			object.rechargeRate, arena.memoryManager());
+		for(unsigned int j = 0; j < ships[i].numWeapons && nextWeapon < numWeapons; j++, nextWeapon++) {
+			const WeaponRecord & record = weapons[nextWeapon];
+			Weapon * weapon = NULL;
+			if(record.kind == WEAPON_PLASMA_CANNON) {
+				PlasmaCannon * cannon = ship.addPlasmaCannon(PlasmaCannon(arena.memoryManager()));
+				cannon->shootLeft(record.shootLeft != 0);
+				weapon = cannon;
+			} else {
+				weapon = ship.addAnchorLauncher(AnchorLauncher(arena.memoryManager()));
+			}
+
+			WeaponComponent & component = weapon->weaponComponent();
+			component.reloadTime = record.reloadTime;
+			component.lastShotCounter = record.lastShotCounter;
+			component.energyCost = record.energyCost;
+			component.canShoot = record.canShoot != 0;
+		}
+
+		SpaceShip * p_ship = arena.m_memory.storeObject(ship);
+		restoreObject(arena, p_ship, object, true);
+		if(i == 0 && arenaRecord.hasPlayerShip) {
+			arena.mp_playerShip = p_ship;
+		} else {
+			p_ship->arenaIndex(arena.mp_npcShips.size());
+			arena.mp_npcShips.push_back(p_ship);
+		}
+		objects[object.serial] = p_ship;
+	}
+
+	const BodyRecord * bodies = reinterpret_cast<const BodyRecord *>(findTable(data, TABLE_BODIES, count));
+	restoreBodies(arena, bodies, count, objects);
+
+	// Projectiles are returned to the pool slots they were saved from
+	const ProjectileRecord * projectiles = reinterpret_cast<const ProjectileRecord *>(
+		findTable(data, TABLE_PROJECTILES, count));
+	for(unsigned int i = 0; i < count; i++) {
+		const ProjectileRecord & record = projectiles[i];
+		Projectile projectile(SphereCollisionObject(record.object.radius, record.object.mass,
+			readVector(record.object.position)), (ObjectType)record.object.type, record.damage,
+			record.lifeTime, arena.memoryManager());
+		projectile.owner((unsigned long)record.owner);
+
+		PoolId id;
+		Projectile * p_projectile = arena.m_projectilePool.storeObjectAt(record.slot, projectile, &id);
+		if(p_projectile == NULL) {
+			continue;
+		}
+		p_projectile->id(id);
+		restoreObject(arena, p_projectile, record.object, false);
+
+		LifetimeComponent & lifetime = p_projectile->lifetimeComponent();
+		lifetime.elapsedTime = record.elapsedTime;
+		lifetime.expired = record.expired != 0;
+
+		p_projectile->arenaIndex(arena.mp_projectiles.size());
+		arena.mp_projectiles.push_back(p_projectile);
+		objects[record.object.serial] = p_projectile;
+	}
+
+	// Constraints are added in their saved order, then linked to their objects (last first
+	// in each origin's list, as for satellites)
+	const ConstraintRecord * constraints = reinterpret_cast<const ConstraintRecord *>(
+		findTable(data, TABLE_CONSTRAINTS, count));
+	std::vector<Link> constraintLinks;
+	for(unsigned int i = 0; i < count; i++) {
+		const ConstraintRecord & record = constraints[i];
+		std::map<unsigned long long, GameObject * >::iterator origin = objects.find(record.origin);
+		std::map<unsigned long long, GameObject * >::iterator target = objects.find(record.target);
+		if(origin == objects.end() || target == objects.end()) {
+			continue;
+		}
+
+		Constraint * p_constraint = arena.m_memory.storeObject(Constraint(origin->second->phys(),
+			target->second->phys(), record.rigid != 0, record.distance, record.rigidSpeed));
+		if((int)i == arenaRecord.grapple) {
+			arena.mp_grapple = p_constraint;
+		}
+
+		Link link = { (int)arena.mp_constraints.size(), record.originIndex };
+		constraintLinks.push_back(link);
+		p_constraint->arenaIndex(arena.mp_constraints.size());
+		arena.mp_constraints.push_back(p_constraint);
+		arena.notifyConstraintCreation(p_constraint);
+	}
+
+	std::sort(constraintLinks.begin(), constraintLinks.end());
+	for(std::vector<Link>::iterator linkIter = constraintLinks.begin();
+		linkIter != constraintLinks.end();
+		linkIter++)
+	{
+		arena.mp_constraints[linkIter->index]->link();
+	}
+	arena.m_solver.invalidate();
+
+	// Timers are scheduled in the order they are due, so ties keep their order
+	const TimerRecord * timers = reinterpret_cast<const TimerRecord *>(findTable(data, TABLE_TIMERS, count));
+	for(unsigned int i = 0; i < count; i++) {
+		const TimerRecord & record = timers[i];
+		unsigned long long id = 0;
+		if(record.type == TIMER_PROJECTILE_EXPIRY || record.type == TIMER_WEAPON_RELOAD) {
+			std::map<unsigned long long, GameObject * >::iterator target = objects.find(record.target);
+			if(target == objects.end()) {
+				continue;
+			}
+
+			ObjectType type = target->second->type();
+			if(record.type == TIMER_PROJECTILE_EXPIRY && (PROJECTILE_TYPES & (1 << type)) != 0) {
+				id = static_cast<Projectile *>(target->second)->id();
+			} else if(record.type == TIMER_WEAPON_RELOAD && (type == SHIP || type == NPC_SHIP)) {
+				SpaceShip * ship = static_cast<SpaceShip *>(target->second);
+				if(record.weapon < 0 || record.weapon >= ship->numWeapons()) {
+					continue;
+				}
+				id = ship->weapon(record.weapon)->entity();
+			} else {
+				continue;
+			}
+		}
+		arena.m_timers.schedule(record.time, record.type, id, NULL);
+	}
+
+	// Serials given from now on continue from the saved arena's
+	arena.m_lastSerial = (unsigned long)arenaRecord.lastSerial;
+	return true;
+}
+
+bool ArenaSerializer::saveFile(GameArena & arena, const std::string & fileName)
+{
+	std::vector<char> data;
+	save(arena, data);
+
+	std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(&data[0], data.size());
+	return file.good();
+}
+
+bool ArenaSerializer::loadFile(GameArena & arena, const std::string & fileName)
+{
+	MappedSnapshot snapshot;
+	return snapshot.open(fileName) && snapshot.restore(arena);
+}
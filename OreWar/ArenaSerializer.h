@@ -0,0 +1,401 @@
+#ifndef __ArenaSerializer_h_
+#define __ArenaSerializer_h_
+
+#include <vector>
+#include <map>
+#include <string>
+#include "GameObjects.h"
+
+using namespace Ogre;
+
+/**
+ * The kinds of table held in a saved arena (each an array of a single type of record). Tables
+ * may be added without changing the format's version, as loaders skip tables they don't know.
+ */
+enum ArenaTable {
+	/** A single ArenaRecord */
+	TABLE_ARENA,
+
+	/** A ShipRecord for the player's ship (if the arena has one), followed by every NPC ship */
+	TABLE_SHIPS,
+
+	/** A WeaponRecord for every weapon of every ship, in the order of the ships table */
+	TABLE_WEAPONS,
+
+	/** A BodyRecord for every celestial body */
+	TABLE_BODIES,
+
+	/** A ProjectileRecord for every projectile */
+	TABLE_PROJECTILES,
+
+	/** A ConstraintRecord for every constraint */
+	TABLE_CONSTRAINTS,
+
+	/** A TimerRecord for every pending timer, in the order they are due */
+	TABLE_TIMERS,
+
+	/** An OrbitRecord for every celestial body, in the order of the bodies table */
+	TABLE_ORBITS,
+
+	/** A single GalaxyRecord (empty if the arena has no galaxy) */
+	TABLE_GALAXY,
+
+	/** A SectorRecord for every sector of the galaxy whose system has been generated */
+	TABLE_SECTORS,
+
+	/** A PageRecord for every frozen sector of the galaxy */
+	TABLE_PAGES,
+
+	/** A BodyRecord for every body paged out of the arena, in the order of the pages table */
+	TABLE_PAGED_BODIES,
+
+	NUM_ARENA_TABLES
+};
+
+/** The kinds of weapon held in a WeaponRecord */
+enum WeaponKind { WEAPON_PLASMA_CANNON, WEAPON_ANCHOR_LAUNCHER };
+
+/** The header at the start of a saved arena, followed by its table directory */
+struct ArenaHeader
+{
+	/** Identifies the data as a saved arena (ArenaSerializer::MAGIC) */
+	unsigned int magic;
+
+	/** The version of the format the arena was saved in */
+	unsigned int version;
+
+	/** The size of a Real in the build which saved the arena (saves only load where it matches) */
+	unsigned int realSize;
+
+	/** The number of TableEntries in the directory */
+	unsigned int numTables;
+};
+
+/** An entry in the table directory of a saved arena */
+struct TableEntry
+{
+	/** The kind of table (see ArenaTable) */
+	unsigned int table;
+
+	/** The number of records in the table */
+	unsigned int count;
+
+	/** The size of each record (tables whose records have changed size are not loaded) */
+	unsigned int recordSize;
+
+	unsigned int padding;
+
+	/** The offset of the first record from the start of the save (a multiple of 8) */
+	unsigned long long offset;
+};
+
+/** The arena's settings and simulation state */
+struct ArenaRecord
+{
+	double simTime;
+	unsigned long long stepCount;
+	unsigned long long lastSerial;
+
+	/** The states of the world and simulation random streams */
+	unsigned long long worldRandom;
+	unsigned long long simRandom;
+
+	Real size;
+	Real fixedStep;
+	Real stepAccumulator;
+	Real npcRespawnDelay;
+
+	/** The unconsumed pitch and yaw of the player input */
+	Real inputPitch;
+	Real inputYaw;
+
+	int pendingRespawns;
+	int npcShipTarget;
+	int constraintIterations;
+
+	/** The player's grapple (its index in the constraints table, -1 if not grappling) */
+	int grapple;
+
+	/** The collision matrix's type mask for each ObjectType */
+	unsigned int collisionMasks[NUM_OBJECT_TYPES];
+
+	/** A type mask of the projectile types which can hit the object that fired them */
+	unsigned int ownerMask;
+
+	/** The held controls of the player input (see PlayerInput::controls()) */
+	unsigned int inputControls;
+
+	unsigned char analyticOrbits;
+
+	/** Non-zero if the first record of the ships table is the player's ship */
+	unsigned char hasPlayerShip;
+
+	unsigned char padding[2];
+
+	/** The time simulated since the dynamic bodies of reduced galaxy sectors were integrated */
+	Real reducedTime;
+};
+
+/** The state shared by every GameObject (its serial number, type and components) */
+struct ObjectRecord
+{
+	unsigned long long serial;
+	unsigned long long lastStep;
+
+	Real position[3];
+
+	/** The orientation quaternion (w, x, y, z) */
+	Real orientation[4];
+
+	Real velocity[3];
+	Real acceleration[3];
+	Real force[3];
+	Real tempForce[3];
+	Real mass;
+	Real radius;
+	Real idleTime;
+
+	Real health;
+	Real maxHealth;
+	Real energy;
+	Real maxEnergy;
+	Real rechargeRate;
+
+	int type;
+	unsigned char asleep;
+	unsigned char kinematic;
+	unsigned char padding[6];
+};
+
+/** A space ship (its weapons follow those of the previous ship in the weapons table) */
+struct ShipRecord
+{
+	ObjectRecord object;
+	unsigned int numWeapons;
+	unsigned int padding;
+};
+
+/** A weapon's kind and reload state */
+struct WeaponRecord
+{
+	Real reloadTime;
+	Real lastShotCounter;
+	Real energyCost;
+
+	/** The kind of weapon (see WeaponKind) */
+	unsigned int kind;
+
+	unsigned char canShoot;
+
+	/** Non-zero if a plasma cannon fires its next projectile from the left */
+	unsigned char shootLeft;
+
+	unsigned char padding[2];
+};
+
+/** A celestial body and its orbit */
+struct BodyRecord
+{
+	ObjectRecord object;
+	double epoch;
+	double time;
+
+	/** The serial number of the body's center (0 if it has none) */
+	unsigned long long center;
+
+	Real radius;
+	Real axisU[3];
+	Real axisV[3];
+	Real distance;
+	Real angularSpeed;
+
+	/** The body's position in its center's satellite list */
+	int satelliteIndex;
+
+	unsigned char onRails;
+	unsigned char padding[3];
+
+	/** The galaxy sector whose system the body belongs to (-1 for none) */
+	int sector;
+};
+
+/**
+ * A celestial body's place in the orbit hierarchy, as indices into the bodies table (-1 for
+ * none). Mirrors the bodies' center and satellite pointers, so the hierarchy can be walked
+ * in place in a mapped save (see MappedSnapshot) without resolving any serial numbers.
+ */
+struct OrbitRecord
+{
+	int center;
+	int firstSatellite;
+	int nextSatellite;
+
+	/** The number of centers above the body (0 for a free standing body) */
+	int depth;
+};
+
+/** The layout of the arena's galaxy (see Galaxy) */
+struct GalaxyRecord
+{
+	unsigned long long seed;
+	Real sectorSize;
+	Real density;
+	Real generateRadius;
+	int sectorsPerSide;
+};
+
+/** A sector of the galaxy whose system has been generated (so is not generated again) */
+struct SectorRecord
+{
+	int sector;
+};
+
+/** A frozen sector of the galaxy, whose bodies are paged out of the arena (see Galaxy::pageOut()) */
+struct PageRecord
+{
+	int sector;
+
+	/** The sector's first body in the paged bodies table */
+	unsigned int firstBody;
+
+	unsigned int numBodies;
+	unsigned int padding;
+};
+
+/** A projectile and its lifetime */
+struct ProjectileRecord
+{
+	ObjectRecord object;
+
+	/** The serial number of the object which fired the projectile (0 if it has none) */
+	unsigned long long owner;
+
+	Real damage;
+	Real lifeTime;
+	Real elapsedTime;
+
+	/** The projectile's slot in the projectile pool */
+	unsigned int slot;
+
+	unsigned char expired;
+	unsigned char padding[7];
+};
+
+/** A constraint between two objects */
+struct ConstraintRecord
+{
+	/** The serial numbers of the origin and target objects */
+	unsigned long long origin;
+	unsigned long long target;
+
+	Real distance;
+	Real rigidSpeed;
+
+	/** The constraint's position in its origin's constraint list */
+	int originIndex;
+
+	unsigned char rigid;
+	unsigned char padding[3];
+};
+
+/** A pending timer */
+struct TimerRecord
+{
+	double time;
+
+	/**
+	 * The serial number of the timer's target (the projectile to expire, or the ship whose
+	 * weapon reloads, 0 for respawns)
+	 */
+	unsigned long long target;
+
+	/** What the timer does (see TimerType) */
+	int type;
+
+	/** The index of the weapon to reload in its ship */
+	int weapon;
+};
+
+/**
+ * The ArenaSerializer class saves the complete state of a GameArena in a compact binary form,
+ * and restores it, so a running match can be checkpointed and continued later. An arena
+ * restored from a save and fed the same input reaches exactly the same state as the original.
+ *
+ * A save is an ArenaHeader and a directory of tables, each an array of fixed size records
+ * (in the machine's byte order) starting on an 8 byte boundary. Objects refer to each other
+ * by serial number. Loading is a single pass over the tables in dependency order, with each
+ * reference resolved through the objects already restored (except the centers of bodies,
+ * which are fixed up once every body exists). Object lists, constraint and satellite list
+ * order and projectile pool slots are all restored as they were, as update results depend
+ * on them.
+ *
+ * Arenas must only be saved or loaded between updates. Loading replaces every object in the
+ * arena (listeners and event channels see the old objects destroyed and the new ones
+ * created), and keeps the arena's worker threads, listeners and profiling settings.
+ */
+class ArenaSerializer
+{
+private:
+	/** Restores an object's serial number and components, and announces it to the arena */
+	static void restoreObject(GameArena & arena, GameObject * object, const ObjectRecord & record,
+		bool attach);
+
+	/**
+	 * Restores bodies to the end of the arena's body list, and links them to their centers
+	 * (found in objects, which the restored bodies are added to)
+	 */
+	static void restoreBodies(GameArena & arena, const BodyRecord * records, unsigned int count,
+		std::map<unsigned long long, GameObject * > & objects);
+
+public:
+	/** Identifies a saved arena ("OWAR") */
+	static const unsigned int MAGIC = 0x5241574F;
+
+	/** The version of the save format written */
+	static const unsigned int VERSION = 1;
+
+	/**
+	 * Checks the header and table directory of a save, so every table lies within the data.
+	 * Only the directory is read, so the cost doesn't depend on the size of the save.
+	 * @return True if the data is a valid save of this version
+	 */
+	static bool validate(const char * data, size_t size);
+
+	/** Saves the state of the arena, replacing the contents of data */
+	static void save(GameArena & arena, std::vector<char> & data);
+
+	/**
+	 * Restores an arena saved by save(), replacing everything in it. The data should be
+	 * 8 byte aligned (as any allocated buffer is).
+	 * @return True if the arena was loaded (the arena is untouched if the data is not a valid save)
+	 */
+	static bool load(GameArena & arena, const char * data, size_t size);
+
+	/**
+	 * Saves a set of bodies (such as those of a galaxy sector being paged out) as an array of
+	 * BodyRecords, replacing the contents of data. Centers outside the set are recorded by
+	 * serial number, and found again in the arena when the bodies are loaded.
+	 */
+	static void saveBodies(const std::vector<CelestialBody *> & bodies, std::vector<char> & data);
+
+	/**
+	 * Adds bodies saved by saveBodies() back into the arena, after its other bodies, with the
+	 * orbit constraints of those which aren't on rails
+	 */
+	static void loadBodies(GameArena & arena, const char * data, size_t size);
+
+	/** Saves the state of the arena to the named file @return True if the file was written */
+	static bool saveFile(GameArena & arena, const std::string & fileName);
+
+	/** Restores an arena from the named file, which is mapped rather than read @see ArenaSerializer::load() */
+	static bool loadFile(GameArena & arena, const std::string & fileName);
+
+	/**
+	 * Finds a table in a save which has been validated
+	 * @return The table's first record (NULL if the save has no such table), with the number
+	 *         of records stored in count
+	 */
+	static const char * findTable(const char * data, ArenaTable table, unsigned int & count);
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "ArenaSnapshot.h"
+#include <algorithm>
+
+// ========================================================================
+// ObjectState Implementation
+// ========================================================================
+ObjectState::ObjectState() : serial(0), type(ObjectType::SHIP), position(0, 0, 0), orientation(Quaternion::IDENTITY),
+	velocity(0, 0, 0), radius(0), health(0), maxHealth(0), energy(0), maxEnergy(0)
+{
+}
+
+ObjectState::ObjectState(GameObject & object) : serial(object.phys()->serial()), type(object.type()),
+	position(object.phys()->position()), orientation(object.phys()->orientation()),
+	velocity(object.phys()->velocity()), radius(object.phys()->radius()), health(object.health()),
+	maxHealth(object.maxHealth()), energy(object.energy()), maxEnergy(object.maxEnergy())
+{
+}
+
+Vector3 ObjectState::heading() const
+{
+	return orientation * Vector3(0, 0, -1);
+}
+
+Vector3 ObjectState::normal() const
+{
+	return orientation * Vector3(0, 1, 0);
+}
+
+bool ObjectState::operator<(const ObjectState & other) const
+{
+	return serial < other.serial;
+}
+
+
+// ========================================================================
+// ConstraintState Implementation
+// ========================================================================
+ConstraintState::ConstraintState() : key(0), origin(0, 0, 0), target(0, 0, 0), rigid(false)
+{
+}
+
+ConstraintState::ConstraintState(Constraint & constraint)
+	: key(((unsigned long long)constraint.getOrigin()->serial() << 32) | constraint.getTarget()->serial()),
+	origin(constraint.getOrigin()->position()), target(constraint.getTarget()->position()),
+	rigid(constraint.isRigid())
+{
+}
+
+bool ConstraintState::operator<(const ConstraintState & other) const
+{
+	return key < other.key;
+}
+
+
+// ========================================================================
+// ArenaSnapshot Implementation
+// ========================================================================
+ArenaSnapshot::ArenaSnapshot() : m_tick(0), m_time(0), m_objects(), m_constraints(), m_playerIndex(-1),
+	m_allocatedBytes(0), m_totalBytes(0)
+{
+}
+
+void ArenaSnapshot::capture(GameArena & arena, unsigned long tick)
+{
+	m_tick = tick;
+	m_time = arena.simTime();
+	m_allocatedBytes = arena.memoryManager()->allocatedBytes();
+	m_totalBytes = arena.memoryManager()->totalBytes();
+
+	m_objects.clear();
+	if(arena.playerShip() != NULL) {
+		m_objects.push_back(ObjectState(*arena.playerShip()));
+	}
+
+	for(std::vector<CelestialBody * >::iterator bodyIter = arena.bodies()->begin();
+		bodyIter != arena.bodies()->end();
+		bodyIter++)
+	{
+		m_objects.push_back(ObjectState(**bodyIter));
+	}
+
+	for(std::vector<SpaceShip * >::iterator shipIter = arena.npcShips()->begin();
+		shipIter != arena.npcShips()->end();
+		shipIter++)
+	{
+		m_objects.push_back(ObjectState(**shipIter));
+	}
+
+	for(std::vector<Projectile * >::iterator projIter = arena.projectiles()->begin();
+		projIter != arena.projectiles()->end();
+		projIter++)
+	{
+		m_objects.push_back(ObjectState(**projIter));
+	}
+
+	// The player's serial is looked up again once the list is sorted
+	unsigned long playerSerial = arena.playerShip() != NULL ? arena.playerShip()->phys()->serial() : 0;
+	std::sort(m_objects.begin(), m_objects.end());
+	m_playerIndex = -1;
+	if(playerSerial != 0) {
+		ObjectState playerState;
+		playerState.serial = playerSerial;
+		m_playerIndex = std::lower_bound(m_objects.begin(), m_objects.end(), playerState) - m_objects.begin();
+	}
+
+	m_constraints.clear();
+	for(std::vector<Constraint * >::iterator conIter = arena.constraints()->begin();
+		conIter != arena.constraints()->end();
+		conIter++)
+	{
+		m_constraints.push_back(ConstraintState(**conIter));
+	}
+	std::sort(m_constraints.begin(), m_constraints.end());
+}
+
+unsigned long ArenaSnapshot::tick() const
+{
+	return m_tick;
+}
+
+double ArenaSnapshot::time() const
+{
+	return m_time;
+}
+
+const std::vector<ObjectState> & ArenaSnapshot::objects() const
+{
+	return m_objects;
+}
+
+const std::vector<ConstraintState> & ArenaSnapshot::constraints() const
+{
+	return m_constraints;
+}
+
+const ObjectState * ArenaSnapshot::player() const
+{
+	return m_playerIndex >= 0 ? &m_objects[m_playerIndex] : NULL;
+}
+
+int ArenaSnapshot::allocatedBytes() const
+{
+	return m_allocatedBytes;
+}
+
+int ArenaSnapshot::totalBytes() const
+{
+	return m_totalBytes;
+}
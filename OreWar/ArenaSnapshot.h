@@ -0,0 +1,143 @@
+#ifndef __ArenaSnapshot_h_
+#define __ArenaSnapshot_h_
+
+#include <vector>
+#include <OgreVector3.h>
+#include <OgreQuaternion.h>
+#include "GameObjects.h"
+
+using namespace Ogre;
+
+/** The state of a GameObject needed to present it, copied from the arena at the end of a tick */
+struct ObjectState
+{
+	/** The object's serial number (identifies the object across snapshots) */
+	unsigned long serial;
+
+	ObjectType type;
+
+	Vector3 position;
+
+	Quaternion orientation;
+
+	Vector3 velocity;
+
+	/** The radius of the object's collision sphere */
+	Real radius;
+
+	Real health;
+
+	Real maxHealth;
+
+	Real energy;
+
+	Real maxEnergy;
+
+	/** Constructs an empty state */
+	ObjectState();
+
+	/** Copies the state of the passed object */
+	ObjectState(GameObject & object);
+
+	/** @return The heading of the object (see BaseObject::heading()) */
+	Vector3 heading() const;
+
+	/** @return The normal vector of the object (see BaseObject::normal()) */
+	Vector3 normal() const;
+
+	/** @return True if this state's object was added to the arena before the passed state's object */
+	bool operator<(const ObjectState & other) const;
+};
+
+/** The state of a Constraint needed to present it, copied from the arena at the end of a tick */
+struct ConstraintState
+{
+	/**
+	 * Identifies the constraint across snapshots (the serial numbers of its origin and
+	 * target objects, in the high and low 32 bits)
+	 */
+	unsigned long long key;
+
+	/** The position of the constraint's origin object */
+	Vector3 origin;
+
+	/** The position of the constraint's target object */
+	Vector3 target;
+
+	/** True if the constraint is rigid */
+	bool rigid;
+
+	/** Constructs an empty state */
+	ConstraintState();
+
+	/** Copies the state of the passed constraint */
+	ConstraintState(Constraint & constraint);
+
+	/** @return True if this state's key is below the passed state's key */
+	bool operator<(const ConstraintState & other) const;
+};
+
+/**
+ * The ArenaSnapshot class holds an immutable copy of everything needed to present a
+ * GameArena at the end of a tick. Snapshots are captured by the simulating thread and read
+ * by the rendering thread, which never touches the live arena. Objects and constraints
+ * are sorted by serial number and key, so consecutive snapshots can be matched in a
+ * single merging pass.
+ */
+class ArenaSnapshot
+{
+private:
+	/** The number of ticks simulated before the snapshot was captured */
+	unsigned long m_tick;
+
+	/** The arena time the snapshot was captured at */
+	double m_time;
+
+	/** The state of every object in the arena, sorted by serial number */
+	std::vector<ObjectState> m_objects;
+
+	/** The state of every constraint in the arena, sorted by key */
+	std::vector<ConstraintState> m_constraints;
+
+	/** The index of the player's ship in the object list (-1 if there is no player ship) */
+	int m_playerIndex;
+
+	/** The number of bytes allocated in the arena's memory pool */
+	int m_allocatedBytes;
+
+	/** The total size of the arena's memory pool (in bytes) */
+	int m_totalBytes;
+
+public:
+	/** Constructs an empty snapshot */
+	ArenaSnapshot();
+
+	/**
+	 * Replaces the snapshot's contents with the current state of the passed arena (the
+	 * snapshot's lists keep their capacity, so repeated captures rarely allocate)
+	 */
+	void capture(GameArena & arena, unsigned long tick);
+
+	/** @return The number of ticks simulated before the snapshot was captured */
+	unsigned long tick() const;
+
+	/** @return The arena time the snapshot was captured at */
+	double time() const;
+
+	/** @return The state of every object in the arena, sorted by serial number */
+	const std::vector<ObjectState> & objects() const;
+
+	/** @return The state of every constraint in the arena, sorted by key */
+	const std::vector<ConstraintState> & constraints() const;
+
+	/** @return The state of the player's ship (NULL if there is no player ship) */
+	const ObjectState * player() const;
+
+	/** @return The number of bytes allocated in the arena's memory pool */
+	int allocatedBytes() const;
+
+	/** @return The total size of the arena's memory pool (in bytes) */
+	int totalBytes() const;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "EntityStore.h"
+#include <OgreMath.h>
+#include <cmath>
+
+// ========================================================================
+// Component Implementations
+// ========================================================================
+TransformComponent::TransformComponent(const Vector3 & position, const Quaternion & orientation)
+	: position(position), orientation(orientation)
+{
+}
+
+PhysicsComponent::PhysicsComponent(Real mass, Real radius)
+	: mass(mass), radius(radius), velocity(0, 0, 0), acceleration(0, 0, 0), force(0, 0, 0),
+	tempForce(0, 0, 0), asleep(false), kinematic(false), idleTime(0), lastStep(0)
+{
+}
+
+HealthComponent::HealthComponent(Real maxHealth, Real maxEnergy, Real rechargeRate)
+	: health(maxHealth), maxHealth(maxHealth), energy(maxEnergy), maxEnergy(maxEnergy),
+	rechargeRate(rechargeRate)
+{
+}
+
+WeaponComponent::WeaponComponent(Real reloadTime, Real energyCost)
+	: reloadTime(reloadTime), lastShotCounter(reloadTime), energyCost(energyCost), canShoot(true)
+{
+}
+
+LifetimeComponent::LifetimeComponent(Real lifeTime) : lifeTime(lifeTime), elapsedTime(0), expired(false)
+{
+}
+
+OrbitComponent::OrbitComponent() : center(NULL_ENTITY), onRails(false), axisU(0, 0, 0), axisV(0, 0, 0),
+	distance(0), angularSpeed(0), epoch(0), time(-1)
+{
+}
+
+Real OrbitComponent::angle(double time) const
+{
+	return Real(fmod(angularSpeed * (time - epoch), 6.283185307179586));
+}
+
+
+// ========================================================================
+// EntityStore Implementation
+// ========================================================================
+EntityStore::EntityStore() : m_freeIndices(), m_generations(), m_transforms(), m_physics(), m_health(),
+	m_weapons(), m_lifetimes(), m_orbits()
+{
+}
+
+EntityId EntityStore::createEntity()
+{
+	unsigned int index;
+	if(!m_freeIndices.empty()) {
+		index = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	} else {
+		index = m_generations.size();
+		m_generations.push_back(0);
+	}
+
+	return ((EntityId)m_generations[index] << 32) | (EntityId)index;
+}
+
+void EntityStore::destroyEntity(EntityId entity)
+{
+	if(!alive(entity)) {
+		return;
+	}
+
+	m_transforms.remove(entity);
+	m_physics.remove(entity);
+	m_health.remove(entity);
+	m_weapons.remove(entity);
+	m_lifetimes.remove(entity);
+	m_orbits.remove(entity);
+	m_generations[entityIndex(entity)]++;
+	m_freeIndices.push_back(entityIndex(entity));
+}
+
+bool EntityStore::alive(EntityId entity) const
+{
+	unsigned int index = entityIndex(entity);
+	return index < m_generations.size() && m_generations[index] == (unsigned int)(entity >> 32);
+}
+
+int EntityStore::numEntities() const
+{
+	return m_generations.size() - m_freeIndices.size();
+}
+
+ComponentArray<TransformComponent> & EntityStore::transforms()
+{
+	return m_transforms;
+}
+
+ComponentArray<PhysicsComponent> & EntityStore::physics()
+{
+	return m_physics;
+}
+
+ComponentArray<HealthComponent> & EntityStore::health()
+{
+	return m_health;
+}
+
+ComponentArray<WeaponComponent> & EntityStore::weapons()
+{
+	return m_weapons;
+}
+
+ComponentArray<LifetimeComponent> & EntityStore::lifetimes()
+{
+	return m_lifetimes;
+}
+
+ComponentArray<OrbitComponent> & EntityStore::orbits()
+{
+	return m_orbits;
+}
+
+void EntityStore::rechargeSystem(Real timeElapsed)
+{
+	for(int i = 0; i < m_health.size(); i++) {
+		HealthComponent & health = m_health.at(i);
+		if(health.rechargeRate == 0) {
+			continue;
+		}
+
+		health.energy = health.rechargeRate * timeElapsed + health.energy;
+		if(health.energy > health.maxEnergy) {
+			health.energy = health.maxEnergy;
+		}
+	}
+}
+
+void EntityStore::orbitSystem(double time)
+{
+	for(int i = 0; i < m_orbits.size(); i++) {
+		evaluateOrbit(m_orbits.entity(i), time);
+	}
+}
+
+void EntityStore::evaluateOrbit(EntityId entity, double time)
+{
+	OrbitComponent * orbit = m_orbits.get(entity);
+	if(orbit == NULL || !orbit->onRails || orbit->center == NULL_ENTITY || orbit->time == time) {
+		return;
+	}
+
+	// The center must be placed first, since the orbit is relative to it
+	evaluateOrbit(orbit->center, time);
+
+	Real angle = orbit->angle(time);
+	Real cosAngle = Math::Cos(angle);
+	Real sinAngle = Math::Sin(angle);
+	const TransformComponent * centerTransform = m_transforms.get(orbit->center);
+	const PhysicsComponent * centerPhysics = m_physics.get(orbit->center);
+	TransformComponent * transform = m_transforms.get(entity);
+	PhysicsComponent * physics = m_physics.get(entity);
+
+	transform->position = centerTransform->position +
+		(orbit->axisU * cosAngle + orbit->axisV * sinAngle) * orbit->distance;
+	physics->velocity = centerPhysics->velocity +
+		(orbit->axisV * cosAngle - orbit->axisU * sinAngle) * (orbit->distance * orbit->angularSpeed);
+
+	// Moving entities are kept awake (as when setting a PhysicsObject's velocity)
+	if(physics->velocity != Vector3::ZERO) {
+		physics->asleep = false;
+		physics->idleTime = 0;
+	}
+	orbit->time = time;
+}
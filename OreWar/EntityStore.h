@@ -0,0 +1,348 @@
+#ifndef __EntityStore_h_
+#define __EntityStore_h_
+
+#include <vector>
+#include <OgreVector3.h>
+#include <OgreQuaternion.h>
+
+using namespace Ogre;
+
+/**
+ * Identifies an entity in an EntityStore. The low 32 bits hold the entity's index, and the
+ * high 32 bits the generation of the index when the entity was created, so an id held after
+ * its entity is destroyed is never mistaken for a later entity reusing the same index.
+ */
+typedef unsigned long long EntityId;
+
+/** The id of no entity (held by objects which are not stored in an EntityStore) */
+const EntityId NULL_ENTITY = 0xFFFFFFFFFFFFFFFFULL;
+
+/** @return The index of the passed entity (its position in the sparse index of a ComponentArray) */
+inline unsigned int entityIndex(EntityId entity)
+{
+	return (unsigned int)(entity & 0xFFFFFFFF);
+}
+
+/** The position and orientation of an entity */
+struct TransformComponent
+{
+	/** The current position of the entity */
+	Vector3 position;
+
+	/** The current orientation of the entity (as a rotation from the base <0, 0, -1> heading) */
+	Quaternion orientation;
+
+	/** Constructor */
+	TransformComponent(const Vector3 & position, const Quaternion & orientation);
+};
+
+/** The simulated motion of an entity (integrated by the physics system) */
+struct PhysicsComponent
+{
+	/** The mass of the entity */
+	Real mass;
+
+	/** The radius of the entity's collision sphere (0 if it has none) */
+	Real radius;
+
+	Vector3 velocity;
+
+	Vector3 acceleration;
+
+	/** The sum of all persistent forces applied on the entity */
+	Vector3 force;
+
+	/** The sum of all temporary forces applied on the entity (cleared on each integration) */
+	Vector3 tempForce;
+
+	/** True if the entity is at rest and should not be integrated until woken */
+	bool asleep;
+
+	/** True if the entity is moved by another system, and should never be integrated */
+	bool kinematic;
+
+	/** The amount of time the entity has spent below the sleep threshold */
+	Real idleTime;
+
+	/** The number of the last physics update which integrated the entity */
+	unsigned long lastStep;
+
+	/** Constructor */
+	PhysicsComponent(Real mass, Real radius);
+};
+
+/** The health and energy of an entity */
+struct HealthComponent
+{
+	Real health;
+
+	Real maxHealth;
+
+	Real energy;
+
+	Real maxEnergy;
+
+	/** The energy regained per second */
+	Real rechargeRate;
+
+	/** Constructor */
+	HealthComponent(Real maxHealth, Real maxEnergy, Real rechargeRate);
+};
+
+/** The reload state of a weapon */
+struct WeaponComponent
+{
+	/** The time which should elapse between projectile generations */
+	Real reloadTime;
+
+	/** 
+	 * The time which has elapsed since the last projectile generation. Only advanced for
+	 * weapons outside a GameArena, as the arena reloads weapons with a timer instead.
+	 */
+	Real lastShotCounter;
+
+	/** The energy drained from the owner by each shot */
+	Real energyCost;
+
+	/** True if the weapon is loaded */
+	bool canShoot;
+
+	/** Constructs a loaded weapon */
+	WeaponComponent(Real reloadTime, Real energyCost);
+};
+
+/** The limited lifetime of an entity */
+struct LifetimeComponent
+{
+	/** The total amount of time the entity should exist for */
+	Real lifeTime;
+
+	/** 
+	 * The amount of time elapsed toward the entity's lifetime. Only advanced for entities
+	 * outside a GameArena, as the arena expires entities with a timer instead.
+	 */
+	Real elapsedTime;
+
+	/** True once the entity's lifetime has been reached */
+	bool expired;
+
+	/** Constructor */
+	LifetimeComponent(Real lifeTime);
+};
+
+/** The orbital elements of an entity orbiting another */
+struct OrbitComponent
+{
+	/** The entity orbited (NULL_ENTITY if the entity is free standing) */
+	EntityId center;
+
+	/** True if the orbit is evaluated analytically rather than simulated */
+	bool onRails;
+
+	/** Unit vector from the center to the entity at the orbit epoch */
+	Vector3 axisU;
+
+	/** Unit vector in the direction of orbital motion at the orbit epoch */
+	Vector3 axisV;
+
+	/** The center to center distance of the orbit */
+	Real distance;
+
+	/** The angular speed of the orbit (in radians per second) */
+	Real angularSpeed;
+
+	/** The arena time at which the entity was at axisU from its center */
+	double epoch;
+
+	/** The arena time the orbit was last evaluated for (avoids re-evaluating shared centers) */
+	double time;
+
+	/** Constructs an orbit around no center */
+	OrbitComponent();
+
+	/**
+	 * @return The angle (in radians, within one revolution) swept from axisU by the passed
+	 * arena time. The angle is reduced in double precision, so it stays accurate however
+	 * long the arena has been running.
+	 */
+	Real angle(double time) const;
+};
+
+/**
+ * The ComponentArray class stores one type of component for any number of entities
+ * as a sparse set. Components are kept densely packed (in no particular order) so that
+ * systems can iterate them linearly, while a sparse index maps each entity to its
+ * component. Removal moves the last component into the freed slot, so indices into the
+ * dense array are only stable until the next removal.
+ */
+template <class T>
+class ComponentArray
+{
+private:
+	/** The components, densely packed */
+	std::vector<T> m_components;
+
+	/** The entity owning each component */
+	std::vector<EntityId> m_entities;
+
+	/** For each entity index, the index of its component (-1 if it has none) */
+	std::vector<int> m_indices;
+
+public:
+	/** Constructs an empty ComponentArray */
+	ComponentArray() : m_components(), m_entities(), m_indices()
+	{
+	}
+
+	/**
+	 * Adds a copy of the passed component for an entity (replacing any it already has)
+	 * @return A pointer to the stored component, valid until the array next changes size
+	 */
+	T * add(EntityId entity, const T & component)
+	{
+		unsigned int index = entityIndex(entity);
+		if(index >= m_indices.size()) {
+			m_indices.resize(index + 1, -1);
+		}
+
+		if(m_indices[index] >= 0) {
+			m_components[m_indices[index]] = component;
+			m_entities[m_indices[index]] = entity;
+		} else {
+			m_indices[index] = m_components.size();
+			m_components.push_back(component);
+			m_entities.push_back(entity);
+		}
+		return &m_components[m_indices[index]];
+	}
+
+	/** Removes an entity's component (if it has one) */
+	void remove(EntityId entity)
+	{
+		if(!has(entity)) {
+			return;
+		}
+
+		int index = m_indices[entityIndex(entity)];
+		int lastIndex = m_components.size() - 1;
+		if(index != lastIndex) {
+			m_components[index] = m_components[lastIndex];
+			m_entities[index] = m_entities[lastIndex];
+			m_indices[entityIndex(m_entities[index])] = index;
+		}
+		m_components.pop_back();
+		m_entities.pop_back();
+		m_indices[entityIndex(entity)] = -1;
+	}
+
+	/** @return True if the entity has a component in this array (never true for a stale id) */
+	bool has(EntityId entity) const
+	{
+		unsigned int index = entityIndex(entity);
+		return index < m_indices.size() && m_indices[index] >= 0 && m_entities[m_indices[index]] == entity;
+	}
+
+	/** @return The entity's component (NULL if it has none) */
+	T * get(EntityId entity)
+	{
+		return has(entity) ? &m_components[m_indices[entityIndex(entity)]] : NULL;
+	}
+
+	/** @return The entity's component (NULL if it has none) */
+	const T * get(EntityId entity) const
+	{
+		return has(entity) ? &m_components[m_indices[entityIndex(entity)]] : NULL;
+	}
+
+	/** @return The number of components stored */
+	int size() const
+	{
+		return m_components.size();
+	}
+
+	/** @return The component at the passed index in the dense array */
+	T & at(int index)
+	{
+		return m_components[index];
+	}
+
+	/** @return The component at the passed index in the dense array */
+	const T & at(int index) const
+	{
+		return m_components[index];
+	}
+
+	/** @return The entity owning the component at the passed index in the dense array */
+	EntityId entity(int index) const
+	{
+		return m_entities[index];
+	}
+
+	/** Removes all components */
+	void clear()
+	{
+		m_components.clear();
+		m_entities.clear();
+		m_indices.clear();
+	}
+};
+
+/**
+ * The EntityStore class holds the hot state of every entity in a GameArena, split by
+ * component type into dense arrays. Game object classes act as facades over their
+ * entity's components once they are attached to a store, and systems update the
+ * components of all entities with linear passes over the arrays.
+ */
+class EntityStore
+{
+private:
+	/** Indices of destroyed entities, available for reuse */
+	std::vector<unsigned int> m_freeIndices;
+
+	/** The current generation of each entity index (incremented whenever its entity is destroyed) */
+	std::vector<unsigned int> m_generations;
+
+	ComponentArray<TransformComponent> m_transforms;
+	ComponentArray<PhysicsComponent> m_physics;
+	ComponentArray<HealthComponent> m_health;
+	ComponentArray<WeaponComponent> m_weapons;
+	ComponentArray<LifetimeComponent> m_lifetimes;
+	ComponentArray<OrbitComponent> m_orbits;
+
+public:
+	/** Constructs an empty EntityStore */
+	EntityStore();
+
+	/** @return The id of a new entity with no components */
+	EntityId createEntity();
+
+	/** Removes all of an entity's components, and releases its index for reuse */
+	void destroyEntity(EntityId entity);
+
+	/** @return True if the passed entity has been created and not yet destroyed */
+	bool alive(EntityId entity) const;
+
+	/** @return The number of live entities */
+	int numEntities() const;
+
+	ComponentArray<TransformComponent> & transforms();
+	ComponentArray<PhysicsComponent> & physics();
+	ComponentArray<HealthComponent> & health();
+	ComponentArray<WeaponComponent> & weapons();
+	ComponentArray<LifetimeComponent> & lifetimes();
+	ComponentArray<OrbitComponent> & orbits();
+
+	/** Adds the recharge rate of every entity to its energy over the passed time */
+	void rechargeSystem(Real timeElapsed);
+
+	/**
+	 * Places every entity with an analytic orbit at its closed form position and
+	 * velocity for the passed arena time (centers are placed before their satellites).
+	 */
+	void orbitSystem(double time);
+
+	/** Places a single orbiting entity (and its centers) for the passed arena time */
+	void evaluateOrbit(EntityId entity, double time);
+};
+
+#endif
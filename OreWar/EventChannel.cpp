@@ -0,0 +1,124 @@
+#include "EventChannel.h"
+
+// ========================================================================
+// ArenaEvent Implementation
+// ========================================================================
+ArenaEvent::ArenaEvent() : type(EVENT_OBJECT_SPAWNED), objectType(ObjectType::SHIP), serial(0), otherSerial(0),
+	position(0, 0, 0), amount(0)
+{
+}
+
+ArenaEvent::ArenaEvent(ArenaEventType type, GameObject & object) : type(type), objectType(object.type()),
+	serial(object.phys()->serial()), otherSerial(0), position(object.phys()->position()), amount(0)
+{
+}
+
+ArenaEvent::ArenaEvent(ArenaEventType type, Constraint & constraint) : type(type), objectType(ObjectType::SHIP),
+	serial(constraint.getOrigin()->serial()), otherSerial(constraint.getTarget()->serial()),
+	position(constraint.getOrigin()->position()), amount(0)
+{
+}
+
+
+// ========================================================================
+// EventChannel Implementation
+// ========================================================================
+EventChannel::Slot::Slot() : sequence(0), event()
+{
+}
+
+EventChannel::EventChannel(int capacity) : m_slots(), m_mask(0), m_writePos(0), m_readPos(0),
+	m_pushed(0), m_dropped(0), m_highWater(0)
+{
+	unsigned long size = 1;
+	while(size < (unsigned long)capacity) {
+		size <<= 1;
+	}
+	m_slots.resize(size, Slot());
+	m_mask = size - 1;
+
+	// Slot i is first free to be written at position i
+	for(unsigned long i = 0; i < size; i++) {
+		m_slots[i].sequence.set(i);
+	}
+}
+
+bool EventChannel::push(const ArenaEvent & event)
+{
+	unsigned long pos = m_writePos.get();
+	Slot * slot = NULL;
+	while(true) {
+		slot = &m_slots[pos & m_mask];
+		long diff = (long)(slot->sequence.get() - pos);
+		if(diff == 0) {
+			// The slot is free, claim it by moving the write position past it
+			if(m_writePos.cas(pos, pos + 1)) {
+				break;
+			}
+			pos = m_writePos.get();
+		} else if(diff < 0) {
+			// The slot still holds the event pushed a lap ago, so the ring is full
+			m_dropped++;
+			return false;
+		} else {
+			// Another pusher claimed the slot first
+			pos = m_writePos.get();
+		}
+	}
+
+	slot->event = event;
+	slot->sequence.set(pos + 1);
+	m_pushed++;
+
+	// Record the deepest the ring has been (the popper may already have passed the event)
+	long depth = (long)(pos + 1 - m_readPos.get());
+	unsigned long highWater = m_highWater.get();
+	while(depth > (long)highWater && !m_highWater.cas(highWater, (unsigned long)depth)) {
+		highWater = m_highWater.get();
+	}
+	return true;
+}
+
+bool EventChannel::pop(ArenaEvent & event)
+{
+	unsigned long pos = m_readPos.get();
+	Slot & slot = m_slots[pos & m_mask];
+	if((long)(slot.sequence.get() - (pos + 1)) < 0) {
+		// The slot has not been written (or is still being written)
+		return false;
+	}
+
+	event = slot.event;
+
+	// Free the slot to be written on the ring's next lap (after moving the read position,
+	// so pushers never see more than a full ring waiting)
+	m_readPos.set(pos + 1);
+	slot.sequence.set(pos + m_mask + 1);
+	return true;
+}
+
+int EventChannel::size() const
+{
+	long size = (long)(m_writePos.get() - m_readPos.get());
+	return size < 0 ? 0 : (int)size;
+}
+
+int EventChannel::capacity() const
+{
+	return m_slots.size();
+}
+
+unsigned long EventChannel::pushed() const
+{
+	return m_pushed.get();
+}
+
+unsigned long EventChannel::dropped() const
+{
+	return m_dropped.get();
+}
+
+unsigned long EventChannel::highWater() const
+{
+	return m_highWater.get();
+}
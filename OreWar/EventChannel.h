@@ -0,0 +1,171 @@
+#ifndef __EventChannel_h_
+#define __EventChannel_h_
+
+#include <vector>
+#include <OgreVector3.h>
+#include <OgreAtomicWrappers.h>
+#include "GameObjects.h"
+
+using namespace Ogre;
+
+/**
+ * Enumeration of the kinds of event published by a GameArena to its EventChannels
+ */
+enum ArenaEventType {
+	/** An object was added to the arena */
+	EVENT_OBJECT_SPAWNED,
+
+	/** An object was removed from the arena */
+	EVENT_OBJECT_DESTROYED,
+
+	/** A constraint was added to the arena (the serial is its origin's, the other serial its target's) */
+	EVENT_CONSTRAINT_ADDED,
+
+	/** A constraint was removed from the arena (serials as EVENT_CONSTRAINT_ADDED) */
+	EVENT_CONSTRAINT_REMOVED,
+
+	/** An object took damage (the amount is the damage, the other serial the object which dealt it) */
+	EVENT_DAMAGE_TAKEN,
+
+	/** A celestial body detonated into chunks (the amount is the body's radius) */
+	EVENT_BODY_DETONATED,
+
+	NUM_EVENT_TYPES
+};
+
+/**
+ * A single event published by a GameArena. Events are plain copies of the state involved,
+ * so they can be read on any thread long after the objects they describe are gone.
+ */
+struct ArenaEvent
+{
+	ArenaEventType type;
+
+	/** The type of the object (unused for constraint events) */
+	ObjectType objectType;
+
+	/** The serial number of the object (see BaseObject::serial()) */
+	unsigned long serial;
+
+	/** The serial number of a second object involved in the event (0 if there is none) */
+	unsigned long otherSerial;
+
+	/** The position of the object when the event happened */
+	Vector3 position;
+
+	/** An amount associated with the event (see ArenaEventType) */
+	Real amount;
+
+	/** Constructs an empty event */
+	ArenaEvent();
+
+	/** Constructs an event of the passed type involving the passed object */
+	ArenaEvent(ArenaEventType type, GameObject & object);
+
+	/** Constructs an event of the passed type involving the passed constraint */
+	ArenaEvent(ArenaEventType type, Constraint & constraint);
+};
+
+/**
+ * The EventChannel class carries ArenaEvents from the simulating thread to a consumer on
+ * another thread (e.g. rendering or audio) without locks or allocations.
+ *
+ * Events are stored in a fixed ring of slots, allocated once when the channel is created.
+ * Any number of threads may push events, but only one thread may pop them. Each slot holds
+ * a sequence number which tells pushers and the popper whether it is free or filled, so
+ * the only contended write is a compare-and-swap on the write position.
+ *
+ * The simulation never waits for a consumer. If the ring is full when an event is pushed
+ * the event is dropped, and counted, so a consumer which falls behind can be detected from
+ * the channel's back-pressure metrics (dropped() and highWater()).
+ */
+class EventChannel
+{
+private:
+	/** A slot in the ring */
+	struct Slot
+	{
+		/**
+		 * The position the slot is next free to be written at. Once written it holds the
+		 * write position plus one, until the event is popped.
+		 */
+		AtomicScalar<unsigned long> sequence;
+
+		ArenaEvent event;
+
+		Slot();
+	};
+
+	/** The ring of slots (its size is a power of two) */
+	std::vector<Slot> m_slots;
+
+	/** The size of the ring minus one, for wrapping positions onto slots */
+	unsigned long m_mask;
+
+	/** Keeps the write position off the cache line of the slots' header */
+	char m_padding0[64];
+
+	/** The position the next event will be pushed at (shared by every pusher) */
+	AtomicScalar<unsigned long> m_writePos;
+
+	/** Keeps the read position off the write position's cache line */
+	char m_padding1[64];
+
+	/** The position the next event will be popped from (written by the popping thread only) */
+	AtomicScalar<unsigned long> m_readPos;
+
+	/** Keeps the metrics off the read position's cache line */
+	char m_padding2[64];
+
+	/** The number of events pushed */
+	AtomicScalar<unsigned long> m_pushed;
+
+	/** The number of events dropped because the ring was full */
+	AtomicScalar<unsigned long> m_dropped;
+
+	/** The greatest number of events waiting to be popped at once */
+	AtomicScalar<unsigned long> m_highWater;
+
+	/** Disabled, as pushers may be holding slots */
+	EventChannel(const EventChannel & copy);
+
+	/** Disabled, as pushers may be holding slots */
+	EventChannel & operator=(const EventChannel & copy);
+
+public:
+	/**
+	 * Constructs an EventChannel able to hold at least the passed number of events waiting
+	 * to be popped (the capacity is rounded up to a power of two)
+	 */
+	EventChannel(int capacity);
+
+	/**
+	 * Pushes an event onto the channel. Safe to call from any number of threads at once.
+	 * @return True if the event was pushed, false if the channel was full and it was dropped
+	 */
+	bool push(const ArenaEvent & event);
+
+	/**
+	 * Pops the oldest event waiting on the channel into the passed event. Must only be
+	 * called from a single thread.
+	 * @return True if an event was popped, false if the channel was empty
+	 */
+	bool pop(ArenaEvent & event);
+
+	/** @return The number of events waiting to be popped (only a hint while events are being pushed) */
+	int size() const;
+
+	/** @return The number of events the channel can hold */
+	int capacity() const;
+
+	/** @return The number of events pushed since the channel was created */
+	unsigned long pushed() const;
+
+	/** @return The number of events dropped since the channel was created, because it was full */
+	unsigned long dropped() const;
+
+	/** @return The greatest number of events which have been waiting to be popped at once */
+	unsigned long highWater() const;
+};
+
+#endif
@@ -0,0 +1,455 @@
+#include "Galaxy.h"
+#include "GameObjects.h"
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+/** @return The plan of a star */
+BodyPlan starPlan(Real mass, Real radius)
+{
+	BodyPlan star;
+	star.type = STAR;
+	star.mass = mass;
+	star.radius = radius;
+	star.center = -1;
+	star.distance = 0;
+	star.speed = 0;
+	star.angle = 0;
+	star.inclination = 0;
+	star.reverse = false;
+	return star;
+}
+
+/**
+ * Appends a body orbiting the planned body at index center, with its place on the orbit
+ * drawn from the random stream
+ * @return The index of the new body
+ */
+int planOrbitingBody(RandomStream & random, std::vector<BodyPlan> & bodies, ObjectType type, Real mass,
+	Real radius, int center, Real distance, Real speed)
+{
+	BodyPlan body;
+	body.type = type;
+	body.mass = mass;
+	body.radius = radius;
+	body.center = center;
+	body.distance = distance;
+	body.speed = speed;
+	body.angle = random.unitRandom() * (2 * Math::PI);
+	body.inclination = random.rangeRandom(-0.2, 0.2);
+	body.reverse = random.randomInt(2) != 0;
+	bodies.push_back(body);
+	return bodies.size() - 1;
+}
+
+/** @return The index of the sector at the passed grid coordinates */
+int sectorIndex(int x, int y, int z, int sectorsPerSide)
+{
+	return x + sectorsPerSide * (y + sectorsPerSide * z);
+}
+
+/** @return The grid coordinate of a position along one axis (may lie outside the grid) */
+int gridCoordinate(Real position, Real sectorSize, int sectorsPerSide)
+{
+	return (int)std::floor(position / sectorSize + sectorsPerSide * Real(0.5));
+}
+
+
+// ========================================================================
+// Galaxy Implementation
+// ========================================================================
+const Real Galaxy::SYSTEM_JITTER = 0.1f;
+const Real Galaxy::DEFAULT_SECTOR_SIZE = 500000;
+const Real Galaxy::DEFAULT_DENSITY = 0.5f;
+const Real Galaxy::FREEZE_MARGIN = 1.25f;
+
+Galaxy::Galaxy(WorkerPool * workers) : mp_workers(workers), m_seed(0), m_sectorsPerSide(0),
+	m_sectorSize(0), m_density(0), m_generateRadius(0), m_sectors(), m_pages(), m_pageDirectory(),
+	m_planning()
+{
+}
+
+Galaxy::~Galaxy()
+{
+	clear();
+}
+
+void Galaxy::create(unsigned long long seed, int sectorsPerSide, Real sectorSize, Real density)
+{
+	// The previous galaxy's pages are removed before its seed is replaced
+	clear();
+	m_seed = seed;
+	m_sectorsPerSide = sectorsPerSide;
+	m_sectorSize = sectorSize;
+	m_density = density;
+	m_generateRadius = sectorSize * Real(0.75);
+}
+
+void Galaxy::clear()
+{
+	// Pages written by this galaxy are removed along with it
+	if(!m_pageDirectory.empty()) {
+		std::map<int, SectorState>::const_iterator sectorIter;
+		for(sectorIter = m_sectors.begin(); sectorIter != m_sectors.end(); sectorIter++) {
+			if(sectorIter->second.activity == SECTOR_FROZEN) {
+				std::remove(pageFile(sectorIter->first).c_str());
+			}
+		}
+	}
+
+	m_sectorsPerSide = 0;
+	m_sectors.clear();
+	m_pages.clear();
+}
+
+bool Galaxy::active() const
+{
+	return m_sectorsPerSide > 0;
+}
+
+unsigned long long Galaxy::seed() const
+{
+	return m_seed;
+}
+
+int Galaxy::sectorsPerSide() const
+{
+	return m_sectorsPerSide;
+}
+
+Real Galaxy::sectorSize() const
+{
+	return m_sectorSize;
+}
+
+Real Galaxy::density() const
+{
+	return m_density;
+}
+
+void Galaxy::generateRadius(Real radius)
+{
+	m_generateRadius = radius;
+}
+
+Real Galaxy::generateRadius() const
+{
+	return m_generateRadius;
+}
+
+int Galaxy::numSectors() const
+{
+	return m_sectorsPerSide * m_sectorsPerSide * m_sectorsPerSide;
+}
+
+int Galaxy::sectorAt(const Vector3 & position) const
+{
+	int x = gridCoordinate(position.x, m_sectorSize, m_sectorsPerSide);
+	int y = gridCoordinate(position.y, m_sectorSize, m_sectorsPerSide);
+	int z = gridCoordinate(position.z, m_sectorSize, m_sectorsPerSide);
+	if(!active() || x < 0 || y < 0 || z < 0 || x >= m_sectorsPerSide || y >= m_sectorsPerSide
+		|| z >= m_sectorsPerSide)
+	{
+		return -1;
+	}
+	return sectorIndex(x, y, z, m_sectorsPerSide);
+}
+
+Vector3 Galaxy::sectorCenter(int sector) const
+{
+	int x = sector % m_sectorsPerSide;
+	int y = (sector / m_sectorsPerSide) % m_sectorsPerSide;
+	int z = sector / (m_sectorsPerSide * m_sectorsPerSide);
+	Real offset = m_sectorsPerSide * Real(0.5) - Real(0.5);
+	return Vector3(x - offset, y - offset, z - offset) * m_sectorSize;
+}
+
+bool Galaxy::system(int sector, Vector3 & position) const
+{
+	if(sector < 0 || sector >= numSectors()) {
+		return false;
+	}
+
+	position = sectorCenter(sector);
+	if(sector == sectorAt(Vector3::ZERO)) {
+		return true;
+	}
+
+	// Each sector has its own pair of streams, for its layout and its system's plan
+	RandomStream layout(m_seed, 2 * sector);
+	if(layout.unitRandom() >= m_density) {
+		return false;
+	}
+
+	Real jitter = m_sectorSize * SYSTEM_JITTER;
+	position.x += layout.rangeRandom(-jitter, jitter);
+	position.y += layout.rangeRandom(-jitter, jitter);
+	position.z += layout.rangeRandom(-jitter, jitter);
+	return true;
+}
+
+bool Galaxy::generated(int sector) const
+{
+	return m_sectors.find(sector) != m_sectors.end();
+}
+
+void Galaxy::markGenerated(int sector)
+{
+	SectorState state;
+	state.position = sectorCenter(sector);
+	state.activity = SECTOR_ACTIVE;
+	system(sector, state.position);
+	m_sectors[sector] = state;
+}
+
+const std::map<int, SectorState> & Galaxy::sectors() const
+{
+	return m_sectors;
+}
+
+SectorActivity Galaxy::activity(int sector) const
+{
+	std::map<int, SectorState>::const_iterator sectorIter = m_sectors.find(sector);
+	if(sectorIter == m_sectors.end()) {
+		return SECTOR_ACTIVE;
+	}
+	return sectorIter->second.activity;
+}
+
+bool Galaxy::updateActivity(const Vector3 & viewer, std::vector<int> & thawed, std::vector<int> & frozen)
+{
+	Real activeRadius = m_generateRadius;
+	Real reducedRadius = m_generateRadius * 2;
+	Real freezeRadius = reducedRadius * FREEZE_MARGIN;
+
+	bool changed = false;
+	std::map<int, SectorState>::iterator sectorIter;
+	for(sectorIter = m_sectors.begin(); sectorIter != m_sectors.end(); sectorIter++) {
+		SectorState & state = sectorIter->second;
+		Real distance = state.position.squaredDistance(viewer);
+		SectorActivity activity = distance <= activeRadius * activeRadius ? SECTOR_ACTIVE : SECTOR_REDUCED;
+
+		if(state.activity == SECTOR_FROZEN) {
+			if(distance > reducedRadius * reducedRadius) {
+				continue;
+			}
+			thawed.push_back(sectorIter->first);
+		} else if(distance > freezeRadius * freezeRadius) {
+			activity = SECTOR_FROZEN;
+			frozen.push_back(sectorIter->first);
+		}
+
+		if(activity != state.activity) {
+			state.activity = activity;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+std::string Galaxy::pageFile(int sector) const
+{
+	std::ostringstream name;
+	name << m_pageDirectory << "/galaxy_" << m_seed << "_" << sector << ".owp";
+	return name.str();
+}
+
+bool Galaxy::pageOut(int sector, const std::vector<char> & data)
+{
+	std::map<int, SectorState>::iterator sectorIter = m_sectors.find(sector);
+	if(sectorIter == m_sectors.end()) {
+		return false;
+	}
+
+	if(m_pageDirectory.empty()) {
+		m_pages[sector] = data;
+	} else {
+		std::ofstream file(pageFile(sector).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!data.empty()) {
+			file.write(&data[0], data.size());
+		}
+		if(!file.good()) {
+			return false;
+		}
+	}
+	sectorIter->second.activity = SECTOR_FROZEN;
+	return true;
+}
+
+bool Galaxy::pageIn(int sector, std::vector<char> & data)
+{
+	if(!page(sector, data)) {
+		return false;
+	}
+
+	if(m_pageDirectory.empty()) {
+		m_pages.erase(sector);
+	} else {
+		std::remove(pageFile(sector).c_str());
+	}
+	return true;
+}
+
+bool Galaxy::page(int sector, std::vector<char> & data) const
+{
+	data.clear();
+	if(m_pageDirectory.empty()) {
+		std::map<int, std::vector<char> >::const_iterator pageIter = m_pages.find(sector);
+		if(pageIter == m_pages.end()) {
+			return false;
+		}
+		data = pageIter->second;
+		return true;
+	}
+
+	std::ifstream file(pageFile(sector).c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if(!file) {
+		return false;
+	}
+	data.resize((size_t)file.tellg());
+	file.seekg(0);
+	return data.empty() || file.read(&data[0], data.size());
+}
+
+void Galaxy::pageDirectory(const std::string & directory)
+{
+	m_pageDirectory = directory;
+}
+
+const std::string & Galaxy::pageDirectory() const
+{
+	return m_pageDirectory;
+}
+
+void Galaxy::approach(const Vector3 & viewer, std::vector<PlannedSystem> & systems)
+{
+	systems.clear();
+	if(!active()) {
+		return;
+	}
+
+	// Only the block of sectors overlapping the generate radius is searched
+	int low[3];
+	int high[3];
+	for(int axis = 0; axis < 3; axis++) {
+		low[axis] = std::max(gridCoordinate(viewer[axis] - m_generateRadius, m_sectorSize, m_sectorsPerSide), 0);
+		high[axis] = std::min(gridCoordinate(viewer[axis] + m_generateRadius, m_sectorSize, m_sectorsPerSide),
+			m_sectorsPerSide - 1);
+	}
+
+	m_planning.clear();
+	for(int z = low[2]; z <= high[2]; z++) {
+		for(int y = low[1]; y <= high[1]; y++) {
+			for(int x = low[0]; x <= high[0]; x++) {
+				int sector = sectorIndex(x, y, z, m_sectorsPerSide);
+				Vector3 position;
+				if(generated(sector) || !system(sector, position)
+					|| position.squaredDistance(viewer) > m_generateRadius * m_generateRadius)
+				{
+					continue;
+				}
+
+				PlannedSystem planned;
+				planned.sector = sector;
+				planned.position = position;
+				m_planning.push_back(planned);
+
+				SectorState state;
+				state.position = position;
+				state.activity = SECTOR_ACTIVE;
+				m_sectors[sector] = state;
+			}
+		}
+	}
+
+	if(!m_planning.empty()) {
+		MemberTask<Galaxy> planTask(this, &Galaxy::planSystems);
+		mp_workers->parallelFor(planTask, m_planning.size(), 1);
+	}
+	systems.swap(m_planning);
+}
+
+void Galaxy::planSystems(int begin, int end)
+{
+	for(int i = begin; i < end; i++) {
+		RandomStream random(m_seed, 2 * m_planning[i].sector + 1);
+		planSystem(random, m_planning[i].bodies);
+	}
+}
+
+void Galaxy::planSystem(RandomStream & random, std::vector<BodyPlan> & bodies)
+{
+	// Generate a star in the middle of the system
+	bodies.clear();
+	bodies.push_back(starPlan(100000, 10000));
+	int star = 0;
+	Real totalDistance = 5000;
+
+	// Inner planets
+	int numInnerPlanets = random.randomInt(5) + 3;
+	// Add a random number of planents
+	for(int i = 0; i < numInnerPlanets; i++) {
+		totalDistance += random.rangeRandom(4000, 7000);
+		Real planetRadius = random.rangeRandom(500, 2000);
+		Real speed = random.rangeRandom(2000, 8000);
+
+		int planet = planOrbitingBody(random, bodies, PLANET, 10000, planetRadius,
+			star, totalDistance, speed);
+
+		// Every planet has two moons, but the moon count is still drawn so systems stay the same
+		random.randomInt(3);
+		Real moonDistance = planetRadius * 0.3;
+		for(int j = 0; j < 2; j++) {
+			Real moonRadius = random.rangeRandom(planetRadius * 0.1, planetRadius * 0.7);
+			moonDistance += random.rangeRandom(planetRadius * 0.5, planetRadius * 1);
+			speed = random.rangeRandom(1, 3) * moonDistance;
+			planOrbitingBody(random, bodies, MOON, 1000, moonRadius, planet, moonDistance, speed);
+		}
+	}
+
+	// Outer planets - giants
+	totalDistance += random.rangeRandom(2000, 8000);
+	int numOuterPlanets = random.randomInt(4) + 2;
+	for(int i = 0; i < numOuterPlanets; i++) {
+		totalDistance += random.rangeRandom(8000, 14000);
+		Real planetRadius = random.rangeRandom(2000, 8000);
+		Real speed = random.rangeRandom(8000, 15000);
+
+		int planet = planOrbitingBody(random, bodies, PLANET, 10000, planetRadius,
+			star, totalDistance, speed);
+
+		// The unused moon count is drawn, as above
+		random.randomInt(5);
+		Real moonDistance = planetRadius * 0.3;
+		for(int j = 0; j < 2; j++) {
+			Real moonRadius = random.rangeRandom(planetRadius * 0.1, planetRadius * 0.3);
+			moonDistance += random.rangeRandom(planetRadius * 0.2, planetRadius * 0.4);
+			speed = random.rangeRandom(2, 4) * moonDistance;
+			planOrbitingBody(random, bodies, MOON, 1000, moonRadius, planet, moonDistance, speed);
+		}
+	}
+
+	// Outer planets - tiny
+	int numTinyPlanets = random.randomInt(3);
+	totalDistance += random.rangeRandom(8000, 12000);
+	for(int i = 0; i < numTinyPlanets; i++) {
+		totalDistance += random.rangeRandom(8000, 14000);
+		Real planetRadius = random.rangeRandom(500, 1500);
+		Real speed = random.rangeRandom(20000, 25000);
+
+		int planet = planOrbitingBody(random, bodies, PLANET, 10000, planetRadius,
+			star, totalDistance, speed);
+
+		// The unused moon count is drawn, as above
+		random.randomInt(2);
+		Real moonDistance = planetRadius * 0.3;
+		for(int j = 0; j < 2; j++) {
+			Real moonRadius = random.rangeRandom(planetRadius * 0.8, planetRadius * 1.2);
+			moonDistance += random.rangeRandom(planetRadius * 0.2, planetRadius * 0.4);
+			speed = random.rangeRandom(2, 4) * moonDistance;
+			planOrbitingBody(random, bodies, MOON, 1000, moonRadius, planet, moonDistance, speed);
+		}
+	}
+}
@@ -0,0 +1,261 @@
+#ifndef __Galaxy_h_
+#define __Galaxy_h_
+
+#include <vector>
+#include <map>
+#include <string>
+#include <OgreVector3.h>
+#include "RandomStream.h"
+#include "WorkerPool.h"
+
+using namespace Ogre;
+
+/** A celestial body of a planned star system, before it is added to an arena */
+struct BodyPlan
+{
+	/** The body's type (STAR, PLANET or MOON, see ObjectType) */
+	int type;
+
+	Real mass;
+	Real radius;
+
+	/** The index of the body's center in its system's plan (-1 for the star) */
+	int center;
+
+	/** The body's orbit (see CelestialBody's orbiting constructor) */
+	Real distance;
+	Real speed;
+	Real angle;
+	Real inclination;
+	bool reverse;
+};
+
+/** How closely the bodies of a generated sector are simulated, by its distance from the viewer */
+enum SectorActivity {
+	/** Bodies follow their orbits on every update, and are tested for collisions */
+	SECTOR_ACTIVE,
+
+	/** Bodies follow their orbits every Galaxy::REDUCED_INTERVAL updates, and aren't tested for collisions */
+	SECTOR_REDUCED,
+
+	/** Bodies are paged out of the arena (see Galaxy::pageOut()) */
+	SECTOR_FROZEN
+};
+
+/** A sector of the galaxy whose system has been generated */
+struct SectorState
+{
+	/** The position of the sector's star */
+	Vector3 position;
+
+	/** How closely the sector's bodies are simulated */
+	SectorActivity activity;
+};
+
+/** A star system planned by a Galaxy, ready to be added to an arena */
+struct PlannedSystem
+{
+	/** The sector holding the system */
+	int sector;
+
+	/** The position of the system's star */
+	Vector3 position;
+
+	/** The system's bodies, with the star first and every center before its satellites */
+	std::vector<BodyPlan> bodies;
+};
+
+/**
+ * The Galaxy class lays out star systems on a cubic grid of sectors centered on the origin,
+ * and plans their bodies as a viewer approaches them. Sectors hold at most one system each.
+ *
+ * Nothing is generated up front: whether a sector holds a system, and where, is drawn from a
+ * random stream of the galaxy's seed and the sector's index, and so is each system's plan. A
+ * galaxy of thousands of systems is created instantly, and the same seed always gives the
+ * same galaxy whatever order its systems are reached in. Only the sectors which have been
+ * generated are remembered, so memory follows the explored region rather than the galaxy.
+ *
+ * Systems coming into range together are planned in parallel on a WorkerPool, and returned
+ * in sector order, so the arena adding them stays deterministic.
+ *
+ * Each generated sector also has an activity level, so the cost of an update follows what is
+ * happening near the viewer rather than how much of the galaxy has been explored. Sectors
+ * within the generate radius are active, those within twice the radius are reduced, and those
+ * further away are frozen: the arena pages their bodies out (in memory, or to files in the page
+ * directory if one is set) and restores them once the viewer returns. A sector is only frozen
+ * once it is FREEZE_MARGIN beyond the reduced radius, so a viewer on the boundary doesn't page
+ * it in and out on every update.
+ */
+class Galaxy
+{
+private:
+	/** The workers systems are planned on */
+	WorkerPool * mp_workers;
+
+	/** The seed every sector's random streams are drawn from */
+	unsigned long long m_seed;
+
+	/** The number of sectors along each side of the grid (0 if there is no galaxy) */
+	int m_sectorsPerSide;
+
+	/** The length of a side of each sector */
+	Real m_sectorSize;
+
+	/** The chance of a sector holding a system */
+	Real m_density;
+
+	/** The distance from a viewer within which systems are generated */
+	Real m_generateRadius;
+
+	/** The sectors whose systems have been generated */
+	std::map<int, SectorState> m_sectors;
+
+	/** The bodies of frozen sectors held in memory (unused if there is a page directory) */
+	std::map<int, std::vector<char> > m_pages;
+
+	/** The directory frozen sectors are written to (empty to keep them in memory) */
+	std::string m_pageDirectory;
+
+	/** @return The name of the file the passed sector is paged out to */
+	std::string pageFile(int sector) const;
+
+	/** The systems being planned by approach() */
+	std::vector<PlannedSystem> m_planning;
+
+	/** Plans the bodies of the systems in the range [begin, end) of m_planning */
+	void planSystems(int begin, int end);
+
+	/** Disabled, as the galaxy shares its workers */
+	Galaxy(const Galaxy & copy);
+
+	/** Disabled, as the galaxy shares its workers */
+	Galaxy & operator=(const Galaxy & copy);
+
+public:
+	/** The fraction of the sector size a system is placed away from its sector's center */
+	static const Real SYSTEM_JITTER;
+
+	/** The number of sectors along each side of the game's galaxy (3375 sectors) */
+	static const int DEFAULT_SECTORS_PER_SIDE = 15;
+
+	/** The sector size of the game's galaxy (a system's outer planets reach about 170000) */
+	static const Real DEFAULT_SECTOR_SIZE;
+
+	/** The chance of a sector of the game's galaxy holding a system */
+	static const Real DEFAULT_DENSITY;
+
+	/** The number of updates between each placement of a reduced sector's bodies */
+	static const int REDUCED_INTERVAL = 8;
+
+	/** The fraction of the reduced radius a sector must be beyond to be frozen */
+	static const Real FREEZE_MARGIN;
+
+	/** Constructs an empty Galaxy which will plan systems on the passed workers */
+	Galaxy(WorkerPool * workers);
+
+	/** Removes any pages the galaxy has written */
+	~Galaxy();
+
+	/**
+	 * Lays out a new galaxy (forgetting which sectors were generated). The sector holding the
+	 * origin always has a system, at its center. Systems are generated within 0.75 sectors of
+	 * a viewer.
+	 */
+	void create(unsigned long long seed, int sectorsPerSide, Real sectorSize, Real density);
+
+	/** Removes the galaxy (and its pages), so no more systems are generated */
+	void clear();
+
+	/** @return True if a galaxy has been created */
+	bool active() const;
+
+	/** @return The seed the galaxy was created with */
+	unsigned long long seed() const;
+
+	/** @return The number of sectors along each side of the grid */
+	int sectorsPerSide() const;
+
+	/** @return The length of a side of each sector */
+	Real sectorSize() const;
+
+	/** @return The chance of a sector holding a system */
+	Real density() const;
+
+	/** Sets the distance from a viewer within which systems are generated */
+	void generateRadius(Real radius);
+
+	/** @return The distance from a viewer within which systems are generated */
+	Real generateRadius() const;
+
+	/** @return The number of sectors in the galaxy */
+	int numSectors() const;
+
+	/** @return The index of the sector holding the passed position (-1 if it lies outside the galaxy) */
+	int sectorAt(const Vector3 & position) const;
+
+	/** @return The center of the passed sector */
+	Vector3 sectorCenter(int sector) const;
+
+	/**
+	 * Finds the system of the passed sector, without generating it
+	 * @return True if the sector holds a system, with the position of its star stored in position
+	 */
+	bool system(int sector, Vector3 & position) const;
+
+	/** @return True if the passed sector's system has been generated */
+	bool generated(int sector) const;
+
+	/** Records the passed sector's system as generated, and active (used to restore a saved galaxy) */
+	void markGenerated(int sector);
+
+	/** @return The sectors whose systems have been generated, by index */
+	const std::map<int, SectorState> & sectors() const;
+
+	/** @return How closely the passed sector is simulated (active if it hasn't been generated) */
+	SectorActivity activity(int sector) const;
+
+	/**
+	 * Updates the activity of every generated sector for the viewer's position. Sectors which
+	 * have just been frozen are appended to frozen, and those no longer frozen to thawed (the
+	 * arena must page them out or in).
+	 * @return True if the activity of any sector changed
+	 */
+	bool updateActivity(const Vector3 & viewer, std::vector<int> & thawed, std::vector<int> & frozen);
+
+	/**
+	 * Stores the bodies of a frozen sector (as saved by ArenaSerializer::saveBodies()), writing
+	 * them to the page directory if one is set. The sector is marked frozen.
+	 * @return True if the page was stored
+	 */
+	bool pageOut(int sector, const std::vector<char> & data);
+
+	/**
+	 * Takes back the bodies paged out for a sector, replacing the contents of data
+	 * @return True if the sector had a page (which is discarded)
+	 */
+	bool pageIn(int sector, std::vector<char> & data);
+
+	/** Reads the bodies paged out for a sector without discarding them @return True if it had a page */
+	bool page(int sector, std::vector<char> & data) const;
+
+	/** Sets the directory frozen sectors are written to (empty to keep them in memory) */
+	void pageDirectory(const std::string & directory);
+
+	/** @return The directory frozen sectors are written to (empty if they are kept in memory) */
+	const std::string & pageDirectory() const;
+
+	/**
+	 * Plans every system within the generate radius of the viewer which has not been generated
+	 * yet, and records them as generated. Replaces the contents of systems with the planned
+	 * systems, in ascending sector order.
+	 */
+	void approach(const Vector3 & viewer, std::vector<PlannedSystem> & systems);
+
+	/**
+	 * Plans a randomly distributed solar system around a star, replacing the contents of bodies.
+	 * Every planet and moon is drawn from the passed random stream.
+	 */
+	static void planSystem(RandomStream & random, std::vector<BodyPlan> & bodies);
+};
+
+#endif
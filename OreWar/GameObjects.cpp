@@ -1,36 +1,95 @@
 #include "GameObjects.h"
+#include "EventChannel.h"
+#include "InputRecording.h"
+#include "ArenaSerializer.h"
 #include "OgreMath.h"
+#include <ctime>
+#include <algorithm>
 
 using namespace Ogre;
 
+// ========================================================================
+// CollisionMatrix Implementation
+// ========================================================================
+CollisionMatrix::CollisionMatrix() : m_ownerMask(0)
+{
+	for(int i = 0; i < NUM_OBJECT_TYPES; i++) {
+		m_masks[i] = 0;
+	}
+
+	ObjectType projectiles[] = { PROJECTILE, ANCHOR_PROJECTILE, PLANET_CHUNK };
+	ObjectType bodies[] = { STAR, MOON, PLANET };
+	for(int i = 0; i < 3; i++) {
+		collides(projectiles[i], NPC_SHIP, true);
+		collides(SHIP, bodies[i], true);
+		collides(NPC_SHIP, bodies[i], true);
+		for(int j = 0; j < 3; j++) {
+			collides(projectiles[i], bodies[j], true);
+			collides(bodies[i], bodies[j], true);
+		}
+	}
+}
+
+bool CollisionMatrix::collides(ObjectType a, ObjectType b) const
+{
+	return (m_masks[a] & (1 << b)) != 0;
+}
+
+void CollisionMatrix::collides(ObjectType a, ObjectType b, bool collide)
+{
+	if(collide) {
+		m_masks[a] |= (1 << b);
+		m_masks[b] |= (1 << a);
+	} else {
+		m_masks[a] &= ~(1 << b);
+		m_masks[b] &= ~(1 << a);
+	}
+}
+
+unsigned int CollisionMatrix::mask(ObjectType type) const
+{
+	return m_masks[type];
+}
+
+bool CollisionMatrix::ownerCollides(ObjectType projectileType) const
+{
+	return (m_ownerMask & (1 << projectileType)) != 0;
+}
+
+void CollisionMatrix::ownerCollides(ObjectType projectileType, bool collide)
+{
+	if(collide) {
+		m_ownerMask |= (1 << projectileType);
+	} else {
+		m_ownerMask &= ~(1 << projectileType);
+	}
+}
+
+
 // ========================================================================
 // GameObject Implementation
 // ========================================================================
 GameObject::GameObject(const SphereCollisionObject& object, ObjectType type, Real maxHealth, Real maxEnergy, 
 	Real energyRechargeRate, PagedMemoryPool * memoryMgr)
-	: mp_memory(memoryMgr), mp_physModel(NULL), m_maxHealth(maxHealth), m_health(maxHealth), m_maxEnergy(maxEnergy), m_energy(maxEnergy),
-	m_energyRechargeRate(energyRechargeRate), m_type(type)
+	: mp_memory(memoryMgr), m_physModel(object), m_localHealth(maxHealth, maxEnergy, energyRechargeRate),
+	m_type(type), m_arenaIndex(-1), m_dead(false)
 {
-	mp_physModel = mp_memory->storeObject(SphereCollisionObject(object));
 }
 
 GameObject::GameObject(const GameObject& copy)
-	: mp_memory(copy.mp_memory), mp_physModel(NULL), m_maxHealth(copy.m_maxHealth), m_health(copy.m_maxHealth), 
-	m_maxEnergy(copy.m_maxEnergy), m_energy(copy.m_maxEnergy), m_energyRechargeRate(copy.m_energyRechargeRate),
-	m_type(copy.m_type)
+	: mp_memory(copy.mp_memory), m_physModel(*copy.phys()), m_localHealth(copy.maxHealth(), copy.maxEnergy(), 
+	copy.energyRecharge()), m_type(copy.m_type), m_arenaIndex(-1), m_dead(false)
 {
-	mp_physModel = mp_memory->storeObject(SphereCollisionObject(*copy.phys()));
 }
 
-
-GameObject::~GameObject()
+SphereCollisionObject * GameObject::phys()
 {
-	mp_memory->destroyObject(mp_physModel);
+	return &m_physModel;
 }
 
-SphereCollisionObject * GameObject::phys() const
+const SphereCollisionObject * GameObject::phys() const
 {
-	return mp_physModel;
+	return &m_physModel;
 }
 
 ObjectType GameObject::type() const
@@ -43,64 +102,124 @@ PagedMemoryPool * GameObject::memoryManager() const
 	return mp_memory;
 }
 
+int GameObject::arenaIndex() const
+{
+	return m_arenaIndex;
+}
+
+void GameObject::arenaIndex(int index)
+{
+	m_arenaIndex = index;
+}
+
+bool GameObject::dead() const
+{
+	return m_dead;
+}
+
+void GameObject::dead(bool dead)
+{
+	m_dead = dead;
+}
+
+EntityId GameObject::entity() const
+{
+	return m_physModel.entity();
+}
+
+HealthComponent & GameObject::healthComponent()
+{
+	EntityStore * store = m_physModel.store();
+	return store == NULL ? m_localHealth : *store->health().get(m_physModel.entity());
+}
+
+const HealthComponent & GameObject::healthComponent() const
+{
+	EntityStore * store = m_physModel.store();
+	return store == NULL ? m_localHealth : *store->health().get(m_physModel.entity());
+}
+
+void GameObject::attach(EntityStore * store, EntityId entity)
+{
+	store->health().add(entity, healthComponent());
+	m_physModel.attach(store, entity);
+}
+
+void GameObject::detach()
+{
+	EntityStore * store = m_physModel.store();
+	if(store == NULL) {
+		return;
+	}
+
+	m_localHealth = healthComponent();
+	store->health().remove(m_physModel.entity());
+	m_physModel.detach();
+}
+
 Real GameObject::health() const
 {
-	return m_health;
+	return healthComponent().health;
 }
 
 Real GameObject::maxHealth() const
 {
-	return m_maxHealth;
+	return healthComponent().maxHealth;
 }
 
 Real GameObject:: energy() const
 {
-	return m_energy;
+	return healthComponent().energy;
 }
 
 Real GameObject::maxEnergy() const
 {
-	return m_maxEnergy;
+	return healthComponent().maxEnergy;
 }
 
 Real GameObject::energyRecharge() const
 {
-	return m_energyRechargeRate;
+	return healthComponent().rechargeRate;
 }
 
 void GameObject::health(Real health)
 {
-	m_health = health > m_maxHealth ? m_maxHealth : health;
+	HealthComponent & h = healthComponent();
+	h.health = health > h.maxHealth ? h.maxHealth : health;
 }
 
 void GameObject::energy(Real energy)
 {
-	m_energy = energy > m_maxEnergy ? m_maxEnergy : energy;
+	HealthComponent & h = healthComponent();
+	h.energy = energy > h.maxEnergy ? h.maxEnergy : energy;
 }
 
 void GameObject::inflictDamage(Real damage)
 {
-	if(damage < m_energy) {
-		m_energy = m_energy - damage;
+	HealthComponent & h = healthComponent();
+	if(damage < h.energy) {
+		h.energy = h.energy - damage;
 	} else {
-		m_health = m_health - (damage - m_energy);
-		m_energy = 0;
+		h.health = h.health - (damage - h.energy);
+		h.energy = 0;
 	}
 }
 
 void GameObject::addEnergy(Real energy)
 {
-	m_energy = energy + m_energy;
-	if(m_energy > m_maxEnergy) {
-		m_energy = m_maxEnergy;
+	HealthComponent & h = healthComponent();
+	h.energy = energy + h.energy;
+	if(h.energy > h.maxEnergy) {
+		h.energy = h.maxEnergy;
 	}
 }
 
 void GameObject::drainEnergy(Real energy)
 {
-	m_energy = m_energy - energy;
-	if(m_energy < 0) {
-		m_energy = 0;
+	HealthComponent & h = healthComponent();
+	h.energy = h.energy - energy;
+	if(h.energy < 0) {
+		h.energy = 0;
 	}
 }
 
@@ -111,14 +230,40 @@ void GameObject::drainEnergy(Real energy)
 
 Projectile::Projectile(const SphereCollisionObject& physModel, ObjectType type, Real damage, 
 	Real lifeTime, PagedMemoryPool * memoryMgr)
-	: GameObject(physModel, type, 1, 0, 0, memoryMgr), m_damage(damage), m_lifeTime(lifeTime),
-	m_elapsedTime(0)
+	: GameObject(physModel, type, 1, 0, 0, memoryMgr), m_damage(damage), m_localLifetime(lifeTime),
+	m_id(NULL_POOL_ID), m_ownerSerial(0)
+{
+}
+
+Projectile::Projectile(const Projectile& copy)
+	: GameObject(copy), m_damage(copy.m_damage), m_localLifetime(copy.lifetimeComponent()),
+	m_id(NULL_POOL_ID), m_ownerSerial(copy.m_ownerSerial)
+{
+}
+
+PoolId Projectile::id() const
+{
+	return m_id;
+}
+
+void Projectile::id(PoolId id)
+{
+	m_id = id;
+}
+
+unsigned long Projectile::owner() const
+{
+	return m_ownerSerial;
+}
+
+void Projectile::owner(unsigned long serial)
 {
+	m_ownerSerial = serial;
 }
 
 void Projectile::updatePhysics(Real timeElapsed)
 {
-	m_elapsedTime += timeElapsed;
+	lifetimeComponent().elapsedTime += timeElapsed;
 	phys()->updatePhysics(timeElapsed);
 }
 
@@ -129,17 +274,48 @@ Real Projectile::damage() const
 
 Real Projectile::lifeTime() const
 {
-	return m_lifeTime;
+	return lifetimeComponent().lifeTime;
 }
 
-Real Projectile::lifeTime(Real time)
+void Projectile::lifeTime(Real time)
 {
-	m_lifeTime = time;
+	lifetimeComponent().lifeTime = time;
 }
 
 bool Projectile::expired() const
 {
-	return m_elapsedTime > m_lifeTime;
+	const LifetimeComponent & lifetime = lifetimeComponent();
+	return lifetime.expired || lifetime.elapsedTime > lifetime.lifeTime;
+}
+
+LifetimeComponent & Projectile::lifetimeComponent()
+{
+	EntityStore * store = phys()->store();
+	return store == NULL ? m_localLifetime : *store->lifetimes().get(entity());
+}
+
+const LifetimeComponent & Projectile::lifetimeComponent() const
+{
+	EntityStore * store = phys()->store();
+	return store == NULL ? m_localLifetime : *store->lifetimes().get(entity());
+}
+
+void Projectile::attach(EntityStore * store, EntityId entity)
+{
+	store->lifetimes().add(entity, lifetimeComponent());
+	GameObject::attach(store, entity);
+}
+
+void Projectile::detach()
+{
+	EntityStore * store = phys()->store();
+	if(store == NULL) {
+		return;
+	}
+
+	m_localLifetime = lifetimeComponent();
+	store->lifetimes().remove(entity());
+	GameObject::detach();
 }
 
 
@@ -147,13 +323,12 @@ bool Projectile::expired() const
 // Weapon Implementation
 // ========================================================================
 Weapon::Weapon(Real reloadTime, Real energyCost, PagedMemoryPool * memoryMgr) 
-	: mp_memory(memoryMgr), m_reloadTime(reloadTime), m_lastShotCounter(reloadTime),
-	m_canShoot(true), m_energyCost(energyCost)
+	: mp_memory(memoryMgr), mp_store(NULL), m_entity(NULL_ENTITY), m_localWeapon(reloadTime, energyCost)
 {
 }
 
-Weapon::Weapon(const Weapon& copy) : mp_memory(copy.mp_memory), m_reloadTime(copy.m_reloadTime), m_lastShotCounter(copy.m_lastShotCounter),
-	m_canShoot(copy.m_canShoot), m_energyCost(copy.m_energyCost)
+Weapon::Weapon(const Weapon& copy) : mp_memory(copy.mp_memory), mp_store(NULL), m_entity(NULL_ENTITY),
+	m_localWeapon(copy.weaponComponent())
 {
 }
 
@@ -168,30 +343,82 @@ PagedMemoryPool * Weapon::memoryManager() const
 
 bool Weapon::canShoot() const
 {
-	return m_canShoot;
+	return weaponComponent().canShoot;
 }
 
 
 void Weapon::resetShotCounter()
 {
-	m_lastShotCounter = 0;
-	m_canShoot = false;
+	WeaponComponent & weapon = weaponComponent();
+	weapon.lastShotCounter = 0;
+	weapon.canShoot = false;
+}
+
+void Weapon::reload()
+{
+	reload(weaponComponent());
+}
+
+void Weapon::reload(WeaponComponent & weapon)
+{
+	weapon.lastShotCounter = weapon.reloadTime;
+	weapon.canShoot = true;
+}
+
+Real Weapon::reloadTime() const
+{
+	return weaponComponent().reloadTime;
 }
 
 Real Weapon::energyCost()
 {
-	return m_energyCost;
+	return weaponComponent().energyCost;
 }
 
 void Weapon::updatePhysics(Real timeElapsed) {
-	if(!m_canShoot) {
-		m_lastShotCounter += timeElapsed;
-		if(m_lastShotCounter >= m_reloadTime) {
-			m_canShoot = true;
+	WeaponComponent & weapon = weaponComponent();
+	if(!weapon.canShoot) {
+		weapon.lastShotCounter += timeElapsed;
+		if(weapon.lastShotCounter >= weapon.reloadTime) {
+			weapon.canShoot = true;
 		}
 	}
 }
 
+EntityId Weapon::entity() const
+{
+	return m_entity;
+}
+
+WeaponComponent & Weapon::weaponComponent()
+{
+	return mp_store == NULL ? m_localWeapon : *mp_store->weapons().get(m_entity);
+}
+
+const WeaponComponent & Weapon::weaponComponent() const
+{
+	return mp_store == NULL ? m_localWeapon : *mp_store->weapons().get(m_entity);
+}
+
+void Weapon::attach(EntityStore * store, EntityId entity)
+{
+	store->weapons().add(entity, weaponComponent());
+	mp_store = store;
+	m_entity = entity;
+}
+
+void Weapon::detach()
+{
+	if(mp_store == NULL) {
+		return;
+	}
+
+	m_localWeapon = weaponComponent();
+	mp_store->weapons().remove(m_entity);
+	mp_store = NULL;
+	m_entity = NULL_ENTITY;
+}
+
 
 // ========================================================================
 // PlasmaCannon Implementation
@@ -204,6 +431,16 @@ PlasmaCannon::PlasmaCannon(const PlasmaCannon& copy) : Weapon(copy), m_shootLeft
 {
 }
 
+bool PlasmaCannon::shootLeft() const
+{
+	return m_shootLeft;
+}
+
+void PlasmaCannon::shootLeft(bool left)
+{
+	m_shootLeft = left;
+}
+
 Projectile PlasmaCannon::fireWeapon(PhysicsObject& origin)
 {
 	SphereCollisionObject projectilePhysics = SphereCollisionObject(75, 1, origin.position());
@@ -252,58 +489,86 @@ Projectile AnchorLauncher::fireWeapon(PhysicsObject& origin)
 // ========================================================================
 CelestialBody::CelestialBody(ObjectType type, Real mass, Real radius, Vector3 position, PagedMemoryPool * memoryMgr)
 	: GameObject(SphereCollisionObject(radius, mass, position), type, 100, 0,
-		0, memoryMgr), mp_center(NULL), m_radius(radius)
+		0, memoryMgr), mp_center(NULL), m_radius(radius), m_sector(-1), m_localOrbit(),
+	mp_satellites(NULL), mp_nextSatellite(NULL), mp_prevSatellite(NULL)
 {
 }
 
 CelestialBody::CelestialBody(ObjectType type, Real mass, Real radius, CelestialBody * center, 
-	Real distance, Real speed, PagedMemoryPool * memoryMgr)
+	Real distance, Real speed, RandomStream & random, PagedMemoryPool * memoryMgr)
 	: GameObject(SphereCollisionObject(radius, mass, Vector3(0,0,0)), type, 100, 0,
-		0, memoryMgr), mp_center(center), m_radius(radius)
+		0, memoryMgr), mp_center(center), m_radius(radius), m_sector(-1), m_localOrbit(),
+	mp_satellites(NULL), mp_nextSatellite(NULL), mp_prevSatellite(NULL)
+{
+	m_localOrbit.center = center->entity();
+	m_localOrbit.onRails = true;
+	updateKinematic();
+
+	Real randAngle = random.unitRandom() * (2 * Math::PI);
+	Real randMu = random.rangeRandom(-0.2, 0.2);
+	bool reverse = random.randomInt(2) != 0;
+	placeInOrbit(distance, speed, randAngle, randMu, reverse);
+}
+
+CelestialBody::CelestialBody(ObjectType type, Real mass, Real radius, CelestialBody * center, 
+	Real distance, Real speed, Real angle, Real inclination, bool reverse, PagedMemoryPool * memoryMgr)
+	: GameObject(SphereCollisionObject(radius, mass, Vector3(0,0,0)), type, 100, 0,
+		0, memoryMgr), mp_center(center), m_radius(radius), m_sector(-1), m_localOrbit(),
+	mp_satellites(NULL), mp_nextSatellite(NULL), mp_prevSatellite(NULL)
+{
+	m_localOrbit.center = center->entity();
+	m_localOrbit.onRails = true;
+	updateKinematic();
+
+	placeInOrbit(distance, speed, angle, inclination, reverse);
+}
+
+void CelestialBody::placeInOrbit(Real distance, Real speed, Real angle, Real inclination, bool reverse)
 {
-	Real totalDistance = distance + radius + center->radius();
+	Real totalDistance = distance + radius() + mp_center->radius();
 	
-	// Generate a random position on a sphere around the center with a radius
+	// Generate a position on a sphere around the center with a radius
 	// equal to the specified distance
-	Real randAngle = Math::UnitRandom() * (2 * Math::PI);
-	Real randMu = Math::RangeRandom(-0.2, 0.2);
 	Vector3 pointOnUnitSphere = Vector3(
-		Math::Cos(randAngle) * Math::Sqrt(1 - Math::Sqr(randMu)),
-		randMu,
-		Math::Sin(randAngle) * Math::Sqrt(1 - Math::Sqr(randMu)));
+		Math::Cos(angle) * Math::Sqrt(1 - Math::Sqr(inclination)),
+		inclination,
+		Math::Sin(angle) * Math::Sqrt(1 - Math::Sqr(inclination)));
 	Vector3 relPosition = pointOnUnitSphere * totalDistance;
 
-	phys()->position(relPosition + center->phys()->position());
+	phys()->position(relPosition + mp_center->phys()->position());
 
 	// Generate a velocity for the orbit by taking the cross product of the Y unit vector
 	// and the normal vector to the center of the orbit (results in a vector tangent to
 	// the sphere)
-	Vector3 unitNormal = (center->phys()->position() - phys()->position()).normalisedCopy();
-	// Randomize the direction of the orbit
-	int reverse = rand() % 2;
+	Vector3 unitNormal = (mp_center->phys()->position() - phys()->position()).normalisedCopy();
 	if(reverse) {
 		unitNormal = unitNormal * -1;
 	}
-	Vector3 velocity = (unitNormal.crossProduct(Vector3::UNIT_Y).normalisedCopy() * speed) + center->phys()->velocity();
+	Vector3 tangent = unitNormal.crossProduct(Vector3::UNIT_Y).normalisedCopy();
+	Vector3 velocity = (tangent * speed) + mp_center->phys()->velocity();
 	phys()->velocity(velocity);
 
+	// Store the orbital elements so the orbit can be evaluated in closed form
+	OrbitComponent & orbit = orbitComponent();
+	orbit.axisU = pointOnUnitSphere;
+	orbit.axisV = tangent;
+	orbit.distance = totalDistance;
+	orbit.angularSpeed = speed / totalDistance;
+}
 
-	// Generate a random velocity by generating a random vector lieing in a plane
-	// tangent to the sphere around the orbital center
-	/*
-	Vector3 randomUnitTangent = unitNormal.randomDeviant(Radian(Degree(90))).normalisedCopy();
-	Vector3 velocity = (randomUnitTangent * speed) + center->phys()->velocity();
-	phys()->velocity(velocity);
-	*/
-
+void CelestialBody::updateKinematic()
+{
+	phys()->kinematic(onRails());
 }
 
 CelestialBody::CelestialBody(const CelestialBody & copy)
-	: GameObject(copy), mp_center(copy.mp_center), m_radius(copy.m_radius)
+	: GameObject(copy), mp_center(copy.mp_center), m_radius(copy.m_radius), m_sector(copy.m_sector),
+	m_localOrbit(copy.orbitComponent()),
+	mp_satellites(NULL), mp_nextSatellite(NULL), mp_prevSatellite(NULL)
 {
 }
 
-Constraint CelestialBody::constraint() const
+Constraint CelestialBody::constraint()
 {
 	// Generate the constraint which maintains the orbit
 	return Constraint(phys(), mp_center->phys(), true);
@@ -316,7 +581,18 @@ bool CelestialBody::hasCenter() const
 
 void CelestialBody::center(CelestialBody * newCenter)
 {
+	bool attached = phys()->store() != NULL;
+	if(attached) {
+		unlinkFromCenter();
+	}
+
 	mp_center = newCenter;
+	orbitComponent().center = newCenter != NULL ? newCenter->entity() : NULL_ENTITY;
+	updateKinematic();
+
+	if(attached) {
+		linkToCenter();
+	}
 }
 
 CelestialBody * CelestialBody::center() const
@@ -324,13 +600,145 @@ CelestialBody * CelestialBody::center() const
 	return mp_center;
 }
 
+CelestialBody * CelestialBody::satellites() const
+{
+	return mp_satellites;
+}
+
+CelestialBody * CelestialBody::nextSatellite() const
+{
+	return mp_nextSatellite;
+}
+
+void CelestialBody::linkToCenter()
+{
+	if(mp_center == NULL) {
+		return;
+	}
+
+	mp_prevSatellite = NULL;
+	mp_nextSatellite = mp_center->mp_satellites;
+	if(mp_nextSatellite != NULL) {
+		mp_nextSatellite->mp_prevSatellite = this;
+	}
+	mp_center->mp_satellites = this;
+}
+
+void CelestialBody::unlinkFromCenter()
+{
+	if(mp_center == NULL) {
+		return;
+	}
+
+	if(mp_prevSatellite != NULL) {
+		mp_prevSatellite->mp_nextSatellite = mp_nextSatellite;
+	} else if(mp_center->mp_satellites == this) {
+		mp_center->mp_satellites = mp_nextSatellite;
+	}
+	if(mp_nextSatellite != NULL) {
+		mp_nextSatellite->mp_prevSatellite = mp_prevSatellite;
+	}
+	mp_nextSatellite = NULL;
+	mp_prevSatellite = NULL;
+}
+
 Real CelestialBody::radius() const
 {
 	return phys()->radius();
 }
 
+void CelestialBody::sector(int sector)
+{
+	m_sector = sector;
+}
+
+int CelestialBody::sector() const
+{
+	return m_sector;
+}
+
+bool CelestialBody::onRails() const
+{
+	return orbitComponent().onRails && mp_center != NULL;
+}
+
+void CelestialBody::onRails(bool onRails)
+{
+	orbitComponent().onRails = onRails;
+	updateKinematic();
+}
+
+void CelestialBody::orbitEpoch(double time)
+{
+	OrbitComponent & orbit = orbitComponent();
+	orbit.epoch = time;
+	orbit.time = -1;
+}
+
+void CelestialBody::evaluateOrbit(double time)
+{
+	OrbitComponent & orbit = orbitComponent();
+	if(!onRails() || orbit.time == time) {
+		return;
+	}
+
+	// The center must be placed first, since the orbit is relative to it
+	mp_center->evaluateOrbit(time);
+
+	Real angle = orbit.angle(time);
+	Real cosAngle = Math::Cos(angle);
+	Real sinAngle = Math::Sin(angle);
+	SphereCollisionObject * centerPhys = mp_center->phys();
+
+	phys()->position(centerPhys->position() + 
+		(orbit.axisU * cosAngle + orbit.axisV * sinAngle) * orbit.distance);
+	phys()->velocity(centerPhys->velocity() + 
+		(orbit.axisV * cosAngle - orbit.axisU * sinAngle) * (orbit.distance * orbit.angularSpeed));
+	orbit.time = time;
+}
+
+OrbitComponent & CelestialBody::orbitComponent()
+{
+	EntityStore * store = phys()->store();
+	return store == NULL ? m_localOrbit : *store->orbits().get(entity());
+}
+
+const OrbitComponent & CelestialBody::orbitComponent() const
+{
+	EntityStore * store = phys()->store();
+	return store == NULL ? m_localOrbit : *store->orbits().get(entity());
+}
+
+void CelestialBody::attach(EntityStore * store, EntityId entity)
+{
+	// The center is attached first, so its entity is known by now
+	OrbitComponent orbit = orbitComponent();
+	orbit.center = mp_center != NULL ? mp_center->entity() : NULL_ENTITY;
+	store->orbits().add(entity, orbit);
+	GameObject::attach(store, entity);
+	linkToCenter();
+}
+
+void CelestialBody::detach()
+{
+	EntityStore * store = phys()->store();
+	if(store == NULL) {
+		return;
+	}
+
+	unlinkFromCenter();
+	m_localOrbit = orbitComponent();
+	store->orbits().remove(entity());
+	GameObject::detach();
+}
+
 void CelestialBody::updatePhysics(Real timeElapsed)
 {
+	// Analytic orbits are evaluated by the GameArena from the total elapsed time
+	if(onRails()) {
+		return;
+	}
+
 	phys()->updatePhysics(timeElapsed);
 	
 	// DEBUG: Indestructible planets
@@ -366,6 +774,9 @@ PlasmaCannon * SpaceShip::addPlasmaCannon(const PlasmaCannon& weapon)
 {
 	PlasmaCannon * newCannon = memoryManager()->storeObject(PlasmaCannon(weapon));
 	mp_weapons.push_back(newCannon);
+	if(phys()->store() != NULL) {
+		newCannon->attach(phys()->store(), phys()->store()->createEntity());
+	}
 	return newCannon;
 }
 
@@ -373,6 +784,9 @@ AnchorLauncher * SpaceShip::addAnchorLauncher(const AnchorLauncher& weapon)
 {
 	AnchorLauncher * newLauncher = memoryManager()->storeObject(AnchorLauncher(weapon));
 	mp_weapons.push_back(newLauncher);
+	if(phys()->store() != NULL) {
+		newLauncher->attach(phys()->store(), phys()->store()->createEntity());
+	}
 	return newLauncher;
 }
 
@@ -384,8 +798,24 @@ Projectile * SpaceShip::fireWeapon(GameArena& arena, int weaponIndex)
 
 	if(mp_weapons[weaponIndex]->canShoot() && energy() > mp_weapons[weaponIndex]->energyCost()) {
 		drainEnergy(mp_weapons[weaponIndex]->energyCost());
-		return arena.addProjectile(mp_weapons[weaponIndex]->fireWeapon(*phys()));
+		Projectile shot = mp_weapons[weaponIndex]->fireWeapon(*phys());
+		shot.owner(phys()->serial());
+		Projectile * projectile = arena.addProjectile(shot);
+		arena.scheduleReload(mp_weapons[weaponIndex]);
+		return projectile;
 	}
+
+	return NULL;
+}
+
+int SpaceShip::numWeapons() const
+{
+	return mp_weapons.size();
+}
+
+Weapon * SpaceShip::weapon(int weaponIndex) const
+{
+	return mp_weapons[weaponIndex];
 }
 
 void SpaceShip::updatePhysics(Real timeElapsed) 
@@ -399,12 +829,98 @@ void SpaceShip::updatePhysics(Real timeElapsed)
 	}
 }
 
+void SpaceShip::attach(EntityStore * store, EntityId entity)
+{
+	GameObject::attach(store, entity);
+	for(std::vector<Weapon * >::iterator weaponIter = mp_weapons.begin(); 
+		weaponIter != mp_weapons.end();
+		weaponIter++)
+	{
+		(*weaponIter)->attach(store, store->createEntity());
+	}
+}
+
+void SpaceShip::detach()
+{
+	EntityStore * store = phys()->store();
+	if(store == NULL) {
+		return;
+	}
+
+	for(std::vector<Weapon * >::iterator weaponIter = mp_weapons.begin(); 
+		weaponIter != mp_weapons.end();
+		weaponIter++)
+	{
+		EntityId weaponEntity = (*weaponIter)->entity();
+		(*weaponIter)->detach();
+		store->destroyEntity(weaponEntity);
+	}
+	GameObject::detach();
+}
+
+// ========================================================================
+// PlayerInput Implementation
+// ========================================================================
+PlayerInput::PlayerInput() : thrustForward(false), thrustReverse(false), strafeLeft(false),
+	strafeRight(false), brake(false), rollLeft(false), rollRight(false), firePrimary(false),
+	fireSecondary(false), grapple(false), pitch(0), yaw(0)
+{
+}
+
+unsigned int PlayerInput::controls() const
+{
+	bool held[] = { thrustForward, thrustReverse, strafeLeft, strafeRight, brake, rollLeft, rollRight,
+		firePrimary, fireSecondary, grapple };
+	unsigned int bits = 0;
+	for(int i = 0; i < (int)(sizeof(held) / sizeof(bool)); i++) {
+		if(held[i]) {
+			bits |= 1 << i;
+		}
+	}
+	return bits;
+}
+
+void PlayerInput::controls(unsigned int bits)
+{
+	bool * held[] = { &thrustForward, &thrustReverse, &strafeLeft, &strafeRight, &brake, &rollLeft, &rollRight,
+		&firePrimary, &fireSecondary, &grapple };
+	for(int i = 0; i < (int)(sizeof(held) / sizeof(bool *)); i++) {
+		*held[i] = (bits & (1 << i)) != 0;
+	}
+}
+
+
+// ========================================================================
+// Contact Implementation
+// ========================================================================
+Contact::Contact() : objectA(NULL), objectB(NULL), time(0)
+{
+}
+
+Contact::Contact(GameObject * a, GameObject * b, double time) : objectA(a), objectB(b), time(time)
+{
+}
+
+
 // ========================================================================
 // GameArena Implementation
 // ========================================================================
 GameArena::GameArena(Real size, int pageSize, int initPages) : m_arenaSize(size), mp_playerShip(NULL), mp_npcShips(), mp_projectiles(),
-	mp_bodies(), mp_constraints(), mp_listeners(), m_memory(pageSize, initPages)
-{
+	m_projectilePool(), mp_bodies(), mp_constraints(), mp_listeners(), m_createdObjects(), m_createdConstraints(),
+	m_destroyedObjects(), m_destroyedConstraints(), mp_eventChannels(), m_memory(pageSize, initPages), m_entities(), m_lastSerial(0),
+	m_stepCount(0), m_timers(1.0f / 60), m_firedTimers(), m_npcRespawnDelay(0), m_pendingRespawns(0),
+	m_collisionMatrix(), m_workers(-1),
+	m_solver(4, &m_workers), m_galaxy(&m_workers), m_activeBodies(),
+	m_reducedBodies(), m_sectorBodiesDirty(true), m_reducedTime(0), m_simTime(0), m_stepTime(0), m_projectileContacts(),
+	m_shipContacts(), m_contacts(), m_deadNpcShips(), m_deadProjectiles(), m_deadBodies(),
+	m_deadConstraints(), m_analyticOrbits(true), m_worldRandom(0, 0),
+	m_simRandom(0, 1), m_seed(0), m_fixedStep(0), m_stepAccumulator(0), m_playerInput(), mp_recording(NULL),
+	mp_grapple(NULL),
+	m_npcShipTarget(0), m_spatialIndex(), m_spatialIndexDirty(true), m_spatialIndexMoved(false),
+	m_profiling(false), m_profileTimer(), m_phaseStart(0), m_profiledUpdates(0)
+{
+	resetProfile();
+	seed((unsigned long long)time(NULL));
 }
 
 GameArena::~GameArena() 
@@ -427,12 +943,7 @@ GameArena::~GameArena()
 		m_memory.destroyObject(*delIter);
 	}
 
-	for(std::vector<Projectile * >::iterator delIter =  mp_projectiles.begin(); 
-		delIter != mp_projectiles.end();
-		delIter++) 
-	{
-		m_memory.destroyObject(*delIter);
-	}
+	m_projectilePool.clear();
 
 	for(std::vector<Constraint * >::iterator delIter =  mp_constraints.begin(); 
 		delIter != mp_constraints.end();
@@ -443,43 +954,220 @@ GameArena::~GameArena()
 	
 }
 
-void GameArena::notifyObjectCreation(GameObject * object)
+/** Appends an object to an arena list, recording its position in the object */
+template<class T>
+void pushArenaObject(std::vector<T * >& list, T * object)
 {
-	for(std::vector<GameArenaListener * >::iterator listenerIter = mp_listeners.begin(); 
-		listenerIter != mp_listeners.end();
-		listenerIter++)
-	{
-		(*listenerIter)->newGameObject(object);
+	object->arenaIndex(list.size());
+	list.push_back(object);
+}
+
+/** @return True if the object is stored in the passed arena list */
+template<class T>
+bool inArenaList(const std::vector<T * >& list, T * object)
+{
+	int index = object->arenaIndex();
+	return index >= 0 && index < (int)list.size() && list[index] == object;
+}
+
+/** 
+ * Removes an object from an arena list in constant time, by moving the last object
+ * in the list into its slot.
+ * @return An iterator to the slot, which now holds the moved object (or end() if the
+ *         removed object was the last in the list)
+ */
+template<class T>
+typename std::vector<T * >::iterator popArenaObject(std::vector<T * >& list, T * object)
+{
+	int index = object->arenaIndex();
+	T * lastObject = list.back();
+	list[index] = lastObject;
+	lastObject->arenaIndex(index);
+	list.pop_back();
+	object->arenaIndex(-1);
+	return list.begin() + index;
+}
+
+/** @return True if the first object comes before the second in their arena list */
+template<class T>
+bool arenaOrder(const T * first, const T * second)
+{
+	return first->arenaIndex() < second->arenaIndex();
+}
+
+/** Appends every living constraint attached to the passed object to a list */
+void gatherConstraints(PhysicsObject * object, std::vector<Constraint * >& constraints)
+{
+	for(Constraint * constraint = object->constraints(); 
+		constraint != NULL;
+		constraint = constraint->next(object))
+	{
+		if(!constraint->dead()) {
+			constraints.push_back(constraint);
+		}
 	}
 }
 
-void GameArena::notifyObjectDestruction(GameObject * object)
+/** 
+ * Appends every living satellite of the passed body to a list (reparenting a satellite
+ * moves it to another satellite list, so satellites are gathered before being reparented)
+ */
+void gatherSatellites(CelestialBody * body, std::vector<CelestialBody * >& satellites)
 {
-	for(std::vector<GameArenaListener * >::iterator listenerIter = mp_listeners.begin(); 
-		listenerIter != mp_listeners.end();
-		listenerIter++)
+	for(CelestialBody * satellite = body->satellites(); 
+		satellite != NULL;
+		satellite = satellite->nextSatellite())
 	{
-		(*listenerIter)->destroyedGameObject(object);
+		if(!satellite->dead()) {
+			satellites.push_back(satellite);
+		}
+	}
+}
+
+/** 
+ * Removes every dead object from an arena list in a single pass, keeping the order
+ * of the living objects
+ */
+template<class T>
+void compactArenaList(std::vector<T * >& list)
+{
+	int liveCount = 0;
+	for(unsigned int i = 0; i < list.size(); i++) {
+		if(list[i]->dead()) {
+			list[i]->arenaIndex(-1);
+		} else {
+			list[i]->arenaIndex(liveCount);
+			list[liveCount++] = list[i];
+		}
+	}
+	list.resize(liveCount);
+}
+
+void GameArena::registerObject(GameObject * object, bool attach)
+{
+	if(attach) {
+		object->attach(&m_entities, m_entities.createEntity());
+	}
+	object->phys()->serial(++m_lastSerial);
+
+	// Spawns are published here, so they always precede events referring to the object
+	// (such as the adding of a new body's orbit constraint)
+	if(!mp_eventChannels.empty()) {
+		publishEvent(ArenaEvent(EVENT_OBJECT_SPAWNED, *object));
+	}
+}
+
+void GameArena::unregisterObject(GameObject * object)
+{
+	EntityId entity = object->entity();
+	object->detach();
+	m_entities.destroyEntity(entity);
+}
+
+void GameArena::notifyObjectCreation(GameObject * object)
+{
+	m_spatialIndexDirty = true;
+	if(!mp_listeners.empty()) {
+		m_createdObjects.push_back(object);
 	}
 }
 
+void GameArena::notifyObjectDestruction(GameObject * object)
+{
+	m_destroyedObjects.clear();
+	m_destroyedObjects.push_back(object);
+	notifyObjectDestructions(m_destroyedObjects);
+	m_destroyedObjects.clear();
+}
+
 void GameArena::notifyConstraintCreation(Constraint * constraint)
 {
+	if(!mp_eventChannels.empty()) {
+		publishEvent(ArenaEvent(EVENT_CONSTRAINT_ADDED, *constraint));
+	}
+	if(!mp_listeners.empty()) {
+		m_createdConstraints.push_back(constraint);
+	}
+}
+
+void GameArena::notifyConstraintDestruction(Constraint * constraint)
+{
+	m_destroyedConstraints.clear();
+	m_destroyedConstraints.push_back(constraint);
+	notifyConstraintDestructions(m_destroyedConstraints);
+	m_destroyedConstraints.clear();
+}
+
+void GameArena::notifyObjectDestructions(const std::vector<GameObject *>& objects)
+{
+	m_spatialIndexDirty = true;
+	if(objects.empty()) {
+		return;
+	}
+
+	flushNotifications();
 	for(std::vector<GameArenaListener * >::iterator listenerIter = mp_listeners.begin(); 
 		listenerIter != mp_listeners.end();
 		listenerIter++)
 	{
-		(*listenerIter)->newConstraint(constraint);
+		(*listenerIter)->destroyedGameObjects(objects);
+	}
+
+	if(!mp_eventChannels.empty()) {
+		for(std::vector<GameObject * >::const_iterator objectIter = objects.begin(); 
+			objectIter != objects.end();
+			objectIter++)
+		{
+			publishEvent(ArenaEvent(EVENT_OBJECT_DESTROYED, **objectIter));
+		}
 	}
 }
 
-void GameArena::notifyConstraintDestruction(Constraint * constraint)
+void GameArena::notifyConstraintDestructions(const std::vector<Constraint *>& constraints)
 {
+	if(constraints.empty()) {
+		return;
+	}
+
+	flushNotifications();
 	for(std::vector<GameArenaListener * >::iterator listenerIter = mp_listeners.begin(); 
 		listenerIter != mp_listeners.end();
 		listenerIter++)
 	{
-		(*listenerIter)->destroyedConstraint(constraint);
+		(*listenerIter)->destroyedConstraints(constraints);
+	}
+
+	if(!mp_eventChannels.empty()) {
+		for(std::vector<Constraint * >::const_iterator conIter = constraints.begin(); 
+			conIter != constraints.end();
+			conIter++)
+		{
+			publishEvent(ArenaEvent(EVENT_CONSTRAINT_REMOVED, **conIter));
+		}
+	}
+}
+
+void GameArena::flushNotifications()
+{
+	// Objects are reported before constraints, as constraints refer to them
+	if(!m_createdObjects.empty()) {
+		for(std::vector<GameArenaListener * >::iterator listenerIter = mp_listeners.begin(); 
+			listenerIter != mp_listeners.end();
+			listenerIter++)
+		{
+			(*listenerIter)->newGameObjects(m_createdObjects);
+		}
+		m_createdObjects.clear();
+	}
+
+	if(!m_createdConstraints.empty()) {
+		for(std::vector<GameArenaListener * >::iterator listenerIter = mp_listeners.begin(); 
+			listenerIter != mp_listeners.end();
+			listenerIter++)
+		{
+			(*listenerIter)->newConstraints(m_createdConstraints);
+		}
+		m_createdConstraints.clear();
 	}
 }
 
@@ -493,13 +1181,36 @@ void GameArena::removeGameArenaListener(GameArenaListener * listener)
 	mp_listeners.erase(std::remove(mp_listeners.begin(), mp_listeners.end(), listener), mp_listeners.end());
 }
 
+void GameArena::addEventChannel(EventChannel * channel)
+{
+	mp_eventChannels.push_back(channel);
+}
+
+void GameArena::removeEventChannel(EventChannel * channel)
+{
+	mp_eventChannels.erase(std::remove(mp_eventChannels.begin(), mp_eventChannels.end(), channel), mp_eventChannels.end());
+}
+
+void GameArena::publishEvent(const ArenaEvent & event)
+{
+	// Full channels drop the event (see EventChannel::push()), the arena never waits
+	for(std::vector<EventChannel * >::iterator channelIter = mp_eventChannels.begin(); 
+		channelIter != mp_eventChannels.end();
+		channelIter++)
+	{
+		(*channelIter)->push(event);
+	}
+}
+
 Real GameArena::size() const {
 	return m_arenaSize;
 }
 
 SpaceShip * GameArena::setPlayerShip(const SpaceShip& ship) {
 	if(mp_playerShip != NULL) {
+		destroyAttachedConstraints(mp_playerShip->phys());
 		notifyObjectDestruction(mp_playerShip);
+		unregisterObject(mp_playerShip);
 		m_memory.destroyObject(&mp_playerShip);
 		mp_playerShip = NULL;
 	}
@@ -507,6 +1218,7 @@ SpaceShip * GameArena::setPlayerShip(const SpaceShip& ship) {
 	// TODO: Deconstructor needs to handle deleting this
 	// memory
 	mp_playerShip = memoryManager()->storeObject(SpaceShip(ship));
+	registerObject(mp_playerShip);
 	notifyObjectCreation(mp_playerShip);
 
 	return mp_playerShip;
@@ -515,15 +1227,23 @@ SpaceShip * GameArena::setPlayerShip(const SpaceShip& ship) {
 SpaceShip * GameArena::addNpcShip(const SpaceShip& ship)
 {
 	SpaceShip * p_ship = m_memory.storeObject(ship);
-	mp_npcShips.push_back(p_ship);
+	registerObject(p_ship);
+	pushArenaObject(mp_npcShips, p_ship);
 	notifyObjectCreation(p_ship);
 	return p_ship;
 }
 
 Projectile * GameArena::addProjectile(const Projectile& projectile)
 {
-	Projectile * p_projectile = m_memory.storeObject(projectile);
-	mp_projectiles.push_back(p_projectile);
+	PoolId id;
+	Projectile * p_projectile = m_projectilePool.storeObject(projectile, &id);
+	p_projectile->id(id);
+	registerObject(p_projectile, false);
+
+	// Projectiles are expired by a timer, rather than checking every projectile's age on each update
+	const LifetimeComponent & lifetime = p_projectile->lifetimeComponent();
+	m_timers.schedule(m_simTime + lifetime.lifeTime - lifetime.elapsedTime, TIMER_PROJECTILE_EXPIRY, id, NULL);
+	pushArenaObject(mp_projectiles, p_projectile);
 	notifyObjectCreation(p_projectile);
 	return p_projectile;
 }
@@ -531,7 +1251,9 @@ Projectile * GameArena::addProjectile(const Projectile& projectile)
 Constraint * GameArena::addConstraint(const Constraint& constraint)
 {
 	Constraint * p_constraint = m_memory.storeObject(constraint);
-	mp_constraints.push_back(p_constraint);
+	p_constraint->link();
+	pushArenaObject(mp_constraints, p_constraint);
+	m_solver.invalidate();
 	notifyConstraintCreation(p_constraint);
 	return p_constraint;
 }
@@ -539,428 +1261,1462 @@ Constraint * GameArena::addConstraint(const Constraint& constraint)
 CelestialBody * GameArena::addBody(const CelestialBody& body)
 {
 	CelestialBody * p_body = m_memory.storeObject(body);
+	registerObject(p_body);
 	if(p_body->hasCenter()) {
-		addConstraint(p_body->constraint());
+		if(m_analyticOrbits && p_body->onRails()) {
+			p_body->orbitEpoch(m_simTime);
+		} else {
+			p_body->onRails(false);
+			addConstraint(p_body->constraint());
+		}
 	}
-	mp_bodies.push_back(p_body);
+	pushArenaObject(mp_bodies, p_body);
 	notifyObjectCreation(p_body);
+	m_sectorBodiesDirty = true;
 	return p_body;
 }
 
 std::vector<CelestialBody * >::iterator GameArena::destroyBody(CelestialBody * body)
 {
-	std::vector<CelestialBody * >::iterator returnIter;
-	CelestialBody * bodyCenter = body->center();
-	bool foundBody = false;
+	if(!inArenaList(mp_bodies, body)) {
+		// TODO: Throw exception, body not found
+		return mp_bodies.end();
+	}
 
-	for(std::vector<CelestialBody * >::iterator iter =  mp_bodies.begin(); 
-		iter != mp_bodies.end();)
+	// Satellites of the body are passed on to the body's own center (in arena order)
+	CelestialBody * bodyCenter = body->center();
+	std::vector<CelestialBody * > satellites;
+	gatherSatellites(body, satellites);
+	std::sort(satellites.begin(), satellites.end(), arenaOrder<CelestialBody>);
+	for(std::vector<CelestialBody * >::iterator iter =  satellites.begin(); 
+		iter != satellites.end();
+		iter++)
 	{
-		if((*iter)->hasCenter() && (*iter)->center() == body) {
-			(*iter)->center(bodyCenter);
-			if(bodyCenter != NULL) {
-				addConstraint((*iter)->constraint());
-			}
+		// Orphaned satellites always fall back to dynamic simulation
+		(*iter)->onRails(false);
+		(*iter)->center(bodyCenter);
+		if(bodyCenter != NULL) {
+			addConstraint((*iter)->constraint());
 		}
+	}
 
-		if(foundBody == false && *iter == body) {
+	// Ensure any constraints attached to this body are also destroyed
+	destroyAttachedConstraints(body->phys());
 
-			// Ensure any constraints attached to this body are also destroyed
-			for(std::vector<Constraint * >::iterator conIter =  mp_constraints.begin(); 
-				conIter != mp_constraints.end();)
-			{
-				SphereCollisionObject * bodyPhys = body->phys();
-				if((*conIter)->getTarget() == bodyPhys || (*conIter)->getOrigin() == bodyPhys)
-				{
-					conIter = destroyConstraint(*conIter);
-				} else {
-					conIter++;
-				}
-			}
+	std::vector<CelestialBody * >::iterator returnIter = popArenaObject(mp_bodies, body);
+	m_sectorBodiesDirty = true;
+	notifyObjectDestruction(body);
+	unregisterObject(body);
+	m_memory.destroyObject(body);
+	return returnIter;
+}
 
-			returnIter = mp_bodies.erase(iter);
-			iter = returnIter;
-			foundBody = true;
-		} else {
-			iter++;
-		}
+void GameArena::releaseOrbit(CelestialBody * body)
+{
+	if(!body->onRails()) {
+		return;
 	}
 
-	if(foundBody) {
-		notifyObjectDestruction(body);
-		m_memory.destroyObject(body);
-		return returnIter;
-	} else {
-		// TODO: Throw exception, constraint not found
-		return mp_bodies.end();
-	}
+	body->onRails(false);
+	addConstraint(body->constraint());
 }
 
-std::vector<Constraint * >::iterator GameArena::destroyConstraint(Constraint * constraint) 
+void GameArena::destroyAttachedConstraints(PhysicsObject * object)
 {
-	for(std::vector<Constraint * >::iterator iter =  mp_constraints.begin(); 
-		iter != mp_constraints.end();
-		iter++)
+	std::vector<Constraint * > constraints;
+	gatherConstraints(object, constraints);
+	for(std::vector<Constraint * >::iterator conIter =  constraints.begin(); 
+		conIter != constraints.end();
+		conIter++)
 	{
-		if(*iter == constraint) {
-			notifyConstraintDestruction(constraint);
-			m_memory.destroyObject(constraint);
-			return mp_constraints.erase(iter);
-		}
+		destroyConstraint(*conIter);
 	}
-	
-	// TODO: Throw exception, constraint not found
-	return mp_constraints.end();
 }
 
-std::vector<Projectile * >::iterator GameArena::destroyProjectile(Projectile * projectile) 
+std::vector<Constraint * >::iterator GameArena::destroyConstraint(Constraint * constraint) 
 {
-	for(std::vector<Projectile * >::iterator iter =  mp_projectiles.begin(); 
-		iter != mp_projectiles.end();
-		iter++)
-	{
-		if(*iter == projectile) {
-			notifyObjectDestruction(projectile);
-			m_memory.destroyObject(projectile);
-			return mp_projectiles.erase(iter);
-		}
+	if(!inArenaList(mp_constraints, constraint)) {
+		// TODO: Throw exception, constraint not found
+		return mp_constraints.end();
 	}
-	
-	// TODO: Throw exception, projectile not found
-	return mp_projectiles.end();
+
+	if(constraint == mp_grapple) {
+		mp_grapple = NULL;
+	}
+	std::vector<Constraint * >::iterator returnIter = popArenaObject(mp_constraints, constraint);
+	notifyConstraintDestruction(constraint);
+	constraint->unlink();
+	m_memory.destroyObject(constraint);
+	m_solver.invalidate();
+	return returnIter;
 }
 
-std::vector<SpaceShip * >::iterator GameArena::destroyNpcShip(SpaceShip * npcShip) 
+std::vector<Projectile * >::iterator GameArena::destroyProjectile(Projectile * projectile) 
 {
-	for(std::vector<SpaceShip * >::iterator iter =  mp_npcShips.begin(); 
-		iter != mp_npcShips.end();
-		iter++)
-	{
-		if(*iter == npcShip) 
-		{
-			// Ensure any constraints attached to this ship are also destroyed
-			for(std::vector<Constraint * >::iterator conIter =  mp_constraints.begin(); 
-				conIter != mp_constraints.end();)
-			{
-				SphereCollisionObject * shipPhys = npcShip->phys();
-				if((*conIter)->getTarget() == shipPhys || (*conIter)->getOrigin() == shipPhys)
-				{
-					conIter = destroyConstraint(*conIter);
-				} else {
-					conIter++;
-				}
-			}
-			notifyObjectDestruction(npcShip);
-			m_memory.destroyObject(npcShip);
-			return mp_npcShips.erase(iter);
-		}
+	if(!inArenaList(mp_projectiles, projectile)) {
+		// TODO: Throw exception, projectile not found
+		return mp_projectiles.end();
 	}
 
-	// TODO: Throw exception, ship not found
-	return mp_npcShips.end();
+	std::vector<Projectile * >::iterator returnIter = popArenaObject(mp_projectiles, projectile);
+	notifyObjectDestruction(projectile);
+	unregisterObject(projectile);
+	m_projectilePool.destroyObject(projectile->id());
+	return returnIter;
 }
 
-SpaceShip * GameArena::playerShip()
+std::vector<SpaceShip * >::iterator GameArena::destroyNpcShip(SpaceShip * npcShip) 
 {
-	return mp_playerShip;
-}
+	if(!inArenaList(mp_npcShips, npcShip)) {
+		// TODO: Throw exception, ship not found
+		return mp_npcShips.end();
+	}
 
-Projectile * GameArena::fireProjectileFromShip(SpaceShip * ship, int weaponIndex)
-{
-	return ship->fireWeapon(*this, weaponIndex);
-}
+	// Ensure any constraints attached to this ship are also destroyed
+	destroyAttachedConstraints(npcShip->phys());
 
-std::vector<Projectile *> * GameArena::projectiles() {
-	return & mp_projectiles;
+	std::vector<SpaceShip * >::iterator returnIter = popArenaObject(mp_npcShips, npcShip);
+	notifyObjectDestruction(npcShip);
+	unregisterObject(npcShip);
+	m_memory.destroyObject(npcShip);
+	return returnIter;
 }
 
-std::vector<SpaceShip *> * GameArena::npcShips() {
-	return & mp_npcShips;
+void GameArena::killNpcShip(SpaceShip * npcShip)
+{
+	if(!npcShip->dead() && inArenaList(mp_npcShips, npcShip)) {
+		npcShip->dead(true);
+		m_deadNpcShips.push_back(npcShip);
+	}
 }
 
-std::vector<CelestialBody *> * GameArena::bodies() {
-	return & mp_bodies;
+void GameArena::killProjectile(Projectile * projectile)
+{
+	if(!projectile->dead() && inArenaList(mp_projectiles, projectile)) {
+		projectile->dead(true);
+		m_deadProjectiles.push_back(projectile);
+	}
 }
 
-void GameArena::updatePhysics(Real timeElapsed)
+void GameArena::killBody(CelestialBody * body)
 {
-	// Apply forces from constraints
-	for(std::vector<Constraint * >::iterator conIter =  mp_constraints.begin(); 
-		conIter != mp_constraints.end();
-		conIter++)
-	{
-		(*conIter)->applyForces(timeElapsed);
+	if(!body->dead() && inArenaList(mp_bodies, body)) {
+		body->dead(true);
+		m_deadBodies.push_back(body);
 	}
+}
 
-	// Update physics for orbiting bodies
-	for(std::vector<CelestialBody * >::iterator bodyIter =  mp_bodies.begin(); 
-		bodyIter != mp_bodies.end();
-		bodyIter++) 
-	{
-		(*bodyIter)->updatePhysics(timeElapsed);
+void GameArena::killConstraint(Constraint * constraint)
+{
+	if(!constraint->dead() && inArenaList(mp_constraints, constraint)) {
+		constraint->dead(true);
+		m_deadConstraints.push_back(constraint);
 	}
+}
 
-	// Update the player ship's physics, and reverse its velocity if it passes a wall
-	if(mp_playerShip != NULL) 
+void GameArena::reclaimDead()
+{
+	if(m_deadNpcShips.empty() && m_deadProjectiles.empty() && m_deadBodies.empty() 
+		&& m_deadConstraints.empty()) 
 	{
-		mp_playerShip->updatePhysics(timeElapsed);
-		mp_playerShip->addEnergy(mp_playerShip->energyRecharge() * timeElapsed);
-		SphereCollisionObject * playerShipPhys = mp_playerShip->phys();
-
-		/*
-		if(playerShipPhys->position().x > m_arenaSize || playerShipPhys->position().x < - m_arenaSize
-			|| playerShipPhys->position().y > m_arenaSize || playerShipPhys->position().y < - m_arenaSize
-			|| playerShipPhys->position().z > m_arenaSize || playerShipPhys->position().z < - m_arenaSize) 
-		{
-			// playerShipPhys->velocity(playerShipPhys->velocity() * Vector3(-1, -1, -1));
-			
-			// Slowly drain health if outside game boundaries
-			// mp_playerShip->health(mp_playerShip->health() - (timeElapsed * 5));
-		}
-		*/
+		return;
 	}
 
-	// Update physics for all NPC ships
-	for(std::vector<SpaceShip * >::iterator shipIter =  mp_npcShips.begin(); 
-		shipIter != mp_npcShips.end();
-		shipIter++) 
-	{
-		(*shipIter)->updatePhysics(timeElapsed);
-		(*shipIter)->addEnergy((*shipIter)->energyRecharge() * timeElapsed);
-		SphereCollisionObject * shipPhys = (*shipIter)->phys();
-
-		if(shipPhys->position().x > m_arenaSize || shipPhys->position().x < - m_arenaSize
-			|| shipPhys->position().y > m_arenaSize || shipPhys->position().y < - m_arenaSize
-			|| shipPhys->position().z > m_arenaSize || shipPhys->position().z < - m_arenaSize) 
+	// Pass the satellites of dead bodies on to their nearest living center (in arena order)
+	if(!m_deadBodies.empty()) {
+		std::vector<CelestialBody * > orphans;
+		for(std::vector<CelestialBody * >::iterator bodyIter =  m_deadBodies.begin(); 
+			bodyIter != m_deadBodies.end();
+			bodyIter++)
 		{
-			shipPhys->velocity(shipPhys->velocity() * Vector3(-1, -1, -1));
+			gatherSatellites(*bodyIter, orphans);
 		}
-		shipPhys->orientation(Vector3(0, 0, -1).getRotationTo(shipPhys->velocity()));
-	}
-
-	// Update physics for projectiles and check for collisions
-	for(std::vector<Projectile * >::iterator projIter =  mp_projectiles.begin(); 
-		projIter != mp_projectiles.end(); )
-	{
-		(*projIter)->updatePhysics(timeElapsed);
-		SphereCollisionObject * projPhys = (*projIter)->phys();
+		std::sort(orphans.begin(), orphans.end(), arenaOrder<CelestialBody>);
 
-		if((*projIter)->expired()) 
+		for(std::vector<CelestialBody * >::iterator bodyIter =  orphans.begin(); 
+			bodyIter != orphans.end();
+			bodyIter++)
 		{
-			projIter = destroyProjectile((*projIter));
-			continue;
-		}
+			CelestialBody * body = *bodyIter;
+			CelestialBody * bodyCenter = body->center();
+			while(bodyCenter != NULL && bodyCenter->dead()) {
+				bodyCenter = bodyCenter->center();
+			}
 
-		bool projDestroyed = false;
-		for(std::vector<SpaceShip * >::iterator shipIter =  mp_npcShips.begin(); 
-			shipIter != mp_npcShips.end();
-			shipIter++) 
-		{
-			if(projPhys->checkCollision(*(*shipIter)->phys())) 
-			{
-				(*shipIter)->inflictDamage((*projIter)->damage());
-				projIter = destroyProjectile(*projIter);
-				projDestroyed = true;
-				break;
+			// Orphaned satellites always fall back to dynamic simulation
+			body->onRails(false);
+			body->center(bodyCenter);
+			if(bodyCenter != NULL) {
+				addConstraint(body->constraint());
 			}
 		}
+	}
 
-		if(!projDestroyed) 
-		{
-			projIter++;
-		}
+	// Kill any constraints attached to dead objects (in arena order)
+	std::vector<Constraint * > attached;
+	for(std::vector<CelestialBody * >::iterator bodyIter =  m_deadBodies.begin(); 
+		bodyIter != m_deadBodies.end();
+		bodyIter++)
+	{
+		gatherConstraints((*bodyIter)->phys(), attached);
 	}
 
-	// Deal fatal damage to any entity that collides with a celestial body
-	for(std::vector<CelestialBody * >::iterator bodyIter =  mp_bodies.begin(); 
-		bodyIter != mp_bodies.end(); 
-		bodyIter++) 
+	for(std::vector<SpaceShip * >::iterator shipIter =  m_deadNpcShips.begin(); 
+		shipIter != m_deadNpcShips.end();
+		shipIter++)
 	{
-		if((*bodyIter)->phys()->checkCollision(*(mp_playerShip->phys()))) {
-			mp_playerShip->inflictDamage(500);
-		}
+		gatherConstraints((*shipIter)->phys(), attached);
+	}
 
-		for(std::vector<Projectile * >::iterator projIter =  mp_projectiles.begin(); 
-			projIter != mp_projectiles.end(); )
-		{
-			if((*bodyIter)->phys()->checkCollision(*(*projIter)->phys())) {
-				
-				// DEBUG: Allow projectiles to damage planets
-				if((*bodyIter)->type() != STAR && (*projIter)->type() != PLANET_CHUNK) {
-					(*bodyIter)->inflictDamage((*projIter)->damage());
-				}
+	for(std::vector<Projectile * >::iterator projIter =  m_deadProjectiles.begin(); 
+		projIter != m_deadProjectiles.end();
+		projIter++)
+	{
+		gatherConstraints((*projIter)->phys(), attached);
+	}
 
-				projIter = destroyProjectile(*projIter);
-			} else {
-				projIter++;
-			}
-		}
-		
-		for(std::vector<SpaceShip * >::iterator shipIter =  mp_npcShips.begin(); 
-		shipIter != mp_npcShips.end();) 
-		{
-			if((*bodyIter)->phys()->checkCollision(*(*shipIter)->phys())) {
-				shipIter = destroyNpcShip(*shipIter);
-			} else {
-				shipIter++;
-			}
-		}
+	std::sort(attached.begin(), attached.end(), arenaOrder<Constraint>);
+	for(std::vector<Constraint * >::iterator conIter =  attached.begin(); 
+		conIter != attached.end();
+		conIter++)
+	{
+		killConstraint(*conIter);
+	}
 
-		// Check for body on body collisions, and deal fatal damage to the smaller
-		// body in any collision
-		for(std::vector<CelestialBody * >::iterator colBodyIter =  mp_bodies.begin(); 
-			colBodyIter != mp_bodies.end();
-			colBodyIter++)
-		{
-			if((*bodyIter) != (*colBodyIter)
-				&& (*bodyIter)->phys()->checkCollision(*(*colBodyIter)->phys())) {
+	compactArenaList(mp_npcShips);
+	compactArenaList(mp_projectiles);
+	compactArenaList(mp_bodies);
+	compactArenaList(mp_constraints);
+	if(!m_deadBodies.empty()) {
+		m_sectorBodiesDirty = true;
+	}
 
-				// Two celestial bodies collided, deal fatal damage to the smaller
-				// of the two
-				if((*bodyIter)->radius() > (*colBodyIter)->radius()) {
-					(*colBodyIter)->inflictDamage(10000);
-				} else {
-					(*bodyIter)->inflictDamage(10000);
-				}
-			}
+	// Notify listeners of every destruction in two batches (then release the entities) before 
+	// any memory is released
+	notifyConstraintDestructions(m_deadConstraints);
+	for(std::vector<Constraint * >::iterator conIter =  m_deadConstraints.begin(); 
+		conIter != m_deadConstraints.end();
+		conIter++)
+	{
+		if(*conIter == mp_grapple) {
+			mp_grapple = NULL;
 		}
+		(*conIter)->unlink();
 	}
 
-	// Detonate any planet with less than 0 health
-	for(std::vector<CelestialBody * >::iterator bodyIter =  mp_bodies.begin(); 
-		bodyIter != mp_bodies.end(); ) 
+	m_destroyedObjects.clear();
+	m_destroyedObjects.insert(m_destroyedObjects.end(), m_deadBodies.begin(), m_deadBodies.end());
+	m_destroyedObjects.insert(m_destroyedObjects.end(), m_deadNpcShips.begin(), m_deadNpcShips.end());
+	m_destroyedObjects.insert(m_destroyedObjects.end(), m_deadProjectiles.begin(), m_deadProjectiles.end());
+	notifyObjectDestructions(m_destroyedObjects);
+	for(std::vector<GameObject * >::iterator objectIter =  m_destroyedObjects.begin(); 
+		objectIter != m_destroyedObjects.end();
+		objectIter++)
 	{
-		if((*bodyIter)->health() < 0) {
-			// Generate random projectiles originating from the center of the
-			// detonating body
-			Real radius = (*bodyIter)->radius();
-			Vector3 centerVelocity = (*bodyIter)->phys()->velocity();
-			Vector3 center = (*bodyIter)->phys()->position();
+		unregisterObject(*objectIter);
+	}
+	m_destroyedObjects.clear();
 
-			for(int i = 0; i < 20; i++) {
-				Real randAngle = Math::UnitRandom() * (2 * Math::PI);
-				Real randMu = Math::RangeRandom(-1, 1);
-				Vector3 pointOnUnitSphere = Vector3(
-					Math::Cos(randAngle) * Math::Sqrt(1 - Math::Sqr(randMu)),
-					randMu,
-					Math::Sin(randAngle) * Math::Sqrt(1 - Math::Sqr(randMu)));
-				Vector3 relOffset = pointOnUnitSphere * radius * Math::RangeRandom(0, 1);
-					
-				SphereCollisionObject projectilePhysics = SphereCollisionObject(500, 1, relOffset + center);
-				projectilePhysics.velocity(relOffset.normalisedCopy() * 4000 + centerVelocity);
-				addProjectile(Projectile(projectilePhysics, ObjectType::PLANET_CHUNK, 50, 10, &m_memory));
-			}
+	if(!m_deadConstraints.empty()) {
+		m_solver.invalidate();
+	}
 
-			bodyIter = destroyBody(*bodyIter);
-		} else {
-			bodyIter++;
+	// Killed NPC ships are replaced once the respawn delay has passed
+	if(m_npcRespawnDelay > 0) {
+		for(unsigned int i = 0; i < m_deadNpcShips.size(); i++) {
+			m_pendingRespawns++;
+			m_timers.schedule(m_simTime + m_npcRespawnDelay, TIMER_NPC_RESPAWN, 0, NULL);
 		}
 	}
 
-	// After all projectile collisions, remove any ships with less than 0 health
-	for(std::vector<SpaceShip * >::iterator shipIter =  mp_npcShips.begin(); 
-		shipIter != mp_npcShips.end();) 
+	m_memory.destroyObjects(m_deadConstraints);
+	m_memory.destroyObjects(m_deadBodies);
+	m_memory.destroyObjects(m_deadNpcShips);
+	for(std::vector<Projectile * >::iterator projIter =  m_deadProjectiles.begin(); 
+		projIter != m_deadProjectiles.end();
+		projIter++)
 	{
-			if ((*shipIter)->health() <= 0)
-			{
-				shipIter = destroyNpcShip((*shipIter));
-			}
-			else
-			{
-				shipIter++;
-			}
+		m_projectilePool.destroyObject((*projIter)->id());
 	}
 
-	// Reset the player ship if they "die"
-	if(mp_playerShip->health() <= 0) {
-		mp_playerShip->health(mp_playerShip->maxHealth());
-		mp_playerShip->phys()->velocity(Vector3(0, 0, 0));
-		mp_playerShip->phys()->position(Vector3(10000, 10000, 10000));
-	}
+	m_deadConstraints.clear();
+	m_deadBodies.clear();
+	m_deadNpcShips.clear();
+	m_deadProjectiles.clear();
 }
 
-
-void GameArena::generateSolarSystem() 
+SpaceShip * GameArena::playerShip()
 {
-	// Generate a star in the middle of the arena
-	CelestialBody * star = addBody(CelestialBody(ObjectType::STAR, 100000, 10000, Vector3(0, 0, 0), &m_memory));
-	Real totalDistance = 5000;
-
-	// TODO: This should be refactored to remove copy/pasting code
+	return mp_playerShip;
+}
 
-	// Inner planets
-	int numInnerPlanets = rand() % 5 + 3;
-	// Add a random number of planents
-	for(int i = 0; i < numInnerPlanets; i++) {
-		totalDistance += Math::RangeRandom(4000, 7000);
-		Real planetRadius = Math::RangeRandom(500, 2000);
-		Real speed = Math::RangeRandom(2000, 8000);
+Projectile * GameArena::fireProjectileFromShip(SpaceShip * ship, int weaponIndex)
+{
+	return ship->fireWeapon(*this, weaponIndex);
+}
+
+std::vector<Projectile *> * GameArena::projectiles() {
+	return & mp_projectiles;
+}
+
+Projectile * GameArena::projectile(PoolId id) {
+	return m_projectilePool.get(id);
+}
+
+std::vector<SpaceShip *> * GameArena::npcShips() {
+	return & mp_npcShips;
+}
+
+const std::vector<Contact> * GameArena::contacts() const {
+	return & m_contacts;
+}
+
+CollisionMatrix * GameArena::collisionMatrix() {
+	return & m_collisionMatrix;
+}
+
+void GameArena::updateSpatialIndex()
+{
+	if(!m_spatialIndexDirty) {
+		if(m_spatialIndexMoved) {
+			for(int i = 0; i < m_spatialIndex.size(); i++) {
+				SphereCollisionObject * objectPhys = m_spatialIndex.entry(i).object->phys();
+				m_spatialIndex.move(i, objectPhys->position(), objectPhys->radius());
+			}
+			m_spatialIndex.refit();
+			m_spatialIndexMoved = false;
+		}
+		return;
+	}
+
+	m_spatialIndex.clear();
+	if(mp_playerShip != NULL) {
+		m_spatialIndex.add(SpatialEntry(mp_playerShip->phys()->position(), mp_playerShip->phys()->radius(),
+			1 << mp_playerShip->type(), mp_playerShip));
+	}
+
+	for(std::vector<SpaceShip * >::iterator shipIter = mp_npcShips.begin(); 
+		shipIter != mp_npcShips.end();
+		shipIter++) 
+	{
+		m_spatialIndex.add(SpatialEntry((*shipIter)->phys()->position(), (*shipIter)->phys()->radius(),
+			1 << (*shipIter)->type(), *shipIter));
+	}
+
+	for(std::vector<Projectile * >::iterator projIter = mp_projectiles.begin(); 
+		projIter != mp_projectiles.end();
+		projIter++) 
+	{
+		m_spatialIndex.add(SpatialEntry((*projIter)->phys()->position(), (*projIter)->phys()->radius(),
+			1 << (*projIter)->type(), *projIter));
+	}
+
+	for(std::vector<CelestialBody * >::iterator bodyIter = mp_bodies.begin(); 
+		bodyIter != mp_bodies.end();
+		bodyIter++) 
+	{
+		m_spatialIndex.add(SpatialEntry((*bodyIter)->phys()->position(), (*bodyIter)->phys()->radius(),
+			1 << (*bodyIter)->type(), *bodyIter));
+	}
+
+	m_spatialIndex.build();
+	m_spatialIndexDirty = false;
+	m_spatialIndexMoved = false;
+}
+
+bool GameArena::raycast(const Vector3 & origin, const Vector3 & direction, Real maxDistance, RayHit & hit,
+	unsigned int typeMask)
+{
+	updateSpatialIndex();
+	return m_spatialIndex.raycast(origin, direction, maxDistance, typeMask, hit);
+}
+
+int GameArena::raycastAll(const Vector3 & origin, const Vector3 & direction, Real maxDistance, 
+	std::vector<RayHit> & hits, unsigned int typeMask)
+{
+	updateSpatialIndex();
+	return m_spatialIndex.raycastAll(origin, direction, maxDistance, typeMask, hits);
+}
+
+bool GameArena::sphereCast(const Vector3 & origin, Real radius, const Vector3 & direction, Real maxDistance,
+	RayHit & hit, unsigned int typeMask)
+{
+	updateSpatialIndex();
+	return m_spatialIndex.sphereCast(origin, radius, direction, maxDistance, typeMask, hit);
+}
+
+int GameArena::sphereCastAll(const Vector3 & origin, Real radius, const Vector3 & direction, Real maxDistance,
+	std::vector<RayHit> & hits, unsigned int typeMask)
+{
+	updateSpatialIndex();
+	return m_spatialIndex.sphereCastAll(origin, radius, direction, maxDistance, typeMask, hits);
+}
+
+int GameArena::queryNearest(const Vector3 & position, int k, unsigned int typeMask, SpatialResult * results)
+{
+	updateSpatialIndex();
+	return m_spatialIndex.queryNearest(position, k, typeMask, results);
+}
+
+int GameArena::queryRadius(const Vector3 & position, Real radius, unsigned int typeMask, SpatialResult * results,
+	int maxResults)
+{
+	updateSpatialIndex();
+	return m_spatialIndex.queryRadius(position, radius, typeMask, results, maxResults);
+}
+
+std::vector<CelestialBody *> * GameArena::bodies() {
+	return & mp_bodies;
+}
+
+std::vector<Constraint *> * GameArena::constraints() {
+	return & mp_constraints;
+}
+
+EntityStore * GameArena::entities() {
+	return & m_entities;
+}
+
+double GameArena::simTime() const
+{
+	return m_simTime;
+}
+
+void GameArena::profiling(bool enabled)
+{
+	m_profiling = enabled;
+}
+
+bool GameArena::profiling() const
+{
+	return m_profiling;
+}
+
+void GameArena::resetProfile()
+{
+	for(int i = 0; i < NUM_UPDATE_PHASES; i++) {
+		m_phaseTimes[i] = 0;
+	}
+	m_profiledUpdates = 0;
+}
+
+unsigned long GameArena::phaseTime(UpdatePhase phase) const
+{
+	return m_phaseTimes[phase];
+}
+
+unsigned long GameArena::profiledUpdates() const
+{
+	return m_profiledUpdates;
+}
+
+void GameArena::endPhase(UpdatePhase phase)
+{
+	if(!m_profiling) {
+		return;
+	}
+
+	// Phases are timed back to back from a single reading at each boundary, so the
+	// per phase totals always sum to the total time spent updating
+	unsigned long now = m_profileTimer.getMicroseconds();
+	m_phaseTimes[phase] += now - m_phaseStart;
+	m_phaseStart = now;
+}
+
+void GameArena::analyticOrbits(bool analytic)
+{
+	m_analyticOrbits = analytic;
+}
+
+bool GameArena::analyticOrbits() const
+{
+	return m_analyticOrbits;
+}
+
+void GameArena::constraintIterations(int iterations)
+{
+	m_solver.iterations(iterations);
+}
+
+int GameArena::constraintIterations() const
+{
+	return m_solver.iterations();
+}
+
+void GameArena::seed(unsigned long long seed)
+{
+	m_worldRandom.seed(seed, 0);
+	m_simRandom.seed(seed, 1);
+	m_seed = seed;
+}
+
+unsigned long long GameArena::seed() const
+{
+	return m_seed;
+}
+
+void GameArena::fixedStep(Real step)
+{
+	m_fixedStep = step > 0 ? step : 0;
+	m_stepAccumulator = 0;
+}
+
+Real GameArena::fixedStep() const
+{
+	return m_fixedStep;
+}
+
+void GameArena::playerInput(const PlayerInput& input)
+{
+	Real pitch = m_playerInput.pitch + input.pitch;
+	Real yaw = m_playerInput.yaw + input.yaw;
+	m_playerInput = input;
+	m_playerInput.pitch = pitch;
+	m_playerInput.yaw = yaw;
+}
+
+void GameArena::npcShipTarget(int count)
+{
+	m_npcShipTarget = count;
+}
+
+int GameArena::npcShipTarget() const
+{
+	return m_npcShipTarget;
+}
+
+void GameArena::npcRespawnDelay(Real delay)
+{
+	m_npcRespawnDelay = delay;
+}
+
+Real GameArena::npcRespawnDelay() const
+{
+	return m_npcRespawnDelay;
+}
+
+void GameArena::scheduleReload(Weapon * weapon)
+{
+	m_timers.schedule(m_simTime + weapon->reloadTime(), TIMER_WEAPON_RELOAD, weapon->entity(), NULL);
+}
+
+void GameArena::fireTimers()
+{
+	m_firedTimers.clear();
+	m_timers.advance(m_simTime, m_firedTimers);
+	for(std::vector<TimerEvent>::iterator timerIter = m_firedTimers.begin(); 
+		timerIter != m_firedTimers.end();
+		timerIter++)
+	{
+		switch(timerIter->type) {
+		case TIMER_PROJECTILE_EXPIRY:
+			{
+				// The projectile may already have been destroyed (its id is then stale)
+				Projectile * projectile = m_projectilePool.get(timerIter->id);
+				if(projectile != NULL) {
+					projectile->lifetimeComponent().expired = true;
+					killProjectile(projectile);
+				}
+			}
+			break;
+
+		case TIMER_WEAPON_RELOAD:
+			{
+				// The weapon is resolved through its entity, which is destroyed (leaving the
+				// id stale) when its ship leaves the arena
+				WeaponComponent * weapon = m_entities.weapons().get(timerIter->id);
+				if(weapon != NULL) {
+					Weapon::reload(*weapon);
+				}
+			}
+			break;
+
+		case TIMER_NPC_RESPAWN:
+			m_pendingRespawns--;
+			break;
+		}
+	}
+}
+
+void GameArena::applyPlayerInput(Real timeElapsed)
+{
+	if(mp_playerShip == NULL) {
+		return;
+	}
+
+	SphereCollisionObject * playerShipPhys = mp_playerShip->phys();
+	playerShipPhys->pitch(Radian(m_playerInput.pitch));
+	playerShipPhys->yaw(Radian(m_playerInput.yaw));
+	m_playerInput.pitch = 0;
+	m_playerInput.yaw = 0;
+
+	if(m_playerInput.thrustForward) {
+		playerShipPhys->applyTempForce(playerShipPhys->heading() * Real(3000));
+	}
+	if(m_playerInput.thrustReverse) {
+		playerShipPhys->applyTempForce(playerShipPhys->heading() * Real(-3000));
+	}
+	if(m_playerInput.strafeLeft) {
+		playerShipPhys->applyTempForce((playerShipPhys->orientation() * Quaternion(Degree(90), Vector3::UNIT_Y)) 
+			* Vector3(0, 0, -2000));
+	}
+	if(m_playerInput.strafeRight) {
+		playerShipPhys->applyTempForce((playerShipPhys->orientation() * Quaternion(Degree(-90), Vector3::UNIT_Y)) 
+			* Vector3(0, 0, -2000));
+	}
+	if(m_playerInput.rollLeft) {
+		playerShipPhys->roll(Radian(2 * timeElapsed));
+	}
+	if(m_playerInput.rollRight) {
+		playerShipPhys->roll(Radian(-2 * timeElapsed));
+	}
+	if(m_playerInput.brake) {
+		playerShipPhys->applyTempForce(playerShipPhys->velocity().normalisedCopy() * (-1) * Vector3(2000, 2000, 2000));
+	}
+
+	if(m_playerInput.firePrimary) {
+		fireProjectileFromShip(mp_playerShip, 0);
+	}
+	if(m_playerInput.fireSecondary) {
+		fireProjectileFromShip(mp_playerShip, 1);
+	}
+
+	updateGrapple(m_playerInput.grapple);
+}
+
+void GameArena::updateGrapple(bool held)
+{
+	SphereCollisionObject * playerShipPhys = mp_playerShip->phys();
+
+	if(held) {
+		if(mp_grapple == NULL) 
+		{
+			SpatialResult closestAnchor;
+			if(queryNearest(playerShipPhys->position(), 1, 1 << ANCHOR_PROJECTILE, &closestAnchor) > 0) {
+				SphereCollisionObject * anchorPhys = closestAnchor.object->phys();
+				anchorPhys->velocity(Vector3(0, 0, 0));
+				mp_grapple = addConstraint(Constraint(playerShipPhys, anchorPhys, false));
+			}
+		}
+	} else {
+		if(mp_grapple != NULL) {
+			PhysicsObject * deadAnchor = mp_grapple->getTarget();
+			destroyConstraint(mp_grapple);
+			for(std::vector<Projectile * >::iterator projIter = mp_projectiles.begin(); 
+				projIter != mp_projectiles.end();
+				projIter++) 
+			{
+				if((*projIter)->phys() == deadAnchor) {
+					destroyProjectile(*projIter);
+					break;
+				}
+			}
+			mp_grapple = NULL;
+		}
+	}
+}
+
+void GameArena::spawnNpcShips()
+{
+	while((int)mp_npcShips.size() + m_pendingRespawns < m_npcShipTarget) {
+		// Draw each coordinate separately so the draw order is well defined
+		Real x = m_simRandom.rangeRandom(20000, 50000);
+		Real y = m_simRandom.rangeRandom(20000, 50000);
+		Real z = m_simRandom.rangeRandom(20000, 50000);
+		SpaceShip npcShip = SpaceShip(ObjectType::NPC_SHIP, 1, Vector3(x, y, z), 5, &m_memory);
+
+		x = m_simRandom.rangeRandom(0, 2000);
+		y = m_simRandom.rangeRandom(0, 2000);
+		z = m_simRandom.rangeRandom(0, 2000);
+		SphereCollisionObject * npcShipPhysics = npcShip.phys();
+		npcShipPhysics->velocity(Vector3(x, y, z));
+		npcShipPhysics->orientation(Vector3(0, 0, -1).getRotationTo(npcShipPhysics->velocity()));
+		addNpcShip(npcShip);
+	}
+}
+
+int GameArena::update(Real frameTime)
+{
+	if(m_fixedStep <= 0) {
+		streamGalaxy();
+		spawnNpcShips();
+		applyPlayerInput(frameTime);
+		updatePhysics(frameTime);
+		return 1;
+	}
+
+	// Limit the number of updates per frame, so a long stall can't snowball
+	const int maxSteps = 8;
+	int steps = 0;
+	m_stepAccumulator += frameTime;
+	while(m_stepAccumulator >= m_fixedStep && steps < maxSteps) {
+		if(mp_recording != NULL) {
+			mp_recording->record(m_playerInput);
+		}
+		streamGalaxy();
+		spawnNpcShips();
+		applyPlayerInput(m_fixedStep);
+		updatePhysics(m_fixedStep);
+		m_stepAccumulator -= m_fixedStep;
+		steps++;
+	}
+
+	if(steps == maxSteps) {
+		m_stepAccumulator = 0;
+	}
+
+	// Objects added between updates are reported even if no step was taken
+	flushNotifications();
+	return steps;
+}
+
+void GameArena::step(const PlayerInput& input)
+{
+	m_playerInput = input;
+	if(mp_recording != NULL) {
+		mp_recording->record(m_playerInput);
+	}
+	streamGalaxy();
+	spawnNpcShips();
+	applyPlayerInput(m_fixedStep);
+	updatePhysics(m_fixedStep);
+	flushNotifications();
+}
+
+void GameArena::recordInput(InputRecording * recording)
+{
+	mp_recording = recording;
+}
+
+void GameArena::integrateConstrained(Real timeElapsed)
+{
+	std::vector<Constraint * > constraints;
+	for(std::vector<Constraint * >::iterator originIter = mp_constraints.begin(); 
+		originIter != mp_constraints.end();
+		originIter++) 
+	{
+		PhysicsObject * origin = (*originIter)->getOrigin();
+		PhysicsComponent & physics = origin->physicsComponent();
+		if(physics.lastStep == m_stepCount) {
+			continue;
+		}
+		physics.lastStep = m_stepCount;
+
+		// Gather every constraint originating at the object from its own constraint list
+		int substeps = PhysicsObject::substeps(physics, timeElapsed);
+		constraints.clear();
+		for(Constraint * constraint = origin->constraints(); 
+			constraint != NULL;
+			constraint = constraint->next(origin)) 
+		{
+			if(constraint->getOrigin() == origin) {
+				constraints.push_back(constraint);
+				substeps = std::max(substeps, constraint->substeps(timeElapsed));
+			}
+		}
+
+		// Temporary forces are cleared by each integration, so they are reapplied for every substep
+		Vector3 tempForce = physics.tempForce;
+		Real substepTime = timeElapsed / substeps;
+		for(int i = 0; i < substeps; i++) {
+			if(i > 0) {
+				origin->applyTempForce(tempForce);
+			}
+			PhysicsObject::integrate(origin->transform(), physics, substepTime);
+
+			// The global solver runs after the last substep
+			if(i < substeps - 1) {
+				for(std::vector<Constraint * >::iterator constraintIter = constraints.begin(); 
+					constraintIter != constraints.end();
+					constraintIter++) 
+				{
+					(*constraintIter)->solvePosition();
+					(*constraintIter)->solveVelocity();
+				}
+			}
+		}
+	}
+}
+
+void GameArena::integrateComponents(TransformComponent & transform, PhysicsComponent & physics, Real timeElapsed)
+{
+	if(physics.lastStep == m_stepCount || physics.asleep || physics.kinematic) {
+		return;
+	}
+
+	int substeps = PhysicsObject::substeps(physics, timeElapsed);
+	if(substeps == 1) {
+		PhysicsObject::integrate(transform, physics, timeElapsed);
+		return;
+	}
+
+	// Temporary forces are reapplied for every substep (as in integrateConstrained())
+	Vector3 tempForce = physics.tempForce;
+	Real substepTime = timeElapsed / substeps;
+	for(int j = 0; j < substeps; j++) {
+		if(j > 0 && tempForce != Vector3::ZERO) {
+			physics.tempForce = physics.tempForce + tempForce;
+			physics.asleep = false;
+			physics.idleTime = 0;
+		}
+		PhysicsObject::integrate(transform, physics, substepTime);
+	}
+}
+
+void GameArena::integrateReducedBodies(Real timeElapsed)
+{
+	if(!m_galaxy.active()) {
+		return;
+	}
+
+	m_reducedTime += timeElapsed;
+	bool due = m_stepCount % Galaxy::REDUCED_INTERVAL == 0;
+	for(std::vector<CelestialBody * >::iterator bodyIter =  m_reducedBodies.begin(); 
+		bodyIter != m_reducedBodies.end();
+		bodyIter++)
+	{
+		PhysicsObject * phys = (*bodyIter)->phys();
+		PhysicsComponent & physics = phys->physicsComponent();
+		if(due) {
+			integrateComponents(phys->transform(), physics, m_reducedTime);
+		}
+		physics.lastStep = m_stepCount;
+	}
+
+	if(due) {
+		m_reducedTime = 0;
+	}
+}
+
+void GameArena::integrateEntities(int begin, int end)
+{
+	ComponentArray<PhysicsComponent> & physicsArray = m_entities.physics();
+	ComponentArray<TransformComponent> & transforms = m_entities.transforms();
+	for(int i = begin; i < end; i++) {
+		integrateComponents(*transforms.get(physicsArray.entity(i)), physicsArray.at(i), m_stepTime);
+	}
+}
+
+void GameArena::integrateProjectiles(int begin, int end)
+{
+	for(int slot = begin; slot < end; slot++) {
+		if(m_projectilePool.live(slot)) {
+			SphereCollisionObject * projPhys = m_projectilePool.at(slot).phys();
+			integrateComponents(projPhys->transform(), projPhys->physicsComponent(), m_stepTime);
+		}
+	}
+}
+
+void GameArena::steerNpcShips(int begin, int end)
+{
+	for(int i = begin; i < end; i++) {
+		SphereCollisionObject * shipPhys = mp_npcShips[i]->phys();
+
+		if(shipPhys->position().x > m_arenaSize || shipPhys->position().x < - m_arenaSize
+			|| shipPhys->position().y > m_arenaSize || shipPhys->position().y < - m_arenaSize
+			|| shipPhys->position().z > m_arenaSize || shipPhys->position().z < - m_arenaSize) 
+		{
+			shipPhys->velocity(shipPhys->velocity() * Vector3(-1, -1, -1));
+		}
+		shipPhys->orientation(Vector3(0, 0, -1).getRotationTo(shipPhys->velocity()));
+	}
+}
+
+Contact GameArena::findContact(GameObject * a, GameObject * b, bool swept)
+{
+	SphereCollisionObject * physA = a->phys();
+	SphereCollisionObject * physB = b->phys();
+	if((physA->sleeping() && physB->sleeping())
+		|| !(swept ? physA->sweptCollision(*physB, m_stepTime) : physA->checkCollision(*physB)))
+	{
+		return Contact();
+	}
+	return Contact(a, b, m_simTime - physA->contactAge(*physB, m_stepTime));
+}
+
+bool GameArena::projectileHits(const Projectile * projectile, GameObject * object) const
+{
+	return projectile->owner() == 0 || projectile->owner() != object->phys()->serial()
+		|| m_collisionMatrix.ownerCollides(projectile->type());
+}
+
+void GameArena::detectProjectileCollisions(int begin, int end)
+{
+	const std::vector<CelestialBody * > & bodies = collisionBodies();
+	for(int slot = begin; slot < end; slot++) {
+		Contact & contact = m_projectileContacts[slot];
+		contact = Contact();
+		if(!m_projectilePool.live(slot)) {
+			continue;
+		}
+
+		Projectile * projectile = &m_projectilePool.at(slot);
+		SphereCollisionObject * projPhys = projectile->phys();
+		if(projectile->expired()) {
+			continue;
+		}
+
+		// Types which can't collide with the projectile are culled before any distance tests
+		unsigned int collisionMask = m_collisionMatrix.mask(projectile->type());
+		unsigned int shipCount = (collisionMask & (1 << NPC_SHIP)) ? mp_npcShips.size() : 0;
+
+		// Ships take precedence over projectiles and bodies, and the first object hit absorbs the
+		// projectile. Each test is swept over the update, so fast projectiles can't pass through.
+		for(unsigned int j = 0; j < shipCount && contact.objectB == NULL; j++) {
+			if(projectileHits(projectile, mp_npcShips[j])) {
+				contact = findContact(projectile, mp_npcShips[j], true);
+			}
+		}
+
+		if(contact.objectB == NULL && mp_playerShip != NULL && (collisionMask & (1 << SHIP)) != 0
+			&& projectileHits(projectile, mp_playerShip))
+		{
+			contact = findContact(projectile, mp_playerShip, true);
+		}
+
+		int projectileCount = (collisionMask & PROJECTILE_TYPES) ? m_projectilePool.capacity() : 0;
+		for(int j = 0; j < projectileCount && contact.objectB == NULL; j++) {
+			if(j == slot || !m_projectilePool.live(j)) {
+				continue;
+			}
+
+			Projectile * other = &m_projectilePool.at(j);
+			if((collisionMask & (1 << other->type())) != 0 && !other->expired()) {
+				contact = findContact(projectile, other, true);
+			}
+		}
+
+		if(contact.objectB != NULL) {
+			continue;
+		}
 
-		CelestialBody * planet = addBody(CelestialBody(ObjectType::PLANET, 10000, planetRadius,
-			star, totalDistance, speed, &m_memory));
+		for(unsigned int j = 0; j < bodies.size(); j++) {
+			if((collisionMask & (1 << bodies[j]->type())) == 0) {
+				continue;
+			}
 
-		int numMoons = rand() % 3;
-		Real moonDistance = planetRadius * 0.3;
-		for(int j = 0; j < 2; j++) {
-			Real moonRadius = Math::RangeRandom(planetRadius * 0.1, planetRadius * 0.7);
-			moonDistance += Math::RangeRandom(planetRadius * 0.5, planetRadius * 1);
-			speed = Math::RangeRandom(1, 3) * moonDistance;
-			CelestialBody * moon = addBody(CelestialBody(ObjectType::MOON, 1000, moonRadius,
-				planet, moonDistance, speed, &m_memory));
+			SphereCollisionObject * bodyPhys = bodies[j]->phys();
+			if(projPhys->sweptCollision(*bodyPhys, m_stepTime)) {
+				contact = Contact(projectile, bodies[j], 
+					m_simTime - projPhys->contactAge(*bodyPhys, m_stepTime));
+				break;
+			}
 		}
 	}
+}
 
-	// Outer planets - giants
-	totalDistance += Math::RangeRandom(2000, 8000);
-	int numOuterPlanets = rand() % 4 + 2;
-	for(int i = 0; i < numOuterPlanets; i++) {
-		totalDistance += Math::RangeRandom(8000, 14000);
-		Real planetRadius = Math::RangeRandom(2000, 8000);
-		Real speed = Math::RangeRandom(8000, 15000);
+void GameArena::detectShipCollisions(int begin, int end)
+{
+	const std::vector<CelestialBody * > & bodies = collisionBodies();
+	unsigned int collisionMask = m_collisionMatrix.mask(NPC_SHIP);
+	unsigned int shipCount = (collisionMask & (1 << NPC_SHIP)) ? mp_npcShips.size() : 0;
+	for(int i = begin; i < end; i++) {
+		SphereCollisionObject * shipPhys = mp_npcShips[i]->phys();
+		Contact & contact = m_shipContacts[i];
+		contact = Contact();
 
-		CelestialBody * planet = addBody(CelestialBody(ObjectType::PLANET, 10000, planetRadius,
-			star, totalDistance, speed, &m_memory));
+		// Ships take precedence over bodies
+		if(mp_playerShip != NULL && (collisionMask & (1 << SHIP)) != 0) {
+			contact = findContact(mp_npcShips[i], mp_playerShip);
+		}
 
-		int numMoons = rand() % 5 + 2;
-		Real moonDistance = planetRadius * 0.3;
-		for(int j = 0; j < 2; j++) {
-			Real moonRadius = Math::RangeRandom(planetRadius * 0.1, planetRadius * 0.3);
-			moonDistance += Math::RangeRandom(planetRadius * 0.2, planetRadius * 0.4);
-			speed = Math::RangeRandom(2, 4) * moonDistance;
-			CelestialBody * moon = addBody(CelestialBody(ObjectType::MOON, 1000, moonRadius,
-				planet, moonDistance, speed, &m_memory));
+		for(unsigned int j = 0; j < shipCount && contact.objectB == NULL; j++) {
+			if((int)j != i) {
+				contact = findContact(mp_npcShips[i], mp_npcShips[j]);
+			}
+		}
+
+		if(contact.objectB != NULL) {
+			continue;
+		}
+
+		for(unsigned int j = 0; j < bodies.size(); j++) {
+			if((collisionMask & (1 << bodies[j]->type())) == 0) {
+				continue;
+			}
+
+			SphereCollisionObject * bodyPhys = bodies[j]->phys();
+			if(bodyPhys->checkCollision(*shipPhys)) {
+				contact = Contact(mp_npcShips[i], bodies[j], 
+					m_simTime - shipPhys->contactAge(*bodyPhys, m_stepTime));
+				break;
+			}
 		}
 	}
+}
 
-	// Outer planets - tiny
-	int numTinyPlanets = rand() % 3;
-	totalDistance += Math::RangeRandom(8000, 12000);
-	for(int i = 0; i < numTinyPlanets; i++) {
-		totalDistance += Math::RangeRandom(8000, 14000);
-		Real planetRadius = Math::RangeRandom(500, 1500);
-		Real speed = Math::RangeRandom(20000, 25000);
+void GameArena::gatherContacts()
+{
+	m_contacts.clear();
 
-		CelestialBody * planet = addBody(CelestialBody(ObjectType::PLANET, 10000, planetRadius,
-			star, totalDistance, speed, &m_memory));
+	for(std::vector<Contact>::iterator contactIter = m_projectileContacts.begin(); 
+		contactIter != m_projectileContacts.end();
+		contactIter++) 
+	{
+		if((*contactIter).objectB != NULL) {
+			m_contacts.push_back(*contactIter);
+		}
+	}
 
-		int numMoons = rand() % 2;
-		Real moonDistance = planetRadius * 0.3;
-		for(int j = 0; j < 2; j++) {
-			Real moonRadius = Math::RangeRandom(planetRadius * 0.8, planetRadius * 1.2);
-			moonDistance += Math::RangeRandom(planetRadius * 0.2, planetRadius * 0.4);
-			speed = Math::RangeRandom(2, 4) * moonDistance;
-			CelestialBody * moon = addBody(CelestialBody(ObjectType::MOON, 1000, moonRadius,
-				planet, moonDistance, speed, &m_memory));
+	for(std::vector<Contact>::iterator contactIter = m_shipContacts.begin(); 
+		contactIter != m_shipContacts.end();
+		contactIter++) 
+	{
+		if((*contactIter).objectB != NULL) {
+			m_contacts.push_back(*contactIter);
+		}
+	}
+
+	// There are few enough bodies near the player that the remaining pairs are checked serially
+	const std::vector<CelestialBody * > & bodies = collisionBodies();
+	unsigned int playerMask = m_collisionMatrix.mask(SHIP);
+	for(unsigned int i = 0; i < bodies.size(); i++) {
+		SphereCollisionObject * bodyPhys = bodies[i]->phys();
+		unsigned int bodyMask = m_collisionMatrix.mask(bodies[i]->type());
+
+		if(mp_playerShip != NULL && (playerMask & (1 << bodies[i]->type())) != 0
+			&& bodyPhys->checkCollision(*mp_playerShip->phys())) 
+		{
+			m_contacts.push_back(Contact(mp_playerShip, bodies[i], 
+				m_simTime - mp_playerShip->phys()->contactAge(*bodyPhys, m_stepTime)));
+		}
+
+		for(unsigned int j = i + 1; j < bodies.size(); j++) {
+			if((bodyMask & (1 << bodies[j]->type())) == 0) {
+				continue;
+			}
+
+			SphereCollisionObject * colBodyPhys = bodies[j]->phys();
+			if(bodyPhys->checkCollision(*colBodyPhys)) {
+				m_contacts.push_back(Contact(bodies[i], bodies[j], 
+					m_simTime - bodyPhys->contactAge(*colBodyPhys, m_stepTime)));
+			}
 		}
 	}
 }
 
+void GameArena::applyContacts()
+{
+	for(std::vector<Contact>::iterator contactIter = m_contacts.begin(); 
+		contactIter != m_contacts.end();
+		contactIter++) 
+	{
+		GameObject * objectA = (*contactIter).objectA;
+		GameObject * objectB = (*contactIter).objectB;
+
+		switch(objectA->type()) {
+		case PROJECTILE:
+		case ANCHOR_PROJECTILE:
+		case PLANET_CHUNK:
+			{
+				Projectile * projectile = static_cast<Projectile *>(objectA);
+				if(objectB->type() == NPC_SHIP || objectB->type() == SHIP) {
+					objectB->phys()->wake();
+					damageObject(objectB, projectile, projectile->damage());
+				} else if((PROJECTILE_TYPES & (1 << objectB->type())) != 0) {
+					// Projectiles which hit each other are both spent
+					killProjectile(static_cast<Projectile *>(objectB));
+				} else {
+					CelestialBody * body = static_cast<CelestialBody *>(objectB);
+
+					// DEBUG: Allow projectiles to damage planets
+					if(body->type() != STAR && projectile->type() != PLANET_CHUNK) {
+						damageObject(body, projectile, projectile->damage());
+					}
+
+					// Bodies knocked off their analytic orbit are simulated from here on
+					releaseOrbit(body);
+					body->phys()->wake();
+				}
+				killProjectile(projectile);
+			}
+			break;
+
+		case NPC_SHIP:
+			// Destroy any ships which flew into a celestial body or another ship (ramming
+			// the player deals it the same fatal damage as a body)
+			killNpcShip(static_cast<SpaceShip *>(objectA));
+			if(objectB->type() == NPC_SHIP) {
+				killNpcShip(static_cast<SpaceShip *>(objectB));
+			} else if(objectB->type() == SHIP) {
+				objectB->phys()->wake();
+				damageObject(objectB, objectA, 500);
+			}
+			break;
+
+		case SHIP:
+			// Deal fatal damage to the player on any collision with a celestial body
+			objectA->phys()->wake();
+			damageObject(objectA, objectB, 500);
+			break;
+
+		default:
+			// Two celestial bodies collided, deal fatal damage to the smaller
+			// of the two
+			if(static_cast<CelestialBody *>(objectA)->radius() > static_cast<CelestialBody *>(objectB)->radius()) {
+				damageObject(objectB, objectA, 10000);
+			} else {
+				damageObject(objectA, objectB, 10000);
+			}
+			break;
+		}
+	}
+}
+
+void GameArena::damageObject(GameObject * object, GameObject * source, Real damage)
+{
+	object->inflictDamage(damage);
+	if(!mp_eventChannels.empty()) {
+		ArenaEvent event(EVENT_DAMAGE_TAKEN, *object);
+		event.otherSerial = source->phys()->serial();
+		event.amount = damage;
+		publishEvent(event);
+	}
+}
+
+void GameArena::updatePhysics(Real timeElapsed)
+{
+	m_simTime += timeElapsed;
+	m_stepTime = timeElapsed;
+	m_stepCount++;
+	m_spatialIndexMoved = true;
+	if(m_galaxy.active() && m_sectorBodiesDirty) {
+		sortSectorBodies();
+	}
+	if(m_profiling) {
+		m_phaseStart = m_profileTimer.getMicroseconds();
+	}
+
+	// Integrate the bodies of reduced sectors when they are due, then the origins of
+	// constraints. This is done serially, since the constraints are projected between an
+	// origin's substeps.
+	integrateReducedBodies(timeElapsed);
+	integrateConstrained(timeElapsed);
+	endPhase(UPDATE_CONSTRAINED);
+
+	// Integrate every other entity in a single dense pass (sleeping and kinematic entities,
+	// such as analytically orbiting bodies, are skipped)
+	MemberTask<GameArena> integrateTask(this, &GameArena::integrateEntities);
+	m_workers.parallelFor(integrateTask, m_entities.physics().size(), 256);
+
+	// Projectiles are integrated in place, streaming through the projectile pool's slots
+	MemberTask<GameArena> projectileTask(this, &GameArena::integrateProjectiles);
+	m_workers.parallelFor(projectileTask, m_projectilePool.capacity(), 256);
+	endPhase(UPDATE_INTEGRATION);
+
+	// Place analytically orbiting bodies (after integration, as their centers may be simulated).
+	// This is done serially, since evaluating a body may also evaluate its center.
+	orbitBodies();
+	endPhase(UPDATE_ORBITS);
+
+	// Update energy, fire timed events (reloads, projectile expiry, respawns), then turn the NPC ships
+	m_entities.rechargeSystem(timeElapsed);
+	fireTimers();
+
+	MemberTask<GameArena> shipTask(this, &GameArena::steerNpcShips);
+	m_workers.parallelFor(shipTask, mp_npcShips.size(), 32);
+	endPhase(UPDATE_COMPONENTS);
+
+	// Project constrained objects back onto their constraints
+	if(timeElapsed > 0) {
+		m_solver.solve(mp_constraints);
+	}
+	endPhase(UPDATE_CONSTRAINTS);
+
+	// Detect collisions in parallel. Each worker only writes the contact slots for its
+	// own range of objects, and the slots are then gathered serially in index order so
+	// the contact list does not depend on the number of threads.
+	m_projectileContacts.resize(m_projectilePool.capacity());
+	m_shipContacts.resize(mp_npcShips.size());
+
+	MemberTask<GameArena> projCollisionTask(this, &GameArena::detectProjectileCollisions);
+	m_workers.parallelFor(projCollisionTask, m_projectilePool.capacity(), 128);
+
+	MemberTask<GameArena> shipCollisionTask(this, &GameArena::detectShipCollisions);
+	m_workers.parallelFor(shipCollisionTask, mp_npcShips.size(), 32);
+
+	gatherContacts();
+	endPhase(UPDATE_COLLISIONS);
+
+	// Apply damage for the update's contacts in a single pass
+	applyContacts();
+	endPhase(UPDATE_CONTACTS);
+
+	// Detonate any planet with less than 0 health
+	for(std::vector<CelestialBody * >::iterator bodyIter =  mp_bodies.begin(); 
+		bodyIter != mp_bodies.end();
+		bodyIter++) 
+	{
+		if((*bodyIter)->health() < 0 && !(*bodyIter)->dead()) {
+			Real radius = (*bodyIter)->radius();
+			if(!mp_eventChannels.empty()) {
+				ArenaEvent detonation(EVENT_BODY_DETONATED, **bodyIter);
+				detonation.amount = radius;
+				publishEvent(detonation);
+			}
+
+			// Generate random projectiles originating from the center of the
+			// detonating body
+			Vector3 centerVelocity = (*bodyIter)->phys()->velocity();
+			Vector3 center = (*bodyIter)->phys()->position();
+
+			for(int i = 0; i < 20; i++) {
+				Real randAngle = m_simRandom.unitRandom() * (2 * Math::PI);
+				Real randMu = m_simRandom.rangeRandom(-1, 1);
+				Vector3 pointOnUnitSphere = Vector3(
+					Math::Cos(randAngle) * Math::Sqrt(1 - Math::Sqr(randMu)),
+					randMu,
+					Math::Sin(randAngle) * Math::Sqrt(1 - Math::Sqr(randMu)));
+				Vector3 relOffset = pointOnUnitSphere * radius * m_simRandom.rangeRandom(0, 1);
+					
+				SphereCollisionObject projectilePhysics = SphereCollisionObject(500, 1, relOffset + center);
+				projectilePhysics.velocity(relOffset.normalisedCopy() * 4000 + centerVelocity);
+				addProjectile(Projectile(projectilePhysics, ObjectType::PLANET_CHUNK, 50, 10, &m_memory));
+			}
+
+			killBody(*bodyIter);
+		}
+	}
+
+	// After all projectile collisions, remove any ships with less than 0 health
+	for(std::vector<SpaceShip * >::iterator shipIter =  mp_npcShips.begin(); 
+		shipIter != mp_npcShips.end();
+		shipIter++) 
+	{
+		if ((*shipIter)->health() <= 0)
+		{
+			killNpcShip(*shipIter);
+		}
+	}
+
+	// Destroy everything killed during the update, then report everything created
+	reclaimDead();
+	flushNotifications();
+
+	// Reset the player ship if they "die"
+	if(mp_playerShip != NULL && mp_playerShip->health() <= 0) {
+		mp_playerShip->health(mp_playerShip->maxHealth());
+		mp_playerShip->phys()->velocity(Vector3(0, 0, 0));
+		mp_playerShip->phys()->position(Vector3(10000, 10000, 10000));
+	}
+	endPhase(UPDATE_CLEANUP);
+
+	if(m_profiling) {
+		m_profiledUpdates++;
+	}
+}
+
+
+void GameArena::addStarSystem(const Vector3 & position, const std::vector<BodyPlan> & bodies, int sector)
+{
+	std::vector<CelestialBody * > added;
+	for(std::vector<BodyPlan>::const_iterator planIter = bodies.begin();
+		planIter != bodies.end();
+		planIter++)
+	{
+		if(planIter->center < 0) {
+			added.push_back(addBody(CelestialBody((ObjectType)planIter->type, planIter->mass, planIter->radius,
+				position, &m_memory)));
+		} else {
+			added.push_back(addBody(CelestialBody((ObjectType)planIter->type, planIter->mass, planIter->radius,
+				added[planIter->center], planIter->distance, planIter->speed, planIter->angle,
+				planIter->inclination, planIter->reverse, &m_memory)));
+		}
+		added.back()->sector(sector);
+	}
+}
+
+void GameArena::streamGalaxy()
+{
+	if(!m_galaxy.active()) {
+		return;
+	}
+
+	Vector3 viewer = mp_playerShip != NULL ? mp_playerShip->phys()->position() : Vector3::ZERO;
+	std::vector<PlannedSystem> systems;
+	m_galaxy.approach(viewer, systems);
+	for(std::vector<PlannedSystem>::iterator systemIter = systems.begin();
+		systemIter != systems.end();
+		systemIter++)
+	{
+		addStarSystem(systemIter->position, systemIter->bodies, systemIter->sector);
+	}
+
+	// Sectors are paged in and out in ascending order, so the arena order stays deterministic
+	std::vector<int> thawed;
+	std::vector<int> frozen;
+	if(!m_galaxy.updateActivity(viewer, thawed, frozen)) {
+		return;
+	}
+	m_sectorBodiesDirty = true;
+
+	for(std::vector<int>::iterator sectorIter = frozen.begin();
+		sectorIter != frozen.end();
+		sectorIter++)
+	{
+		freezeSector(*sectorIter);
+	}
+
+	std::vector<char> page;
+	for(std::vector<int>::iterator sectorIter = thawed.begin();
+		sectorIter != thawed.end();
+		sectorIter++)
+	{
+		if(m_galaxy.pageIn(*sectorIter, page) && !page.empty()) {
+			ArenaSerializer::loadBodies(*this, &page[0], page.size());
+		}
+	}
+}
+
+void GameArena::freezeSector(int sector)
+{
+	// Bodies are paged out with the system they were generated in (wherever they have drifted),
+	// so the whole orbit hierarchy is restored when the sector thaws
+	std::vector<CelestialBody * > bodies;
+	for(std::vector<CelestialBody * >::iterator bodyIter =  mp_bodies.begin(); 
+		bodyIter != mp_bodies.end();
+		bodyIter++)
+	{
+		if((*bodyIter)->sector() == sector) {
+			bodies.push_back(*bodyIter);
+		}
+	}
+
+	std::vector<char> page;
+	ArenaSerializer::saveBodies(bodies, page);
+	m_galaxy.pageOut(sector, page);
+
+	// The bodies are taken off their centers first, so no satellites are passed on as they go
+	// (their centers were saved with them)
+	for(std::vector<CelestialBody * >::iterator bodyIter =  bodies.begin(); 
+		bodyIter != bodies.end();
+		bodyIter++)
+	{
+		(*bodyIter)->center(NULL);
+	}
+	for(std::vector<CelestialBody * >::reverse_iterator bodyIter =  bodies.rbegin(); 
+		bodyIter != bodies.rend();
+		bodyIter++)
+	{
+		destroyBody(*bodyIter);
+	}
+}
+
+void GameArena::sortSectorBodies()
+{
+	m_activeBodies.clear();
+	m_reducedBodies.clear();
+	for(std::vector<CelestialBody * >::iterator bodyIter =  mp_bodies.begin(); 
+		bodyIter != mp_bodies.end();
+		bodyIter++)
+	{
+		// Bodies which aren't part of a galaxy system stay active
+		if(m_galaxy.activity((*bodyIter)->sector()) == SECTOR_REDUCED) {
+			m_reducedBodies.push_back(*bodyIter);
+		} else {
+			m_activeBodies.push_back(*bodyIter);
+		}
+	}
+	m_sectorBodiesDirty = false;
+}
+
+const std::vector<CelestialBody *> & GameArena::collisionBodies() const
+{
+	return m_galaxy.active() ? m_activeBodies : mp_bodies;
+}
+
+void GameArena::orbitBodies()
+{
+	if(!m_galaxy.active()) {
+		m_entities.orbitSystem(m_simTime);
+		return;
+	}
+
+	for(std::vector<CelestialBody * >::iterator bodyIter =  m_activeBodies.begin(); 
+		bodyIter != m_activeBodies.end();
+		bodyIter++)
+	{
+		m_entities.evaluateOrbit((*bodyIter)->entity(), m_simTime);
+	}
+
+	if(m_stepCount % Galaxy::REDUCED_INTERVAL == 0) {
+		for(std::vector<CelestialBody * >::iterator bodyIter =  m_reducedBodies.begin(); 
+			bodyIter != m_reducedBodies.end();
+			bodyIter++)
+		{
+			m_entities.evaluateOrbit((*bodyIter)->entity(), m_simTime);
+		}
+	}
+}
+
+void GameArena::generateSolarSystem() 
+{
+	std::vector<BodyPlan> bodies;
+	Galaxy::planSystem(m_worldRandom, bodies);
+	addStarSystem(Vector3(0, 0, 0), bodies, -1);
+}
+
+void GameArena::generateGalaxy(int sectorsPerSide, Real sectorSize, Real density)
+{
+	unsigned long long seed = ((unsigned long long)m_worldRandom.next() << 32) | m_worldRandom.next();
+	m_galaxy.create(seed, sectorsPerSide, sectorSize, density);
+}
+
+const Galaxy & GameArena::galaxy() const
+{
+	return m_galaxy;
+}
+
+void GameArena::galaxyPageDirectory(const std::string & directory)
+{
+	m_galaxy.pageDirectory(directory);
+}
+
 void GameArena::clearSolarSystem() {
 	for(std::vector<CelestialBody * >::iterator iter =  mp_bodies.begin(); 
 		iter != mp_bodies.end();)
 	{
 		iter = destroyBody(*iter);
 	}
+	m_galaxy.clear();
+}
+
+void GameArena::clear()
+{
+	while(!mp_constraints.empty()) {
+		destroyConstraint(mp_constraints.back());
+	}
+
+	// Bodies are taken off their centers first, so no satellites are passed on as they go
+	for(std::vector<CelestialBody * >::iterator iter =  mp_bodies.begin(); 
+		iter != mp_bodies.end();
+		iter++)
+	{
+		(*iter)->center(NULL);
+	}
+	while(!mp_bodies.empty()) {
+		destroyBody(mp_bodies.back());
+	}
+
+	while(!mp_projectiles.empty()) {
+		destroyProjectile(mp_projectiles.back());
+	}
+	while(!mp_npcShips.empty()) {
+		destroyNpcShip(mp_npcShips.back());
+	}
+
+	if(mp_playerShip != NULL) {
+		notifyObjectDestruction(mp_playerShip);
+		unregisterObject(mp_playerShip);
+		m_memory.destroyObject(mp_playerShip);
+		mp_playerShip = NULL;
+	}
+
+	m_timers.reset(m_simTime);
+	m_pendingRespawns = 0;
+	m_contacts.clear();
+	m_galaxy.clear();
+	m_reducedTime = 0;
 }
 
 PagedMemoryPool * GameArena::memoryManager()
@@ -5,22 +5,89 @@
 #include <OgreVector3.h>
 #include <OgreQuaternion.h>
 #include <OgreMath.h>
+#include <OgreTimer.h>
 #include "PhysicsEngine.h"
 #include "MemoryMgr.h"
+#include "RandomStream.h"
+#include "SpatialIndex.h"
+#include "ObjectPool.h"
+#include "TimingWheel.h"
+#include "Galaxy.h"
 
 using namespace Ogre;
 
 class GameArena;
+class EventChannel;
+struct ArenaEvent;
+class InputRecording;
 
 /**
  * Enumeration used for differentiating between different types of GameObjects
  */
 enum ObjectType { SHIP, NPC_SHIP, PROJECTILE, ANCHOR_PROJECTILE, PLANET_CHUNK, STAR, MOON, PLANET };
 
+/** The number of values in the ObjectType enumeration */
+const int NUM_OBJECT_TYPES = PLANET + 1;
+
+/** A type mask with the bit (1 << type) set for every ObjectType */
+const unsigned int ALL_OBJECT_TYPES = (1 << NUM_OBJECT_TYPES) - 1;
+
+/** A type mask of the ObjectTypes fired as projectiles */
+const unsigned int PROJECTILE_TYPES = (1 << PROJECTILE) | (1 << ANCHOR_PROJECTILE) | (1 << PLANET_CHUNK);
+
+/**
+ * The CollisionMatrix class records which pairs of ObjectTypes should be tested
+ * for collisions. Pairs are symmetric, and each type's row is stored as a type mask
+ * so a whole group of objects can be skipped with a single test.
+ */
+class CollisionMatrix
+{
+private:
+	/** For each ObjectType, a type mask of the types it collides with */
+	unsigned int m_masks[NUM_OBJECT_TYPES];
+
+	/** A type mask of the projectile types which can hit the object that fired them */
+	unsigned int m_ownerMask;
+
+public:
+	/** 
+	 * Constructs a CollisionMatrix with the default rules: projectiles hit NPC ships
+	 * and celestial bodies, and ships and bodies collide with bodies.
+	 */
+	CollisionMatrix();
+
+	/** @return True if objects of the passed types should be tested for collisions */
+	bool collides(ObjectType a, ObjectType b) const;
+
+	/**
+	 * Sets whether objects of the passed types should be tested for collisions. Every pair
+	 * is honoured by the GameArena, with the first contact found for each object taking
+	 * effect in this order of precedence: ships, then projectiles, then bodies. Projectiles
+	 * never hit the object which fired them unless enabled with ownerCollides().
+	 */
+	void collides(ObjectType a, ObjectType b, bool collide);
+
+	/** @return A type mask of all types which collide with the passed type */
+	unsigned int mask(ObjectType type) const;
+
+	/** @return True if projectiles of the passed type can hit the object which fired them */
+	bool ownerCollides(ObjectType projectileType) const;
+
+	/**
+	 * Sets whether projectiles of the passed type can hit the object which fired them (as
+	 * long as the pair of types collides at all)
+	 */
+	void ownerCollides(ObjectType projectileType, bool collide);
+};
+
 
 /**
  * The GameObject class represents any distinct entity in the game world, which
  * may or may not require physics simulation.
+ *
+ * A GameObject shares its entity with its collision object. Once attached to a
+ * store its state lives in the entity's components, and is updated by the GameArena's
+ * systems rather than by updatePhysics().
  */
 class GameObject
 {
@@ -29,23 +96,24 @@ private:
 	 * by this object */
 	PagedMemoryPool * mp_memory;
 
-	SphereCollisionObject * mp_physModel;
-
-	Real m_maxHealth;
-
-	Real m_health;
-
-	Real m_maxEnergy;
-
-	Real m_energy;
+	/** 
+	 * The object's collision object, stored with the object so that reaching its physics
+	 * state doesn't need a separate allocation
+	 */
+	SphereCollisionObject m_physModel;
 
-	// Note: Not implemented in this class, should be used in subclasses
-	// implementation of updatePhysics
-	Real m_energyRechargeRate;
+	/** The object's health and energy while it is detached */
+	HealthComponent m_localHealth;
 
 	/** The type of the object (used for differentiating among derived classes) */
 	ObjectType m_type;
 
+	/** The object's position in its GameArena object list (-1 if it is not in one) */
+	int m_arenaIndex;
+
+	/** True if the object has been killed, and will be destroyed at the end of the update */
+	bool m_dead;
+
 
 
 public: 
@@ -53,10 +121,12 @@ public:
 		Real maxHealth, Real maxEnergy, Real energyRechargeRate, PagedMemoryPool * memoryMgr);
 
 	GameObject(const GameObject& copy);
-	~GameObject();
 
 	/** @return The collision object which encapsulates all physics data for this object */
-	SphereCollisionObject * phys() const;
+	SphereCollisionObject * phys();
+
+	/** @return The collision object which encapsulates all physics data for this object */
+	const SphereCollisionObject * phys() const;
 
 	/** @return The type of the object (used for differentiating among derived classes) */
 	ObjectType type() const;
@@ -64,6 +134,33 @@ public:
 	/** @return The memory manager used by this game object for any required heap allocation */
 	PagedMemoryPool * memoryManager() const;
 
+	/** @return The object's position in its GameArena object list (-1 if it is not in one) */
+	int arenaIndex() const;
+
+	/** Sets the object's position in its GameArena object list (only used by the GameArena) */
+	void arenaIndex(int index);
+
+	/** @return True if the object has been killed, and will be destroyed at the end of the update */
+	bool dead() const;
+
+	/** Marks the object as killed (only used by the GameArena) */
+	void dead(bool dead);
+
+	/** @return The object's entity (NULL_ENTITY if the object is detached) */
+	EntityId entity() const;
+
+	/** @return The object's health component (in its store, or held locally while detached) */
+	HealthComponent & healthComponent();
+
+	/** @return The object's health component (in its store, or held locally while detached) */
+	const HealthComponent & healthComponent() const;
+
+	/** Moves the object's state into new components of the passed entity (only used by the GameArena) */
+	virtual void attach(EntityStore * store, EntityId entity);
+
+	/** Moves the object's state out of its store (only used by the GameArena) */
+	virtual void detach();
+
 	Real health() const;
 	Real maxHealth() const;
 	Real energy() const;
@@ -80,30 +177,69 @@ public:
 };
 
 
+/**
+ * The Projectile class represents a short lived object fired by a weapon. A GameArena stores
+ * its projectiles by value in an ObjectPool and never attaches them to its EntityStore, so a
+ * projectile's state lives in the projectile itself, in its pool slot.
+ */
 class Projectile : public GameObject
 {
 private:
 	Real m_damage;
 
-	/** The total amount of ingame time the projectile should exist for */
-	Real m_lifeTime;
+	/** The projectile's lifetime and the time elapsed toward it (unless it is attached to a store) */
+	LifetimeComponent m_localLifetime;
+
+	/** The projectile's id in its GameArena's projectile pool (NULL_POOL_ID if it is not in one) */
+	PoolId m_id;
 
-	/** The amount of elapsed time toward the projectiles lifetime */
-	Real m_elapsedTime;
+	/** The serial number of the object which fired the projectile (0 if it has none) */
+	unsigned long m_ownerSerial;
 
 public:
 	Projectile(const SphereCollisionObject& physModel, ObjectType type, Real damage,
 		Real lifeTime, PagedMemoryPool * memoryMgr);
 
+	/** Copy constructor (the copy is not in any GameArena) */
+	Projectile(const Projectile& copy);
+
+	/** 
+	 * @return The projectile's id in its GameArena (NULL_POOL_ID if it is not in one). Unlike
+	 * a pointer, the id can be held after the projectile is destroyed, and is then never
+	 * resolved to another projectile. @see GameArena::projectile()
+	 */
+	PoolId id() const;
+
+	/** Sets the projectile's id (only used by the GameArena) */
+	void id(PoolId id);
+
+	/** @return The serial number of the object which fired the projectile (0 if it has none) */
+	unsigned long owner() const;
+
+	/** Sets the serial number of the object which fired the projectile */
+	void owner(unsigned long serial);
+
 	void updatePhysics(Real timeElapsed);
 
 	Real damage() const;
 
 	Real lifeTime() const;
 
-	Real lifeTime(Real time);
+	void lifeTime(Real time);
 
 	bool expired() const;
+
+	/** @return The projectile's lifetime component (in its store, or held locally while detached) */
+	LifetimeComponent & lifetimeComponent();
+
+	/** @return The projectile's lifetime component (in its store, or held locally while detached) */
+	const LifetimeComponent & lifetimeComponent() const;
+
+	/** @see GameObject::attach() */
+	virtual void attach(EntityStore * store, EntityId entity);
+
+	/** @see GameObject::detach() */
+	virtual void detach();
 };
 
 
@@ -117,16 +253,14 @@ private:
 	 * by this object */
 	PagedMemoryPool * mp_memory;
 
-	/** The time which should elapse between projectile generations */
-	Real m_reloadTime;
-
-	/** The time which has elapsed since the last projectile generation */
-	Real m_lastShotCounter;
+	/** The store holding the weapon's reload state (NULL while the weapon is detached) */
+	EntityStore * mp_store;
 
-	/** Flag determining if the ship's weapons are currently loaded */
-	bool m_canShoot;
+	/** The weapon's entity in the store (NULL_ENTITY while the weapon is detached) */
+	EntityId m_entity;
 
-	Real m_energyCost;
+	/** The weapon's reload state while it is detached */
+	WeaponComponent m_localWeapon;
 
 public:
 	/** Generates a new (loaded) weapon with the specified reload time */
@@ -144,12 +278,36 @@ public:
 
 	void resetShotCounter();
 
+	/** Loads the weapon, as if its reload time had elapsed */
+	void reload();
+
+	/** Loads the weapon with the passed reload state, as if its reload time had elapsed */
+	static void reload(WeaponComponent & weapon);
+
+	/** @return The time which should elapse between projectile generations */
+	Real reloadTime() const;
+
 	Real energyCost();
 
 	/** Generates a projectile PhysicsObject, and resets the weapons's reload counter*/
 	virtual Projectile fireWeapon(PhysicsObject& origin) = 0;
 
 	void updatePhysics(Real timeElapsed);
+
+	/** @return The weapon's entity (NULL_ENTITY if the weapon is detached) */
+	EntityId entity() const;
+
+	/** @return The weapon's component (in its store, or held locally while detached) */
+	WeaponComponent & weaponComponent();
+
+	/** @return The weapon's component (in its store, or held locally while detached) */
+	const WeaponComponent & weaponComponent() const;
+
+	/** Moves the weapon's reload state into a new component of the passed entity */
+	void attach(EntityStore * store, EntityId entity);
+
+	/** Moves the weapon's reload state out of its store (the entity itself is left to the caller) */
+	void detach();
 };
 
 
@@ -164,6 +322,12 @@ public:
 
 	PlasmaCannon(const PlasmaCannon& copy);
 
+	/** @return True if the next projectile will be fired from the left side */
+	bool shootLeft() const;
+
+	/** Sets which side the next projectile will be fired from (true for the left) */
+	void shootLeft(bool left);
+
 	virtual Projectile fireWeapon(PhysicsObject& origin);
 };
 
@@ -191,6 +355,36 @@ private:
 	/** The distance the satelite must maintain from its center (if a center is specified) */
 	Real m_radius;
 
+	/** The galaxy sector whose system the body belongs to (-1 if it isn't part of a galaxy) */
+	int m_sector;
+
+	/** 
+	 * The body's orbital elements while it is detached. If the orbit is on rails, the
+	 * body's position and velocity are evaluated in closed form from its orbital elements
+	 * rather than being simulated (only meaningful if a center is specified).
+	 */
+	OrbitComponent m_localOrbit;
+
+	/** 
+	 * The first body orbiting this one, and the next and previous bodies orbiting the same
+	 * center. Bodies are only in their center's satellite list while attached to a store.
+	 */
+	CelestialBody * mp_satellites;
+	CelestialBody * mp_nextSatellite;
+	CelestialBody * mp_prevSatellite;
+
+	/** Adds the body to its center's satellite list */
+	void linkToCenter();
+
+	/** Removes the body from its center's satellite list */
+	void unlinkFromCenter();
+
+	/** Places the body on its orbit and stores the orbital elements (see constructors) */
+	void placeInOrbit(Real distance, Real speed, Real angle, Real inclination, bool reverse);
+
+	/** Marks the body kinematic if its orbit is on rails, so the physics system skips it */
+	void updateKinematic();
+
 public:
 	/** 
 	 * Constructs a CelestialBody with no orbital physics
@@ -201,10 +395,19 @@ public:
 	/**
 	 * Constructs a CelestialBody in a random position in orbit around the
 	 * specified CelestialBody at the specified distance (edge to edge, not center
-	 * to center) and speed.
+	 * to center) and speed. The position is drawn from the passed random stream.
+	 */
+	CelestialBody(ObjectType type, Real mass, Real radius, CelestialBody * center, 
+		Real distance, Real speed, RandomStream & random, PagedMemoryPool * memoryMgr);
+
+	/**
+	 * Constructs a CelestialBody in orbit around the specified CelestialBody at the
+	 * specified distance (edge to edge) and speed. The position on the orbit is given by
+	 * an angle around the center's Y axis and an inclination in the range [-1, 1] (the Y
+	 * coordinate of the position on a unit sphere), and reverse flips the orbit direction.
 	 */
 	CelestialBody(ObjectType type, Real mass, Real radius, CelestialBody * center, 
-		Real distance, Real speed, PagedMemoryPool * memoryMgr);
+		Real distance, Real speed, Real angle, Real inclination, bool reverse, PagedMemoryPool * memoryMgr);
 
 	/** Copy Constructor */
 	CelestialBody(const CelestialBody & copy);
@@ -213,7 +416,7 @@ public:
 	 * @return A constraint is generated which maintains a circular orbit at the 
 	 * body's current velocity if applied.
 	 */
-	Constraint constraint() const;
+	Constraint constraint();
 
 	/** @return True if this body is set to orbit another body */
 	bool hasCenter() const;
@@ -224,9 +427,55 @@ public:
 	/** @return A pointer to the orbital center of the celestial body (NULL if none is specified) */
 	CelestialBody * center() const;
 
+	/** 
+	 * @return The first attached body orbiting this one (NULL if there are none). The rest
+	 * are reached through nextSatellite().
+	 */
+	CelestialBody * satellites() const;
+
+	/** @return The next attached body orbiting the same center (NULL if this is the last) */
+	CelestialBody * nextSatellite() const;
+
 	/** @return The radius of the celestial body */
 	Real radius() const;
 
+	/** Sets the galaxy sector whose system the body belongs to (-1 for none) */
+	void sector(int sector);
+
+	/** @return The galaxy sector whose system the body belongs to (-1 if it isn't part of a galaxy) */
+	int sector() const;
+
+	/** @return True if the body's orbit is evaluated analytically rather than simulated */
+	bool onRails() const;
+
+	/** 
+	 * Sets whether the body's orbit should be evaluated analytically. Has no effect
+	 * on bodies without an orbital center.
+	 */
+	void onRails(bool onRails);
+
+	/** Sets the arena time at which the orbit starts (the body's current position) */
+	void orbitEpoch(double time);
+
+	/**
+	 * Sets the body's position and velocity to the closed form solution of its orbit
+	 * at the specified arena time. Orbital centers which are also on rails are evaluated
+	 * first, and each body is evaluated at most once for any given time.
+	 */
+	void evaluateOrbit(double time);
+
+	/** @return The body's orbit component (in its store, or held locally while detached) */
+	OrbitComponent & orbitComponent();
+
+	/** @return The body's orbit component (in its store, or held locally while detached) */
+	const OrbitComponent & orbitComponent() const;
+
+	/** @see GameObject::attach() */
+	virtual void attach(EntityStore * store, EntityId entity);
+
+	/** @see GameObject::detach() */
+	virtual void detach();
+
 	/** @see GameObject::updatePhysics(Real) */
 	virtual void updatePhysics(Real timeElapsed);
 };
@@ -261,40 +510,164 @@ public:
 
 	Projectile * fireWeapon(GameArena& arena, int weaponIndex);
 
+	/** @return The number of weapons equipped on the ship */
+	int numWeapons() const;
+
+	/** @return The weapon at the passed index (in the order the weapons were added) */
+	Weapon * weapon(int weaponIndex) const;
+
 	/** Updates the ship's position and reload status */
 	void updatePhysics(Real timeElapsed);
+
+	/** @see GameObject::attach(). Each of the ship's weapons is given an entity of its own. */
+	virtual void attach(EntityStore * store, EntityId entity);
+
+	/** @see GameObject::detach(). The entities of the ship's weapons are destroyed. */
+	virtual void detach();
+};
+
+/**
+ * The PlayerInput struct holds the commands issued to the player's ship for a
+ * physics update. Held controls are applied on every update, while pitch and yaw
+ * are accumulated until the next update consumes them.
+ */
+struct PlayerInput
+{
+	bool thrustForward;
+	bool thrustReverse;
+	bool strafeLeft;
+	bool strafeRight;
+	bool brake;
+	bool rollLeft;
+	bool rollRight;
+	bool firePrimary;
+	bool fireSecondary;
+
+	/** True while the grapple should be attached to the nearest anchor */
+	bool grapple;
+
+	/** Pitch to apply (in radians, positive for forward pitch) */
+	Real pitch;
+
+	/** Yaw to apply (in radians, positive for right yaw) */
+	Real yaw;
+
+	/** Constructs an input with no controls held */
+	PlayerInput();
+
+	/** @return The held controls, one bit each (in the order they are declared, from bit 0) */
+	unsigned int controls() const;
+
+	/** Sets the held controls from their bits (see controls()) */
+	void controls(unsigned int bits);
+};
+
+/**
+ * A Contact records two objects found touching during a physics update. Contacts
+ * are gathered for the whole update before any of them affect the game.
+ */
+struct Contact
+{
+	/** The object which was being tested (a projectile, ship or body, in that order of precedence) */
+	GameObject * objectA;
+
+	/** The object it touched (NULL for an empty contact) */
+	GameObject * objectB;
+
+	/** The arena time at which the objects first touched */
+	double time;
+
+	/** Constructs an empty contact */
+	Contact();
+
+	/** Constructs a contact between the passed objects */
+	Contact(GameObject * a, GameObject * b, double time);
 };
 
 /**
  * Interface for listening on a GameArena instance.
  * This interface should be extended by classes which are interested in being notified
- * whenever an object is added to or removed from the game arena
+ * whenever an object is added to or removed from the game arena.
+ *
+ * Notifications are delivered in batches. New objects and constraints are collected and
+ * passed on once per update (see GameArena::flushNotifications()), and everything destroyed
+ * together is passed on in one call, just before its memory is released. Listeners are
+ * always told of an object's creation before its destruction.
  */
 class GameArenaListener
 {
 public:
-	/** Called whenever a new GameObject is generated in the GameArena */
-	virtual void newGameObject(GameObject * object) = 0;
+	/** Called with every GameObject generated in the GameArena since the last notification */
+	virtual void newGameObjects(const std::vector<GameObject *>& objects) = 0;
 
-	/** Called just before a GameObject is destroyed in the GameArena */
-	virtual void destroyedGameObject(GameObject * object) = 0;
+	/** Called just before a batch of GameObjects is destroyed in the GameArena */
+	virtual void destroyedGameObjects(const std::vector<GameObject *>& objects) = 0;
+
+	/** Called with every Constraint generated in the GameArena since the last notification */
+	virtual void newConstraints(const std::vector<Constraint *>& constraints) = 0;
+
+	/** Called just before a batch of Constraints is destroyed in the GameArena */
+	virtual void destroyedConstraints(const std::vector<Constraint *>& constraints) = 0;
+};
+
+/**
+ * Enumeration of the kinds of timed event scheduled by a GameArena
+ */
+enum TimerType {
+	/** A projectile's lifetime has elapsed (the event id is the projectile's PoolId) */
+	TIMER_PROJECTILE_EXPIRY,
 
-	/** Called whenever a new Constraint is generated in the GameArena */
-	virtual void newConstraint(Constraint * object) = 0;
+	/** A weapon has reloaded (the id is the weapon's entity) */
+	TIMER_WEAPON_RELOAD,
 
-	/** Called just before a Constraint is destroyed in the GameArena */
-	virtual void destroyedConstraint(Constraint * object) = 0;
+	/** A killed NPC ship may be replaced */
+	TIMER_NPC_RESPAWN
 };
 
+/**
+ * Enumeration of the phases of GameArena::updatePhysics(), in the order they run. Used to
+ * report profiling times. Constrained covers integrating the origins of constraints, integration
+ * covers the dense pass over every other entity, orbits covers placing analytically orbiting
+ * bodies, and components covers energy, timed events and NPC ship steering. Collisions
+ * covers detection and gathering the contact list, contacts covers applying them (including
+ * destroying spent objects), and cleanup covers detonations, dead ship removal and resetting
+ * the player.
+ */
+enum UpdatePhase { UPDATE_CONSTRAINED, UPDATE_INTEGRATION, UPDATE_ORBITS, UPDATE_COMPONENTS,
+	UPDATE_CONSTRAINTS, UPDATE_COLLISIONS, UPDATE_CONTACTS, UPDATE_CLEANUP, NUM_UPDATE_PHASES };
+
 /**
  * GameArena represents a cube of space in which ships, projectiles, and other
  * objects should undergo physics simulation. The GameArena is responsible for
  * storing references to all involved PhysicsObjects, and notifying listeners
  * when new objects are created and destroyed.
+ *
+ * Objects are removed from their lists in constant time, by moving the last object
+ * in the list into the removed object's slot. This means:
+ * - Destroying an object invalidates iterators to the last element of its list, and
+ *   reorders the list. Pointers to objects stay valid until they are destroyed.
+ * - Loops which destroy the object at the current position must continue from the
+ *   returned iterator without advancing it, as it refers to the moved object.
+ * - Objects must not be destroyed while the list is being read on worker threads,
+ *   and callers outside the arena (e.g. the frame listener) should only destroy
+ *   objects between calls to update().
+ *
+ * During a physics update objects are never destroyed directly. They are killed
+ * instead, which only marks them dead, and are all destroyed together at the end of
+ * the update. Killed objects stay in their lists (and their pointers stay valid) until
+ * then, so loops within the update never have their iterators invalidated.
+ *
+ * Every object in the arena is attached to an entity in the arena's EntityStore, and
+ * the physics update runs as a series of systems over the store's component arrays.
+ * Anything which happens after a delay (projectile expiry, weapon reloads, respawns) is
+ * scheduled on the arena's timing wheel, so only objects whose timers fire are touched.
  */
 class GameArena
 {
 private:
+	/** Saves and restores the arena's complete state (see ArenaSerializer) */
+	friend class ArenaSerializer;
+
 	/**
 	 * The size of the game arena.
 	 * Arenas are a cube centered on the origin, and each wall
@@ -308,9 +681,19 @@ private:
 	/** A vector of pointers to dynamically allocated memory for all npc ships in the GameArena */
 	std::vector<SpaceShip *> mp_npcShips;
 
-	/** A vector of pointers to dynamically allocated memory for all projectiles in the GameArena */
+	/** 
+	 * A vector of pointers to all projectiles in the GameArena, in the order they were added.
+	 * The projectiles themselves are stored by value in m_projectilePool.
+	 */
 	std::vector<Projectile *> mp_projectiles;
 
+	/**
+	 * Contiguous storage for all projectiles in the GameArena, holding their physics and
+	 * lifetime state in place. Projectiles are integrated and tested for collisions by
+	 * passes over the pool's slots, in slot order.
+	 */
+	ObjectPool<Projectile> m_projectilePool;
+
 	/** A vector of pointers to dynamically allocated memory for all celestial bodies in the GameArena */
 	std::vector<CelestialBody *> mp_bodies;
 
@@ -320,13 +703,320 @@ private:
 	/** A vector of pointers to GameArenaListener instances registered with the GameArena*/
 	std::vector<GameArenaListener *> mp_listeners;
 
+	/** Objects created since listeners were last notified (only collected while there are listeners) */
+	std::vector<GameObject *> m_createdObjects;
+
+	/** Constraints created since listeners were last notified (only collected while there are listeners) */
+	std::vector<Constraint *> m_createdConstraints;
+
+	/** The batch of destroyed objects being passed to listeners */
+	std::vector<GameObject *> m_destroyedObjects;
+
+	/** The batch of destroyed constraints being passed to listeners */
+	std::vector<Constraint *> m_destroyedConstraints;
+
+	/** The EventChannels every event in the arena is published to */
+	std::vector<EventChannel *> mp_eventChannels;
+
 	/** The paged memory pool which will store game objects */
 	PagedMemoryPool m_memory;
 
+	/** The components of every object in the arena */
+	EntityStore m_entities;
+
+	/** The serial number given to the last object added to the arena */
+	unsigned long m_lastSerial;
+
+	/** The number of physics updates performed (used to mark entities integrated in the current update) */
+	unsigned long m_stepCount;
+
+	/** Timed events, due at arena times */
+	TimingWheel m_timers;
+
+	/** The events fired by the current update (kept to avoid reallocating every update) */
+	std::vector<TimerEvent> m_firedTimers;
+
+	/** The delay before a killed NPC ship is replaced (0 to replace it on the next update) */
+	Real m_npcRespawnDelay;
+
+	/** The number of killed NPC ships waiting to be replaced */
+	int m_pendingRespawns;
+
+	/** The pairs of object types tested for collisions */
+	CollisionMatrix m_collisionMatrix;
+
+	/** Worker threads used to parallelise the physics update */
+	WorkerPool m_workers;
+
+	/** Solver used to satisfy all constraints after objects have been integrated */
+	ConstraintSolver m_solver;
+
+	/** The galaxy whose systems are generated around the player (inactive unless generated) */
+	Galaxy m_galaxy;
+
+	/** The bodies tested for collisions and placed on every update, while there is a galaxy */
+	std::vector<CelestialBody *> m_activeBodies;
+
+	/** The bodies of reduced sectors, placed every Galaxy::REDUCED_INTERVAL updates */
+	std::vector<CelestialBody *> m_reducedBodies;
+
+	/** True if bodies or sector activities have changed since the body lists were sorted */
+	bool m_sectorBodiesDirty;
+
+	/** The time simulated since the dynamic bodies of reduced sectors were last integrated */
+	Real m_reducedTime;
+
+	/** 
+	 * The total amount of simulated time elapsed in the arena. Kept in double precision,
+	 * as orbit angles and timer due times are measured from it for the whole match.
+	 */
+	double m_simTime;
+
+	/** The length of the physics update currently being performed */
+	Real m_stepTime;
+
+	/** For each projectile, the first ship or body it touched this update (empty if none) */
+	std::vector<Contact> m_projectileContacts;
+
+	/** For each NPC ship, the first body it touched this update (empty if none) */
+	std::vector<Contact> m_shipContacts;
+
+	/** Every contact found during the last physics update, in detection order */
+	std::vector<Contact> m_contacts;
+
+	/** NPC ships killed during the current update */
+	std::vector<SpaceShip *> m_deadNpcShips;
+
+	/** Projectiles killed during the current update */
+	std::vector<Projectile *> m_deadProjectiles;
+
+	/** Celestial bodies killed during the current update */
+	std::vector<CelestialBody *> m_deadBodies;
+
+	/** Constraints killed during the current update */
+	std::vector<Constraint *> m_deadConstraints;
+
+	/** If set to true, newly added orbiting bodies have their orbits evaluated analytically */
+	bool m_analyticOrbits;
+
+	/** Random stream used for world generation */
+	RandomStream m_worldRandom;
+
+	/** Random stream used during physics updates (detonations, spawning) */
+	RandomStream m_simRandom;
+
+	/** The value the arena's random streams were last seeded with */
+	unsigned long long m_seed;
+
+	/** The length of each physics update performed by update() (0 to use the frame time) */
+	Real m_fixedStep;
+
+	/** Frame time passed to update() which has not yet been simulated */
+	Real m_stepAccumulator;
+
+	/** The input to apply to the player's ship on each physics update */
+	PlayerInput m_playerInput;
+
+	/** The recording the input of every physics update is appended to (NULL if not recording) */
+	InputRecording * mp_recording;
+
+	/** The constraint attaching the player to an anchor (NULL if not grappling) */
+	Constraint * mp_grapple;
+
+	/** The number of NPC ships which should be kept in the arena */
+	int m_npcShipTarget;
+
+	/** Bounding volume hierarchy over all objects in the arena, used for spatial queries */
+	SpatialIndex m_spatialIndex;
+
+	/** True if objects have been added or removed since the spatial index was built */
+	bool m_spatialIndexDirty;
+
+	/** True if objects have moved since the spatial index was last built or refit */
+	bool m_spatialIndexMoved;
+
+	/**
+	 * Brings the spatial index up to date, rebuilding it if objects have been added or
+	 * removed, and otherwise refitting it around the objects' current positions
+	 */
+	void updateSpatialIndex();
+
+	/** If true, the time spent in each phase of updatePhysics() is recorded */
+	bool m_profiling;
+
+	/** Timer used to measure update phases */
+	Timer m_profileTimer;
+
+	/** The timer reading (in microseconds) at which the current phase began */
+	unsigned long m_phaseStart;
+
+	/** The total time (in microseconds) spent in each phase since profiling was reset */
+	unsigned long m_phaseTimes[NUM_UPDATE_PHASES];
+
+	/** The number of updates profiled since profiling was reset */
+	unsigned long m_profiledUpdates;
+
+	/** 
+	 * Ends the passed update phase (if profiling), adding the time since the previous
+	 * phase ended to its total.
+	 */
+	void endPhase(UpdatePhase phase);
+
+	/** 
+	 * Switches an analytically orbiting body over to dynamic simulation, generating
+	 * the constraint which maintains its orbit.
+	 */
+	void releaseOrbit(CelestialBody * body);
+
+	/** Destroys every constraint attached to the passed object */
+	void destroyAttachedConstraints(PhysicsObject * object);
+
+	/**
+	 * Adds the planned bodies of a star system, with its star at the passed position. The
+	 * bodies belong to the passed galaxy sector (-1 for none).
+	 */
+	void addStarSystem(const Vector3 & position, const std::vector<BodyPlan> & bodies, int sector);
+
+	/**
+	 * Adds the galaxy's systems which the player (or the origin, without one) has come in range
+	 * of, then pages out the bodies of sectors which have been frozen and restores those of
+	 * sectors which are no longer frozen
+	 */
+	void streamGalaxy();
+
+	/** Saves the bodies of a frozen sector's system to the galaxy's pages and removes them from the arena */
+	void freezeSector(int sector);
+
+	/** Sorts the bodies into active and reduced lists by the activity of the sectors holding them */
+	void sortSectorBodies();
+
+	/** @return The bodies tested for collisions (only those in active sectors, while there is a galaxy) */
+	const std::vector<CelestialBody *> & collisionBodies() const;
+
+	/** Places the analytically orbiting bodies, by the activity of their sectors while there is a galaxy */
+	void orbitBodies();
+
+	/** Applies the current player input to the player's ship for an update of the passed length */
+	void applyPlayerInput(Real timeElapsed);
+
+	/** Attaches or releases the player's grapple based on whether it is held */
+	void updateGrapple(bool held);
+
+	/** Adds randomly placed NPC ships until the NPC ship target is met */
+	void spawnNpcShips();
+
+	/** Fires every timed event due by the current arena time, skipping those whose targets are gone */
+	void fireTimers();
+
+	/**
+	 * Gives an object added to the arena the next serial number, and attaches it to a new
+	 * entity (unless attach is false, for objects which keep their state in place)
+	 */
+	void registerObject(GameObject * object, bool attach = true);
+
+	/** Detaches an object leaving the arena, and destroys its entity */
+	void unregisterObject(GameObject * object);
+
+	/**
+	 * Integrates every object which is the origin of a constraint, split into as many
+	 * substeps as the object or its constraints need, with the constraints projected
+	 * between substeps. Integrated objects are marked so the dense pass skips them.
+	 */
+	void integrateConstrained(Real timeElapsed);
+
+	/**
+	 * Integrates the passed components over the passed time, split into as many substeps
+	 * as they need. Components already integrated in this update are skipped.
+	 */
+	void integrateComponents(TransformComponent & transform, PhysicsComponent & physics, Real timeElapsed);
+
+	/**
+	 * Integrates the dynamic bodies of reduced sectors every Galaxy::REDUCED_INTERVAL updates,
+	 * over the time since they were last integrated. They are skipped by the other integration
+	 * passes.
+	 */
+	void integrateReducedBodies(Real timeElapsed);
+
+	/** Integrates the entities in the range [begin, end) of the store's physics array */
+	void integrateEntities(int begin, int end);
+
+	/** Integrates the projectiles in the range [begin, end) of the projectile pool's slots */
+	void integrateProjectiles(int begin, int end);
+
+	/** Reverses NPC ships which have left the arena, and turns them to face their velocity */
+	void steerNpcShips(int begin, int end);
+
+	/**
+	 * @return The contact between the passed objects if they touch (an empty contact if they
+	 * don't). Two sleeping objects cannot have moved into each other, so are never tested.
+	 * If swept is true, objects which passed through each other during the update also touch
+	 * (see SphereCollisionObject::sweptCollision()).
+	 */
+	Contact findContact(GameObject * a, GameObject * b, bool swept = false);
+
+	/** @return True if the projectile may hit the object (it never hits its owner unless allowed) */
+	bool projectileHits(const Projectile * projectile, GameObject * object) const;
+
+	/**
+	 * Finds the first ship, projectile or body hit by each projectile in the range
+	 * [begin, end) of the projectile pool's slots
+	 */
+	void detectProjectileCollisions(int begin, int end);
+
+	/** Finds the first ship or body hit by each NPC ship in the range [begin, end) */
+	void detectShipCollisions(int begin, int end);
+
+	/** 
+	 * Builds the contact list for the update from the per object detection results,
+	 * followed by player/body and body/body contacts.
+	 */
+	void gatherContacts();
+
+	/** 
+	 * Applies the damage rules for every contact in the contact list, killing spent
+	 * projectiles and crashed ships (expired projectiles are killed by their timers).
+	 */
+	void applyContacts();
+
+	/** Inflicts damage on an object, publishing the damage dealt by the source object */
+	void damageObject(GameObject * object, GameObject * source, Real damage);
+
+	/** Pushes an event onto every registered EventChannel */
+	void publishEvent(const ArenaEvent & event);
+
+	/**
+	 * Destroys every object killed during the update in one batch. Satellites of killed
+	 * bodies are passed on to their nearest living center, and constraints attached to
+	 * killed objects are killed as well (both found through the killed objects' own
+	 * satellite and constraint lists). The object lists are then compacted in a single
+	 * pass (keeping the order of the living objects), before listeners are notified and
+	 * memory is freed.
+	 */
+	void reclaimDead();
+
+	/** Queues the creation of an object for the next batch of notifications */
 	void notifyObjectCreation(GameObject * object);
+
+	/** Notifies listeners of the destruction of a single object (see notifyObjectDestructions()) */
 	void notifyObjectDestruction(GameObject * object);
+
+	/** Queues the creation of a constraint for the next batch of notifications */
 	void notifyConstraintCreation(Constraint * object);
+
+	/** Notifies listeners of the destruction of a single constraint (see notifyConstraintDestructions()) */
 	void notifyConstraintDestruction(Constraint * object);
+
+	/** 
+	 * Notifies listeners of the destruction of a batch of objects (any queued creations are
+	 * delivered first)
+	 */
+	void notifyObjectDestructions(const std::vector<GameObject *>& objects);
+
+	/** 
+	 * Notifies listeners of the destruction of a batch of constraints (any queued creations
+	 * are delivered first)
+	 */
+	void notifyConstraintDestructions(const std::vector<Constraint *>& constraints);
 public:
 	/** 
 	 * Constructs a new, empty GameArena with the specified size and inital
@@ -343,6 +1033,24 @@ public:
 	/** Unregisters a GameArenaListener from the GameArena */
 	void removeGameArenaListener(GameArenaListener * listener);
 
+	/**
+	 * Registers an EventChannel with the GameArena. Every spawn, destruction, constraint,
+	 * damage and detonation in the arena is pushed onto the channel as it happens, to be
+	 * popped by a consumer on its own thread. Channels must only be added or removed
+	 * between updates.
+	 */
+	void addEventChannel(EventChannel * channel);
+
+	/** Unregisters an EventChannel from the GameArena */
+	void removeEventChannel(EventChannel * channel);
+
+	/** 
+	 * Passes every object and constraint created since the last notification on to the
+	 * registered listeners. Called at the end of every update, so this only needs to be
+	 * called by owners which want objects added between updates reported straight away.
+	 */
+	void flushNotifications();
+
 	Real size() const;
 
 	/**
@@ -365,9 +1073,14 @@ public:
 	/** 
 	 * Destroys a celestial body, erasing it from the vector of stored bodies.
 	 * Any attached constraints are also destroyed.
+	 * @return An iterator to the body which took the destroyed body's slot (or end())
 	 */
 	std::vector<CelestialBody * >::iterator destroyBody(CelestialBody * body);
 
+	/** 
+	 * Destroys a constraint, erasing it from the vector of stored constraints.
+	 * @return An iterator to the constraint which took the destroyed constraint's slot (or end())
+	 */
 	std::vector<Constraint * >::iterator destroyConstraint(Constraint * constraint);
 
 	SpaceShip * addNpcShip(const SpaceShip& ship);
@@ -380,40 +1093,243 @@ public:
 	 */
 	Projectile * addProjectile(const Projectile& projectile);
 
-	/** Destroys a projectile, erasing it from the vector of stored PhysicsObjects */
+	/** 
+	 * Destroys a projectile, erasing it from the vector of stored PhysicsObjects
+	 * @return An iterator to the projectile which took the destroyed projectile's slot (or end())
+	 */
 	std::vector<Projectile * >::iterator destroyProjectile(Projectile * projectile);
 
+	/** 
+	 * Destroys an NPC ship, erasing it from the vector of stored ships. Any attached
+	 * constraints are also destroyed.
+	 * @return An iterator to the ship which took the destroyed ship's slot (or end())
+	 */
 	std::vector<SpaceShip * >::iterator destroyNpcShip(SpaceShip * npcShip);
 
+	/** Kills an NPC ship, which is destroyed at the end of the current update */
+	void killNpcShip(SpaceShip * npcShip);
+
+	/** Kills a projectile, which is destroyed at the end of the current update */
+	void killProjectile(Projectile * projectile);
+
+	/** Kills a celestial body, which is destroyed at the end of the current update */
+	void killBody(CelestialBody * body);
+
+	/** Kills a constraint, which is destroyed at the end of the current update */
+	void killConstraint(Constraint * constraint);
+
 	/** @return A pointer to the player's ship */
 	SpaceShip * playerShip();
 
 	/** @return The list of pointers to all active projectiles */
 	std::vector<Projectile *> * projectiles();
 
+	/** @return The projectile with the passed id (NULL if it has been destroyed) */
+	Projectile * projectile(PoolId id);
+
 	/** @return The list of pointers to all active ships */
 	std::vector<SpaceShip *> * npcShips();
 
+	/** 
+	 * @return The contacts found during the last physics update. Objects destroyed as
+	 * a result of the update may still be referenced, so the list should only be used
+	 * to identify objects (not dereference them) once the update has finished.
+	 */
+	const std::vector<Contact> * contacts() const;
+
+	/** @return The collision matrix, which may be modified to enable or disable collision pairs */
+	CollisionMatrix * collisionMatrix();
+
+	/**
+	 * Finds the first object hit by a ray. Only objects whose type bit (1 << type) is set
+	 * in typeMask are considered. The spatial index is rebuilt by the first query after
+	 * the arena changes, so queries should not be made while the arena is updating.
+	 * @return True if an object was hit within maxDistance (stored in hit)
+	 */
+	bool raycast(const Vector3 & origin, const Vector3 & direction, Real maxDistance, RayHit & hit,
+		unsigned int typeMask = ALL_OBJECT_TYPES);
+
+	/** 
+	 * Finds all objects hit by a ray, appending them to hits in order of distance.
+	 * @see GameArena::raycast()
+	 * @return The number of hits found
+	 */
+	int raycastAll(const Vector3 & origin, const Vector3 & direction, Real maxDistance, 
+		std::vector<RayHit> & hits, unsigned int typeMask = ALL_OBJECT_TYPES);
+
+	/** @see GameArena::raycast(), for a sphere of the passed radius swept along the ray */
+	bool sphereCast(const Vector3 & origin, Real radius, const Vector3 & direction, Real maxDistance,
+		RayHit & hit, unsigned int typeMask = ALL_OBJECT_TYPES);
+
+	/** @see GameArena::raycastAll(), for a sphere of the passed radius swept along the ray */
+	int sphereCastAll(const Vector3 & origin, Real radius, const Vector3 & direction, Real maxDistance,
+		std::vector<RayHit> & hits, unsigned int typeMask = ALL_OBJECT_TYPES);
+
+	/** 
+	 * Finds the k objects of the masked types nearest the passed position, in order of distance.
+	 * results must have room for k entries. No memory is allocated (beyond rebuilding the
+	 * spatial index, @see GameArena::raycast()).
+	 * @return The number of objects found (at most k)
+	 */
+	int queryNearest(const Vector3 & position, int k, unsigned int typeMask, SpatialResult * results);
+
+	/**
+	 * Finds the objects of the masked types within radius of the passed position, storing
+	 * up to maxResults of them in results. @see GameArena::queryNearest()
+	 * @return The number of objects found, which may exceed maxResults
+	 */
+	int queryRadius(const Vector3 & position, Real radius, unsigned int typeMask, SpatialResult * results,
+		int maxResults);
+
 	/** @return The list of pointers to all celestial bodies */
 	std::vector<CelestialBody *> * bodies();
 
+	/** @return The list of pointers to all constraints */
+	std::vector<Constraint *> * constraints();
+
+	/** @return The store holding the components of every object in the arena */
+	EntityStore * entities();
+
 	/** 
 	 * @return A pointer to the PhysicsObject produced by generating a projectile from the passed ship 
 	 * and stored in dynamic memory.
 	 */
 	Projectile * fireProjectileFromShip(SpaceShip * ship, int weaponIndex);
 
-	/** Updates the physics of all ships and projectiles in the arena */
+	/**
+	 * Reseeds all of the arena's random streams. An arena seeded with the same value,
+	 * using a fixed step and fed the same player input for each step always reaches
+	 * the same state.
+	 */
+	void seed(unsigned long long seed);
+
+	/** @return The value the arena's random streams were last seeded with */
+	unsigned long long seed() const;
+
+	/** 
+	 * Sets the length of the physics updates performed by update(). If 0, each
+	 * call to update() performs a single update of the passed frame time.
+	 */
+	void fixedStep(Real step);
+
+	/** @return The length of the physics updates performed by update() (0 if variable) */
+	Real fixedStep() const;
+
+	/** 
+	 * Sets the input applied to the player's ship on following updates. Pitch and yaw
+	 * are added to any rotation not yet consumed by an update.
+	 */
+	void playerInput(const PlayerInput& input);
+
+	/** Sets the number of NPC ships which should be kept in the arena */
+	void npcShipTarget(int count);
+
+	/** @return The number of NPC ships which should be kept in the arena */
+	int npcShipTarget() const;
+
+	/** 
+	 * Sets the delay (in seconds of arena time) before a killed NPC ship is replaced.
+	 * Killed ships count toward the NPC ship target until they are replaced.
+	 */
+	void npcRespawnDelay(Real delay);
+
+	/** @return The delay (in seconds of arena time) before a killed NPC ship is replaced */
+	Real npcRespawnDelay() const;
+
+	/** Schedules a weapon which has just fired to reload once its reload time has elapsed */
+	void scheduleReload(Weapon * weapon);
+
+	/**
+	 * Advances the arena by the passed frame time. Galaxy systems in range of the player are
+	 * generated, NPC ships spawned and player input applied before each physics update. With
+	 * a fixed step, as many fixed updates as fit in the accumulated frame time are performed
+	 * (unsimulated time carries over).
+	 * @return The number of physics updates performed
+	 */
+	int update(Real frameTime);
+
+	/**
+	 * Performs a single fixed step with the passed input, replacing any held input (pitch and
+	 * yaw are not added to unconsumed rotation). Used to play back recorded input, as the
+	 * arena then reaches the same state as when the input was recorded. The arena must have
+	 * a fixed step.
+	 */
+	void step(const PlayerInput& input);
+
+	/**
+	 * Starts appending the input applied on each physics update to the passed recording, or
+	 * stops recording if it is NULL (see InputRecording)
+	 */
+	void recordInput(InputRecording * recording);
+
+	/** 
+	 * Updates the physics of all ships and projectiles in the arena. Integration (over the
+	 * entity store's physics array) and collision detection are split across the arena's
+	 * worker threads by range.
+	 */
 	void updatePhysics(Real timeElapsed);
 
+	/** @return The total amount of simulated time elapsed in the arena */
+	double simTime() const;
+
+	/** Enables or disables recording of the time spent in each phase of updatePhysics() */
+	void profiling(bool enabled);
+
+	/** @return True if the phases of updatePhysics() are being profiled */
+	bool profiling() const;
+
+	/** Clears all recorded phase times */
+	void resetProfile();
+
+	/** @return The total time (in microseconds) spent in the passed phase since profiling was reset */
+	unsigned long phaseTime(UpdatePhase phase) const;
+
+	/** @return The number of updates profiled since profiling was reset */
+	unsigned long profiledUpdates() const;
+
+	/** Sets the number of constraint solver iterations performed on each physics update */
+	void constraintIterations(int iterations);
+
+	/** @return The number of constraint solver iterations performed on each physics update */
+	int constraintIterations() const;
+
+	/** 
+	 * Sets whether bodies added to the arena from now on should follow analytic (on-rails)
+	 * orbits. Bodies fall back to dynamic simulation when hit or when their center is destroyed.
+	 */
+	void analyticOrbits(bool analytic);
+
+	/** @return True if newly added orbiting bodies follow analytic orbits */
+	bool analyticOrbits() const;
+
 	/** Generates a randomly distributed solar system (collection of celestial objects) */
 	void generateSolarSystem();
 
-	/** Destroys all celestial bodies, and all constraints that reference them */
+	/**
+	 * Creates a galaxy of star systems, seeded from the world random stream (see Galaxy).
+	 * No bodies are added here: each system is generated by the update which first brings
+	 * the player within range of it.
+	 */
+	void generateGalaxy(int sectorsPerSide, Real sectorSize, Real density);
+
+	/** @return The arena's galaxy (inactive unless one has been generated) */
+	const Galaxy & galaxy() const;
+
+	/** Sets the directory frozen galaxy sectors are paged out to (empty to keep them in memory) */
+	void galaxyPageDirectory(const std::string & directory);
+
+	/** Destroys all celestial bodies, and all constraints that reference them, and removes the galaxy */
 	void clearSolarSystem();
 
+	/**
+	 * Destroys every object and constraint in the arena (including the player's ship), removes
+	 * the galaxy and discards all pending timers. Settings, random streams and the arena time
+	 * are kept.
+	 */
+	void clear();
+
 	/** @return The memory manager used by this GameArena */
 	PagedMemoryPool * memoryManager();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,224 @@
+#include "InputRecording.h"
+#include "ArenaSerializer.h"
+#include <fstream>
+#include <cstring>
+
+/** The header of a saved recording, followed by its config and input runs */
+struct RecordingHeader
+{
+	unsigned int magic;
+	unsigned int version;
+
+	/** The size of a Real in the build which saved the recording */
+	unsigned int realSize;
+
+	/** The number of InputRuns following the config */
+	unsigned int numRuns;
+
+	unsigned long long checksum;
+};
+
+/** @return True if the two inputs would be saved in the same run */
+bool sameInput(const PlayerInput & a, const PlayerInput & b)
+{
+	return a.controls() == b.controls() && a.pitch == b.pitch && a.yaw == b.yaw;
+}
+
+
+// ========================================================================
+// InputRecording Implementation
+// ========================================================================
+InputRecording::InputRecording() : m_inputs(), m_checksum(0)
+{
+	std::memset(&m_config, 0, sizeof(m_config));
+}
+
+void InputRecording::begin(const GameArena & arena, const std::string & setup)
+{
+	std::memset(&m_config, 0, sizeof(m_config));
+	m_config.seed = arena.seed();
+	m_config.size = arena.size();
+	m_config.fixedStep = arena.fixedStep();
+	m_config.npcRespawnDelay = arena.npcRespawnDelay();
+	m_config.npcShipTarget = arena.npcShipTarget();
+	m_config.constraintIterations = arena.constraintIterations();
+	m_config.analyticOrbits = arena.analyticOrbits();
+	std::strncpy(m_config.setup, setup.c_str(), sizeof(m_config.setup) - 1);
+
+	m_inputs.clear();
+	m_checksum = 0;
+}
+
+void InputRecording::record(const PlayerInput & input)
+{
+	m_inputs.push_back(input);
+}
+
+void InputRecording::end(GameArena & arena)
+{
+	m_checksum = checksum(arena);
+}
+
+int InputRecording::numSteps() const
+{
+	return m_inputs.size();
+}
+
+const PlayerInput & InputRecording::input(int step) const
+{
+	return m_inputs[step];
+}
+
+const ReplayConfig & InputRecording::config() const
+{
+	return m_config;
+}
+
+std::string InputRecording::setup() const
+{
+	return std::string(m_config.setup);
+}
+
+unsigned long long InputRecording::checksum() const
+{
+	return m_checksum;
+}
+
+void InputRecording::configure(GameArena & arena) const
+{
+	arena.seed(m_config.seed);
+	arena.fixedStep(m_config.fixedStep);
+	arena.npcRespawnDelay(m_config.npcRespawnDelay);
+	arena.npcShipTarget(m_config.npcShipTarget);
+	arena.constraintIterations(m_config.constraintIterations);
+	arena.analyticOrbits(m_config.analyticOrbits != 0);
+}
+
+bool InputRecording::play(GameArena & arena) const
+{
+	for(std::vector<PlayerInput>::const_iterator inputIter = m_inputs.begin();
+		inputIter != m_inputs.end();
+		inputIter++)
+	{
+		arena.step(*inputIter);
+	}
+	return m_checksum == 0 || checksum(arena) == m_checksum;
+}
+
+bool InputRecording::save(const std::string & fileName) const
+{
+	// Collapse runs of identical input
+	std::vector<InputRun> runs;
+	for(std::vector<PlayerInput>::const_iterator inputIter = m_inputs.begin();
+		inputIter != m_inputs.end();
+		inputIter++)
+	{
+		if(!runs.empty() && sameInput(*(inputIter - 1), *inputIter)) {
+			runs.back().count++;
+			continue;
+		}
+
+		InputRun run;
+		run.count = 1;
+		run.controls = inputIter->controls();
+		run.pitch = inputIter->pitch;
+		run.yaw = inputIter->yaw;
+		runs.push_back(run);
+	}
+
+	RecordingHeader header;
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.realSize = sizeof(Real);
+	header.numRuns = runs.size();
+	header.checksum = m_checksum;
+
+	std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char *>(&m_config), sizeof(m_config));
+	if(!runs.empty()) {
+		file.write(reinterpret_cast<const char *>(&runs[0]), runs.size() * sizeof(InputRun));
+	}
+	return file.good();
+}
+
+bool InputRecording::load(const std::string & fileName)
+{
+	std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if(!file) {
+		return false;
+	}
+	unsigned long long size = (unsigned long long)file.tellg();
+	file.seekg(0);
+
+	// The runs must fit in the rest of the file, so a corrupt count can't allocate more
+	RecordingHeader header;
+	ReplayConfig config;
+	if(!file.read(reinterpret_cast<char *>(&header), sizeof(header))
+		|| header.magic != MAGIC || header.version != VERSION || header.realSize != sizeof(Real)
+		|| !file.read(reinterpret_cast<char *>(&config), sizeof(config))
+		|| header.numRuns > (size - sizeof(header) - sizeof(config)) / sizeof(InputRun))
+	{
+		return false;
+	}
+
+	std::vector<InputRun> runs(header.numRuns);
+	if(!runs.empty() && !file.read(reinterpret_cast<char *>(&runs[0]), runs.size() * sizeof(InputRun))) {
+		return false;
+	}
+
+	unsigned long long numSteps = 0;
+	for(std::vector<InputRun>::iterator runIter = runs.begin();
+		runIter != runs.end();
+		runIter++)
+	{
+		numSteps += runIter->count;
+		if(numSteps > MAX_STEPS) {
+			return false;
+		}
+	}
+
+	m_config = config;
+	m_config.setup[sizeof(m_config.setup) - 1] = '\0';
+	m_checksum = header.checksum;
+	m_inputs.clear();
+	for(std::vector<InputRun>::iterator runIter = runs.begin();
+		runIter != runs.end();
+		runIter++)
+	{
+		PlayerInput input;
+		input.controls(runIter->controls);
+		input.pitch = runIter->pitch;
+		input.yaw = runIter->yaw;
+		m_inputs.insert(m_inputs.end(), runIter->count, input);
+	}
+	return true;
+}
+
+unsigned long long InputRecording::checksum(GameArena & arena)
+{
+	std::vector<char> data;
+	ArenaSerializer::save(arena, data);
+
+	// The step accumulator and unapplied input depend on how the recorded session's frames
+	// fell, not on the steps performed, so they are left out
+	unsigned int count = 0;
+	ArenaRecord * arenaRecord = reinterpret_cast<ArenaRecord *>(
+		const_cast<char *>(ArenaSerializer::findTable(&data[0], TABLE_ARENA, count)));
+	if(arenaRecord != NULL) {
+		arenaRecord->stepAccumulator = 0;
+		arenaRecord->inputPitch = 0;
+		arenaRecord->inputYaw = 0;
+		arenaRecord->inputControls = 0;
+	}
+
+	// FNV-1a over the saved state
+	unsigned long long hash = 0xCBF29CE484222325ULL;
+	for(std::vector<char>::iterator byteIter = data.begin();
+		byteIter != data.end();
+		byteIter++)
+	{
+		hash = (hash ^ (unsigned char)*byteIter) * 0x100000001B3ULL;
+	}
+	return hash;
+}
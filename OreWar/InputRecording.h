@@ -0,0 +1,139 @@
+#ifndef __InputRecording_h_
+#define __InputRecording_h_
+
+#include <vector>
+#include <string>
+#include "GameObjects.h"
+
+using namespace Ogre;
+
+/** The seed and settings an arena must be given for a recording to play back identically */
+struct ReplayConfig
+{
+	unsigned long long seed;
+
+	/** The size the arena must be constructed with (see GameArena::GameArena()) */
+	Real size;
+
+	Real fixedStep;
+	Real npcRespawnDelay;
+	int npcShipTarget;
+	int constraintIterations;
+	unsigned char analyticOrbits;
+	unsigned char padding[3];
+
+	/**
+	 * Names the setup which populated the arena before recording began (e.g. "game", or an
+	 * OreWarBench scenario), which the playing program must repeat
+	 */
+	char setup[32];
+};
+
+/** A run of physics updates applying the same input */
+struct InputRun
+{
+	/** The number of updates in the run */
+	unsigned int count;
+
+	/** The held controls (see PlayerInput::controls()) */
+	unsigned int controls;
+
+	Real pitch;
+	Real yaw;
+};
+
+/**
+ * The InputRecording class records a GameArena session as the seed and settings the arena
+ * was created with, followed by the player input applied on each physics update. An arena
+ * which is seeded, configured and populated in the same way, then fed the recorded input
+ * with GameArena::step(), reaches exactly the same state, so a session can be replayed
+ * headless at full speed (for regression and performance testing) or through the renderer.
+ *
+ * Recordings are saved with runs of identical input collapsed together, so a replay is a
+ * small fraction of the size of a single saved arena (see ArenaSerializer). A checksum of
+ * the arena's state when recording ended is saved with the input, so a replay can verify
+ * that it reached the same state.
+ */
+class InputRecording
+{
+private:
+	/** The seed and settings of the recorded arena */
+	ReplayConfig m_config;
+
+	/** The input applied on each physics update */
+	std::vector<PlayerInput> m_inputs;
+
+	/** The checksum of the arena's state when recording ended (0 if it has not ended) */
+	unsigned long long m_checksum;
+
+public:
+	/** Identifies a saved recording ("OWIR") */
+	static const unsigned int MAGIC = 0x5249574F;
+
+	/** The version of the recording format written */
+	static const unsigned int VERSION = 1;
+
+	/** The most steps a loaded recording may hold (over 38 hours at 60 steps a second) */
+	static const unsigned int MAX_STEPS = 1 << 23;
+
+	/** Constructs an empty recording */
+	InputRecording();
+
+	/**
+	 * Clears the recording, and stores the seed and settings of the passed arena. Must be
+	 * called after the arena has been populated by the named setup, and before its first update.
+	 */
+	void begin(const GameArena & arena, const std::string & setup);
+
+	/** Appends the input applied on a physics update (called by the GameArena being recorded) */
+	void record(const PlayerInput & input);
+
+	/** Stores the checksum of the arena's state, marking the end of the recording */
+	void end(GameArena & arena);
+
+	/** @return The number of physics updates recorded */
+	int numSteps() const;
+
+	/** @return The input applied on the passed physics update */
+	const PlayerInput & input(int step) const;
+
+	/** @return The seed and settings of the recorded arena */
+	const ReplayConfig & config() const;
+
+	/** @return The name of the setup which populated the recorded arena */
+	std::string setup() const;
+
+	/** @return The checksum of the arena's state when recording ended (0 if it has not ended) */
+	unsigned long long checksum() const;
+
+	/**
+	 * Seeds and configures an arena as the recorded arena was. The arena must then be
+	 * populated by the recording's setup before the input is played back.
+	 */
+	void configure(GameArena & arena) const;
+
+	/**
+	 * Plays back every recorded update on an arena which has been configured and populated
+	 * (see configure())
+	 * @return True if the arena ended in the recorded state (or the recording has no checksum)
+	 */
+	bool play(GameArena & arena) const;
+
+	/** Saves the recording to the named file @return True if the file was written */
+	bool save(const std::string & fileName) const;
+
+	/**
+	 * Loads a recording saved by save(), replacing this one
+	 * @return True if the file was read (false, leaving the recording untouched, if it is
+	 *         truncated or holds more than MAX_STEPS steps)
+	 */
+	bool load(const std::string & fileName);
+
+	/**
+	 * @return A checksum of the arena's state (as saved by ArenaSerializer), other than the
+	 *         time and input it has yet to apply
+	 */
+	static unsigned long long checksum(GameArena & arena);
+};
+
+#endif
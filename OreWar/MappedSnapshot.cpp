@@ -0,0 +1,130 @@
+#include "MappedSnapshot.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ========================================================================
+// MappedSnapshot Implementation
+// ========================================================================
+MappedSnapshot::MappedSnapshot() : mp_data(NULL), m_size(0), mp_file(NULL), mp_mapping(NULL)
+{
+}
+
+MappedSnapshot::~MappedSnapshot()
+{
+	close();
+}
+
+bool MappedSnapshot::open(const std::string & fileName)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	mp_file = file;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	m_size = (size_t)fileSize.QuadPart;
+
+	mp_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mp_mapping == NULL) {
+		close();
+		return false;
+	}
+	mp_data = static_cast<const char *>(MapViewOfFile(mp_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	int file = ::open(fileName.c_str(), O_RDONLY);
+	if(file < 0) {
+		return false;
+	}
+	mp_file = reinterpret_cast<void *>((size_t)file + 1);
+
+	struct stat fileStat;
+	if(fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+		close();
+		return false;
+	}
+	m_size = (size_t)fileStat.st_size;
+
+	void * view = mmap(NULL, m_size, PROT_READ, MAP_SHARED, file, 0);
+	mp_data = view != MAP_FAILED ? static_cast<const char *>(view) : NULL;
+#endif
+
+	// The mapping starts on a page boundary, so the tables are as aligned as they were saved
+	if(mp_data == NULL || !ArenaSerializer::validate(mp_data, m_size)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedSnapshot::close()
+{
+#ifdef _WIN32
+	if(mp_data != NULL) {
+		UnmapViewOfFile(mp_data);
+	}
+	if(mp_mapping != NULL) {
+		CloseHandle(mp_mapping);
+	}
+	if(mp_file != NULL) {
+		CloseHandle(mp_file);
+	}
+#else
+	if(mp_data != NULL) {
+		munmap(const_cast<char *>(mp_data), m_size);
+	}
+	if(mp_file != NULL) {
+		::close((int)(reinterpret_cast<size_t>(mp_file) - 1));
+	}
+#endif
+
+	mp_data = NULL;
+	m_size = 0;
+	mp_file = NULL;
+	mp_mapping = NULL;
+}
+
+bool MappedSnapshot::isOpen() const
+{
+	return mp_data != NULL;
+}
+
+const char * MappedSnapshot::data() const
+{
+	return mp_data;
+}
+
+size_t MappedSnapshot::size() const
+{
+	return m_size;
+}
+
+const ArenaRecord * MappedSnapshot::arena() const
+{
+	unsigned int count = 0;
+	return table<ArenaRecord>(TABLE_ARENA, count);
+}
+
+bool MappedSnapshot::restore(GameArena & arena) const
+{
+	if(mp_data == NULL) {
+		return false;
+	}
+	return ArenaSerializer::load(arena, mp_data, m_size);
+}
@@ -0,0 +1,87 @@
+#ifndef __MappedSnapshot_h_
+#define __MappedSnapshot_h_
+
+#include <string>
+#include "ArenaSerializer.h"
+
+/**
+ * The MappedSnapshot class maps a saved arena (see ArenaSerializer) into memory, read only,
+ * so its tables can be used in place. A save's tables are arrays of fixed size, aligned
+ * records, and the orbit hierarchy is stored as indices into the bodies table, so nothing
+ * needs to be parsed or copied to read them.
+ *
+ * Opening a snapshot only checks its header and table directory, and pages of the file are
+ * read by the system as they are first touched, so the cost of opening a snapshot doesn't
+ * depend on the size of the world it holds. Tools and servers can inspect the bodies, ships
+ * or orbit trees of a saved universe straight from the mapping, and restore() builds an
+ * arena from the mapped pages without reading the file into a buffer first.
+ */
+class MappedSnapshot
+{
+private:
+	/** The start of the mapped file (NULL if no snapshot is open) */
+	const char * mp_data;
+
+	/** The size of the mapped file */
+	size_t m_size;
+
+	/** The open file (a HANDLE on Windows, a file descriptor elsewhere) */
+	void * mp_file;
+
+	/** The file's mapping object (only used on Windows) */
+	void * mp_mapping;
+
+	/** Disabled, as the snapshot owns its mapping */
+	MappedSnapshot(const MappedSnapshot & copy);
+
+	/** Disabled, as the snapshot owns its mapping */
+	MappedSnapshot & operator=(const MappedSnapshot & copy);
+
+public:
+	/** Constructs a MappedSnapshot with no snapshot open */
+	MappedSnapshot();
+
+	/** Closes the snapshot, if one is open */
+	~MappedSnapshot();
+
+	/**
+	 * Maps the named save into memory (closing any snapshot already open)
+	 * @return True if the file was mapped, and is a valid save of this version
+	 */
+	bool open(const std::string & fileName);
+
+	/** Unmaps the snapshot (records read from it are no longer valid) */
+	void close();
+
+	/** @return True if a snapshot is open */
+	bool isOpen() const;
+
+	/** @return The start of the mapped save (NULL if no snapshot is open) */
+	const char * data() const;
+
+	/** @return The size of the mapped save */
+	size_t size() const;
+
+	/** @return The arena's settings and simulation state (NULL if no snapshot is open) */
+	const ArenaRecord * arena() const;
+
+	/**
+	 * @return The first record of the passed table, in place in the mapping (NULL if the
+	 *         snapshot has no such table), with the number of records stored in count.
+	 *         T must be the record type of the table (see ArenaTable).
+	 */
+	template<class T>
+	const T * table(ArenaTable table, unsigned int & count) const
+	{
+		if(mp_data == NULL) {
+			count = 0;
+			return NULL;
+		}
+		return reinterpret_cast<const T *>(ArenaSerializer::findTable(mp_data, table, count));
+	}
+
+	/** Restores the snapshot into the passed arena @see ArenaSerializer::load() */
+	bool restore(GameArena & arena) const;
+};
+
+#endif
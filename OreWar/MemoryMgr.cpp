@@ -55,6 +55,35 @@ void PagedMemoryPool::addPage()
 	m_records.push_back(std::vector<MemoryRecord>());
 }
 
+int PagedMemoryPool::pageIndex(const char * address) const
+{
+	for(unsigned int i = 0; i < mp_pages.size(); i++) {
+		if(address >= mp_pages[i] && address < mp_pages[i] + m_pageSize) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int PagedMemoryPool::findRecord(int pageIndex, const char * address) const
+{
+	// Records are stored in order of ascending starting address
+	const std::vector<MemoryRecord> & records = m_records[pageIndex];
+	int low = 0;
+	int high = records.size() - 1;
+	while(low <= high) {
+		int middle = (low + high) / 2;
+		if(records[middle].startAddress() < address) {
+			low = middle + 1;
+		} else if(records[middle].startAddress() > address) {
+			high = middle - 1;
+		} else {
+			return middle;
+		}
+	}
+	return -1;
+}
+
 int PagedMemoryPool::numPages() const 
 {
 	return mp_pages.size();
@@ -73,4 +102,4 @@ int PagedMemoryPool::allocatedBytes() const
 int PagedMemoryPool::totalBytes() const
 {
 	return m_pageSize * mp_pages.size();
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -71,6 +71,12 @@ private:
 	/** Allocates a new empty page from memory */
 	void addPage();
 
+	/** @return The index of the page containing the passed address, or -1 if it is not in a page */
+	int pageIndex(const char * address) const;
+
+	/** @return The index of the record starting at the passed address in the page, or -1 if there is none */
+	int findRecord(int pageIndex, const char * address) const;
+
 	/** Adds a memory record to the saved list, ensuring ascending order of
 	 * address is maintained. */
 	template <class T>
@@ -139,12 +145,14 @@ public:
 			int freeSpace = 0;
 
 			char * curByte = mp_pages[pageIndex];
-			
-			// TODO: Activating this optimization breaks everything...
-			// figure out why
 
+			// Resume from the end of the last allocation, but only if it was made in this
+			// page and left space after it (starting from another page's address would
+			// overrun this one)
 			if(firstAllocation) {
-				curByte = mp_nextByte;
+				if(mp_nextByte >= mp_pages[pageIndex] && mp_nextByte < mp_pages[pageIndex] + m_pageSize) {
+					curByte = mp_nextByte;
+				}
 				firstAllocation = false;
 			}
 			
@@ -170,14 +178,15 @@ public:
 			}
 
 			if(recordsProcessed == 0) {
-				// Page must be empty
-				return addMemoryRecord(object, requiredSpace, curByte, pageIndex);
+				// Page must be empty, so the whole page is free (the resume position may be
+				// too close to its end to fit the object)
+				return addMemoryRecord(object, requiredSpace, mp_pages[pageIndex], pageIndex);
 			}
 
 			// Check for remaining space at the end of the page
 			int byteOffset = (curByte - ((char *)mp_pages[pageIndex]));
 			int remainingSpace = (m_pageSize - byteOffset);
-			if(remainingSpace > requiredSpace) {
+			if(remainingSpace >= requiredSpace) {
 				return addMemoryRecord(object, requiredSpace, curByte, pageIndex);
 			}
 
@@ -196,33 +205,48 @@ public:
 
 	/**
 	 * If the passed pointer is found in the record of allocated blocks
-	 * the memory is deallocated and available for reuse.
-	 * // TODO: Have to find a better way to store the records
+	 * the memory is deallocated and available for reuse. The block's page
+	 * is found from its address, and the page's records are binary searched.
 	 * @return True if the block was found and deallocated, false if no
 	 * record could be found.
 	 */
 	template <class T>
 	inline bool destroyObject(T * object)
 	{
-		for(std::vector<std::vector<MemoryRecord>>::iterator recordIter = m_records.begin(); 
-			recordIter != m_records.end();
-			recordIter++)
+		int page = pageIndex((char *)object);
+		if(page < 0) {
+			return false;
+		}
+
+		int record = findRecord(page, (char *)object);
+		if(record < 0) {
+			return false;
+		}
+
+		object->~T();
+		m_allocatedBytes -= m_records[page][record].size();
+		m_records[page].erase(m_records[page].begin() + record);
+		return true;
+	}
+
+	/**
+	 * Deallocates every object in the passed list (as destroyObject())
+	 * @return The number of objects which were found and deallocated
+	 */
+	template <class T>
+	inline int destroyObjects(const std::vector<T *>& objects)
+	{
+		int destroyed = 0;
+		for(typename std::vector<T *>::const_iterator objectIter = objects.begin(); 
+			objectIter != objects.end();
+			objectIter++)
 		{
-			for(std::vector<MemoryRecord>::iterator innerRecordIter = (*recordIter).begin(); 
-				innerRecordIter != (*recordIter).end();
-				innerRecordIter++)
-			{
-				if((char *)object == (*innerRecordIter).startAddress()) {
-					object->~T();
-					m_allocatedBytes -= (*innerRecordIter).size();
-					(*recordIter).erase(innerRecordIter);
-					return true;
-				}
+			if(destroyObject(*objectIter)) {
+				destroyed++;
 			}
 		}
-
-		return false;
+		return destroyed;
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+#ifndef __ObjectPool_h_
+#define __ObjectPool_h_
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <new>
+
+/**
+ * Identifies an object in an ObjectPool. The low 32 bits hold the object's slot, and the
+ * high 32 bits the generation of the slot when the object was stored, so an id is never
+ * mistaken for a later object stored in the same slot.
+ */
+typedef unsigned long long PoolId;
+
+/** The id of no object */
+const PoolId NULL_POOL_ID = 0xFFFFFFFFFFFFFFFFULL;
+
+/**
+ * The ObjectPool class stores objects of a single type by value, in fixed size chunks
+ * of contiguous slots. Objects never move once stored, so pointers to them stay valid
+ * until they are destroyed. Freed slots are reused lowest first, so new objects fill the
+ * holes left by destroyed ones before the pool grows, and a pass over the slots below
+ * capacity() visits every live object in memory order (skipping any freed slots).
+ */
+template <class T, int CHUNK_SIZE = 256>
+class ObjectPool
+{
+private:
+	/** The allocated chunks, each holding CHUNK_SIZE slots */
+	std::vector<T *> mp_chunks;
+
+	/** The generation of each slot (incremented whenever the slot is freed) */
+	std::vector<unsigned int> m_generations;
+
+	/** True for each slot which holds an object */
+	std::vector<bool> m_live;
+
+	/** Slots which have been freed, lowest first */
+	std::priority_queue<int, std::vector<int>, std::greater<int> > m_freeSlots;
+
+	/** The number of objects stored */
+	int m_size;
+
+	/** Adds a new, free slot to the end of the pool (allocating a chunk if needed) */
+	int addSlot()
+	{
+		int slot = m_live.size();
+		if(slot % CHUNK_SIZE == 0) {
+			mp_chunks.push_back(static_cast<T *>(::operator new(CHUNK_SIZE * sizeof(T))));
+		}
+		m_generations.push_back(0);
+		m_live.push_back(false);
+		return slot;
+	}
+
+	/** Destroys the object in the passed (live) slot, making the slot available for reuse */
+	void destroySlot(int slot)
+	{
+		at(slot).~T();
+		m_live[slot] = false;
+		m_generations[slot]++;
+		m_freeSlots.push(slot);
+		m_size--;
+	}
+
+	/** Disabled, as the pool owns its objects */
+	ObjectPool(const ObjectPool & copy);
+
+	/** Disabled, as the pool owns its objects */
+	ObjectPool & operator=(const ObjectPool & copy);
+
+public:
+	/** Constructs an empty ObjectPool (chunks are allocated as they are needed) */
+	ObjectPool() : mp_chunks(), m_generations(), m_live(), m_freeSlots(), m_size(0)
+	{
+	}
+
+	/** Destroys all stored objects, and releases the pool's chunks */
+	~ObjectPool()
+	{
+		clear();
+		for(unsigned int i = 0; i < mp_chunks.size(); i++) {
+			::operator delete(mp_chunks[i]);
+		}
+	}
+
+	/**
+	 * Creates a copy of the passed object in the pool
+	 * @return A pointer to the stored copy (its id is stored in id, if it is not NULL)
+	 */
+	T * storeObject(const T & object, PoolId * id = NULL)
+	{
+		int slot;
+		if(!m_freeSlots.empty()) {
+			slot = m_freeSlots.top();
+			m_freeSlots.pop();
+		} else {
+			slot = addSlot();
+		}
+
+		T * newT = new (&at(slot)) T(object);
+		m_live[slot] = true;
+		m_size++;
+		if(id != NULL) {
+			*id = ((PoolId)m_generations[slot] << 32) | (PoolId)slot;
+		}
+		return newT;
+	}
+
+	/**
+	 * Creates a copy of the passed object in the passed slot, growing the pool to reach it
+	 * (the slots passed over are left free). Used to restore a saved pool with the same
+	 * layout, so that passes over the slots visit its objects in the same order.
+	 * @return A pointer to the stored copy (NULL if the slot already holds an object)
+	 */
+	T * storeObjectAt(int slot, const T & object, PoolId * id = NULL)
+	{
+		while(capacity() <= slot) {
+			m_freeSlots.push(addSlot());
+		}
+		if(slot < 0 || m_live[slot]) {
+			return NULL;
+		}
+
+		// Take the slot out of the free list (the slots before it are put back)
+		std::vector<int> skipped;
+		while(m_freeSlots.top() != slot) {
+			skipped.push_back(m_freeSlots.top());
+			m_freeSlots.pop();
+		}
+		m_freeSlots.pop();
+		for(unsigned int i = 0; i < skipped.size(); i++) {
+			m_freeSlots.push(skipped[i]);
+		}
+
+		T * newT = new (&at(slot)) T(object);
+		m_live[slot] = true;
+		m_size++;
+		if(id != NULL) {
+			*id = ((PoolId)m_generations[slot] << 32) | (PoolId)slot;
+		}
+		return newT;
+	}
+
+	/**
+	 * Destroys the object with the passed id, making its slot available for reuse
+	 * @return True if the object was found in the pool and destroyed
+	 */
+	bool destroyObject(PoolId id)
+	{
+		if(get(id) == NULL) {
+			return false;
+		}
+
+		destroySlot((int)(id & 0xFFFFFFFF));
+		return true;
+	}
+
+	/** Destroys all stored objects (the pool's chunks are kept for reuse) */
+	void clear()
+	{
+		for(int slot = 0; slot < capacity(); slot++) {
+			if(m_live[slot]) {
+				destroySlot(slot);
+			}
+		}
+	}
+
+	/** @return The object with the passed id (NULL if it has been destroyed) */
+	T * get(PoolId id)
+	{
+		unsigned int slot = (unsigned int)(id & 0xFFFFFFFF);
+		unsigned int generation = (unsigned int)(id >> 32);
+		if(slot >= m_live.size() || !m_live[slot] || m_generations[slot] != generation) {
+			return NULL;
+		}
+		return &at(slot);
+	}
+
+	/** @return The number of objects stored */
+	int size() const
+	{
+		return m_size;
+	}
+
+	/** @return The number of slots in use or freed (live objects are all in slots below this) */
+	int capacity() const
+	{
+		return m_live.size();
+	}
+
+	/** @return True if the passed slot holds an object */
+	bool live(int slot) const
+	{
+		return m_live[slot];
+	}
+
+	/** @return The object in the passed slot (which must be below capacity()) */
+	T & at(int slot)
+	{
+		return mp_chunks[slot / CHUNK_SIZE][slot % CHUNK_SIZE];
+	}
+};
+
+#endif
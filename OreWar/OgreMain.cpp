@@ -3,9 +3,12 @@
 #include <OgreMath.h>
 #include <sstream>
 #include <vector>
+#include <iterator>
 #include "PhysicsEngine.h"
 #include "GameObjects.h"
 #include "RenderModel.h"
+#include "SimulationThread.h"
+#include "InputRecording.h"
 #include "OgreTextAreaOverlayElement.h"
 #include "OgreFontManager.h"
 #include "Gorilla.h"
@@ -15,15 +18,31 @@ using namespace Ogre;
 class TestFrameListener : public FrameListener
 {
 public:
-	TestFrameListener(OIS::Keyboard *keyboard, OIS::Mouse *mouse, SceneManager *mgr, Camera *cam, RenderWindow * renderWindow)
+	/**
+	 * Constructs the listener and starts the game, recording the player's input (saved to
+	 * last_session.owr on exit), or plays back the named recording if one is passed
+	 */
+	TestFrameListener(OIS::Keyboard *keyboard, OIS::Mouse *mouse, SceneManager *mgr, Camera *cam, RenderWindow * renderWindow,
+		const std::string & replayFile)
         : m_Keyboard(keyboard), m_mouse(mouse), m_rotateNode(mgr->getRootSceneNode()->createChildSceneNode()), m_cam(cam), 
-		m_camHeight(0), m_camOffset(0), m_arena(200000, 2048, 10), m_mgr(mgr),
-		m_thirdPersonCam(false), m_renderModel(m_arena, m_mgr, 2048, 10), mp_vp(cam->getViewport()), mp_fps(NULL), m_timer(0),
-		mp_renderWindow(renderWindow), m_con(NULL), m_camParticle(NULL), m_camNode(NULL), m_camParticleNode(NULL),
+		m_camHeight(0), m_camOffset(0), m_events(4096), m_recording(), m_replaying(!replayFile.empty()),
+		m_recordingInput(false), m_arena(200000, 2048, 10), m_simulation(m_arena, 1.0f / 60), m_mgr(mgr),
+		m_thirdPersonCam(false), m_renderModel(m_mgr, 2048, 10), mp_vp(cam->getViewport()), mp_fps(NULL), m_timer(0),
+		mp_renderWindow(renderWindow), m_camParticle(NULL), m_camNode(NULL), m_camParticleNode(NULL),
 		mp_healthBar(NULL), mp_energyBar(NULL), mp_speedBar(NULL), m_clearReleased(true)
 	{
 		m_cam->setFarClipDistance(0);
-		m_arena.generateSolarSystem();
+		m_arena.addEventChannel(&m_events);
+		m_arena.npcShipTarget(5);
+
+		// A recording is played back on an arena set up exactly as the recorded one was
+		if(m_replaying) {
+			if(!m_recording.load(replayFile) || m_recording.setup() != "game") {
+				throw Exception(42, "Could not load the recording " + replayFile, "TestFrameListener");
+			}
+			m_recording.configure(m_arena);
+		}
+		m_arena.generateGalaxy(Galaxy::DEFAULT_SECTORS_PER_SIDE, Galaxy::DEFAULT_SECTOR_SIZE, Galaxy::DEFAULT_DENSITY);
 
 		// Generate the keyboard testing entity and attach it to the listener's scene node
 		SpaceShip playerShip = SpaceShip(ObjectType::SHIP, 1, Vector3(20000, 40000, 20000), 15, m_arena.memoryManager());
@@ -72,38 +91,50 @@ public:
 		m_camParticle = m_mgr->createParticleSystem("CamStars", "Orewar/CamStarField");
 		m_camParticle->setEmitting(true);
 		m_camParticleNode->attachObject(m_camParticle);
+
+		// The arena is simulated on its own thread from here on
+		if(m_replaying) {
+			m_simulation.replay(&m_recording);
+		} else {
+			// The recording holds the step the simulation will run at
+			m_arena.fixedStep(m_simulation.tickLength());
+			m_recording.begin(m_arena, "game");
+			m_arena.recordInput(&m_recording);
+			m_recordingInput = true;
+		}
+		m_simulation.start();
     }
+
+	~TestFrameListener()
+	{
+		m_simulation.stop();
+		if(m_recordingInput) {
+			m_recording.end(m_arena);
+		}
+		if(!m_replaying) {
+			m_recording.save("last_session.owr");
+		}
+	}
  
     bool frameStarted(const FrameEvent& evt)
     {
 		// Capture the keyboard input
         m_Keyboard->capture();
-		SpaceShip * playerShip = m_arena.playerShip();
-		SphereCollisionObject * playerShipPhys = playerShip->phys();
-
-		// Add random NPC ships to shoot
-		for(int i = 0; i < m_arena.npcShips()->size() - 5; i++) {
-			// Add some NPC ships
-			SpaceShip npcShip = SpaceShip(ObjectType::NPC_SHIP, 1, 
-				Vector3(Math::RangeRandom(20000, 50000),
-				Math::RangeRandom(20000, 50000), 
-				Math::RangeRandom(20000, 50000)),
-				5,
-				m_arena.memoryManager());
-			SphereCollisionObject * npcShipPhysics = npcShip.phys();
-			// npcShip.velocity(Vector3(0, 0, 0));
-			npcShipPhysics->velocity(Vector3(Math::RangeRandom(0, 2000),
-				Math::RangeRandom(0, 2000),
-				Math::RangeRandom(0, 2000)));
-
-			npcShipPhysics->orientation(Vector3(0, 0, -1).getRotationTo(npcShipPhysics->velocity()));
-			m_arena.addNpcShip(npcShip);
-		}
 
-		if(m_Keyboard->isKeyDown(OIS::KC_G)) {
+		// Objects may only be destroyed between arena updates (destruction reorders the
+		// arena's object lists, see GameArena), so the simulation's tick is waited for. The
+		// input recording ends here, as regenerating isn't recorded (and replays can't regenerate).
+		if(m_Keyboard->isKeyDown(OIS::KC_G) && !m_replaying) {
 			if(m_clearReleased) {
+				boost::lock_guard<boost::mutex> lock(m_simulation.arenaMutex());
+				if(m_recordingInput) {
+					m_recording.end(m_arena);
+					m_arena.recordInput(NULL);
+					m_recordingInput = false;
+				}
 				m_arena.clearSolarSystem();
-				m_arena.generateSolarSystem();
+				m_arena.generateGalaxy(Galaxy::DEFAULT_SECTORS_PER_SIDE, Galaxy::DEFAULT_SECTOR_SIZE,
+					Galaxy::DEFAULT_DENSITY);
 				m_clearReleased = false;
 			}
 		} else {
@@ -128,143 +159,78 @@ public:
 			m_camOffset -= 2;
 		}
 
-		// Mouse control
-		m_mouse->capture();
-		playerShipPhys->pitch(Radian(m_mouse->getMouseState().Y.rel * -0.25 * evt.timeSinceLastFrame));
-		playerShipPhys->yaw(Radian(m_mouse->getMouseState().X.rel * -0.25 * evt.timeSinceLastFrame));
-		
-		// Clear all existing forces, and add keyboard forces
-		Real energyDrain = 10;
-		if(m_Keyboard->isKeyDown(OIS::KC_W)) {
-			playerShipPhys->applyTempForce(playerShipPhys->heading() * Real(3000));
-			// playerShip->drainEnergy(energyDrain * evt.timeSinceLastFrame);
-		}
-		if(m_Keyboard->isKeyDown(OIS::KC_S)) {
-			playerShipPhys->applyTempForce(playerShipPhys->heading() * Real(-3000));
-			// playerShip->drainEnergy(energyDrain * evt.timeSinceLastFrame);
-		}
-		if(m_Keyboard->isKeyDown(OIS::KC_A)) {
-			playerShipPhys->applyTempForce((playerShipPhys->orientation() * Quaternion(Degree(90), Vector3::UNIT_Y)) 
-				* Vector3(0, 0, -2000));
-			// playerShip->drainEnergy(energyDrain * evt.timeSinceLastFrame);
-		}
-		if(m_Keyboard->isKeyDown(OIS::KC_D)) {
-			playerShipPhys->applyTempForce((playerShipPhys->orientation() * Quaternion(Degree(-90), Vector3::UNIT_Y)) 
-				* Vector3(0, 0, -2000));
-			// playerShip->drainEnergy(energyDrain * evt.timeSinceLastFrame);
-		}
-
-		if(m_Keyboard->isKeyDown(OIS::KC_Q)) {
-			playerShipPhys->roll(Radian(2 * evt.timeSinceLastFrame));
-		}
-		if(m_Keyboard->isKeyDown(OIS::KC_E)) {
-			playerShipPhys->roll(Radian(-2 * evt.timeSinceLastFrame));
-		}
-
-		if(m_Keyboard->isKeyDown(OIS::KC_LCONTROL)) {
-			playerShipPhys->applyTempForce(playerShipPhys->velocity().normalisedCopy() * (-1) * Vector3(2000, 2000, 2000));
-			// playerShip->drainEnergy(energyDrain * evt.timeSinceLastFrame);
-		}
-
 		if(m_Keyboard->isKeyDown(OIS::KC_C)) {
 			m_thirdPersonCam = !m_thirdPersonCam; 
 		}
 
-		// Generate projectile if required
-		if(m_mouse->getMouseState().buttonDown(OIS::MB_Left)) {
-			m_arena.fireProjectileFromShip(playerShip, 0);
-		}
-
-		if(m_mouse->getMouseState().buttonDown(OIS::MB_Right)) {
-			m_arena.fireProjectileFromShip(playerShip, 1);
-		}
-
-		// Generate constraint - TESTING
-		if(m_Keyboard->isKeyDown(OIS::KC_RCONTROL) || m_Keyboard->isKeyDown(OIS::KC_SPACE))
-		{
-			if(m_con == NULL) 
-			{
-				Projectile * closestAnchor = NULL;
-				for(std::vector<Projectile * >::iterator projIter = m_arena.projectiles()->begin(); 
-					projIter != m_arena.projectiles()->end();
-					projIter++) 
-				{
-					if((*projIter)->type() != ANCHOR_PROJECTILE) {
-						continue;
-					}
-
-					if(closestAnchor == NULL ||
-						(playerShipPhys->position().squaredDistance((*projIter)->phys()->position()) <
-						playerShipPhys->position().squaredDistance(closestAnchor->phys()->position()))) 
-					{
-						closestAnchor = *projIter;
-					}
-				}
+		// Mouse control
+		m_mouse->capture();
 
-				if(closestAnchor != NULL) {
-					closestAnchor->phys()->velocity(Vector3(0, 0, 0));
-					m_con = m_arena.addConstraint(Constraint(playerShip->phys(), 
-						closestAnchor->phys(), false));
-				}
-			}
-		} else {
-			if(m_con != NULL) {
-				PhysicsObject * deadAnchor = m_con->getTarget();
-				m_arena.destroyConstraint(m_con);
-				for(std::vector<Projectile * >::iterator projIter = m_arena.projectiles()->begin(); 
-					projIter != m_arena.projectiles()->end();
-					projIter++) 
-				{
-					if((*projIter)->phys() == deadAnchor) {
-						m_arena.destroyProjectile(*projIter);
-						break;
-					}
-				}
-				m_con = NULL;
-			}
-		}
+		// Hand the frame's controls to the simulation, which applies them on its own tick
+		PlayerInput input;
+		input.pitch = m_mouse->getMouseState().Y.rel * -0.25 * evt.timeSinceLastFrame;
+		input.yaw = m_mouse->getMouseState().X.rel * -0.25 * evt.timeSinceLastFrame;
+		input.thrustForward = m_Keyboard->isKeyDown(OIS::KC_W);
+		input.thrustReverse = m_Keyboard->isKeyDown(OIS::KC_S);
+		input.strafeLeft = m_Keyboard->isKeyDown(OIS::KC_A);
+		input.strafeRight = m_Keyboard->isKeyDown(OIS::KC_D);
+		input.rollLeft = m_Keyboard->isKeyDown(OIS::KC_Q);
+		input.rollRight = m_Keyboard->isKeyDown(OIS::KC_E);
+		input.brake = m_Keyboard->isKeyDown(OIS::KC_LCONTROL);
+		input.firePrimary = m_mouse->getMouseState().buttonDown(OIS::MB_Left);
+		input.fireSecondary = m_mouse->getMouseState().buttonDown(OIS::MB_Right);
+		input.grapple = m_Keyboard->isKeyDown(OIS::KC_RCONTROL) || m_Keyboard->isKeyDown(OIS::KC_SPACE);
+		m_simulation.playerInput(input);
+
+		// Everything below is presented from the latest complete tick
+		const ArenaSnapshot & snapshot = m_simulation.latestSnapshot();
+		const ObjectState * player = snapshot.player();
 
 		// Update FPS counter
 		m_timer += evt.timeSinceLastFrame;
-		if (m_timer > 1.0f / 60.0f) 
+		if (m_timer > 1.0f / 60.0f && player != NULL) 
 		{
 			m_timer = 0;
 			mp_fps->text("FPS: " + Ogre::StringConverter::toString(mp_renderWindow->getLastFPS())
 				// + " - RenderObjects: " + Ogre::StringConverter::toString(m_renderModel.getNumObjects())
-				// + " - Health: " + Ogre::StringConverter::toString(playerShip->health())
+				// + " - Health: " + Ogre::StringConverter::toString(player->health)
 				// + " - ModelMemPages: " + Ogre::StringConverter::toString(m_arena.memoryManager()->numPages())
-				+ " - ModelAllocBytes: " + Ogre::StringConverter::toString(m_arena.memoryManager()->allocatedBytes())
-				+ " - ModelTotalBytes: " + Ogre::StringConverter::toString(m_arena.memoryManager()->totalBytes())
+				+ " - ModelAllocBytes: " + Ogre::StringConverter::toString(snapshot.allocatedBytes())
+				+ " - ModelTotalBytes: " + Ogre::StringConverter::toString(snapshot.totalBytes())
 				// + " - ModelCurPage: " + Ogre::StringConverter::toString(m_arena.memoryManager()->currentPage())
 				// + " - RenderMemPages: " + Ogre::StringConverter::toString(m_renderModel.memoryManager()->numPages())
 				+ " - RenderAllocBytes: " + Ogre::StringConverter::toString(m_renderModel.memoryManager()->allocatedBytes())
 				+ " - RenderTotalBytes: " + Ogre::StringConverter::toString(m_renderModel.memoryManager()->totalBytes())
 				// + " - RenderCurPage: " + Ogre::StringConverter::toString(m_renderModel.memoryManager()->currentPage())
-				+ " - Speed: " + Ogre::StringConverter::toString(playerShipPhys->velocity().length())
-				//+ " - Force: " + Ogre::StringConverter::toString((playerShipPhys->sumForces() + playerShipPhys->sumTempForces()).length())
-				+ " - Normal: <" + Ogre::StringConverter::toString(playerShipPhys->normal().x)
-				+ ", " + Ogre::StringConverter::toString(playerShipPhys->normal().y)
-				+ ", " + Ogre::StringConverter::toString(playerShipPhys->normal().z) + ">");
+				+ " - Detonations: " + Ogre::StringConverter::toString(m_renderModel.eventCount(EVENT_BODY_DETONATED))
+				+ " - EventsDropped: " + Ogre::StringConverter::toString(m_events.dropped())
+				// + " - EventsHighWater: " + Ogre::StringConverter::toString(m_events.highWater())
+				+ " - Speed: " + Ogre::StringConverter::toString(player->velocity.length())
+				+ " - Normal: <" + Ogre::StringConverter::toString(player->normal().x)
+				+ ", " + Ogre::StringConverter::toString(player->normal().y)
+				+ ", " + Ogre::StringConverter::toString(player->normal().z) + ">");
 		}
 
-		// Update UI
-		mp_healthBar->width((mp_vp->getActualWidth() * 0.25) * (playerShip->health() / playerShip->maxHealth()));
-		mp_energyBar->width((mp_vp->getActualWidth() * 0.25) * (playerShip->energy() / playerShip->maxEnergy()));
-		mp_speedBar->width((mp_vp->getActualWidth() * 0.25) * (playerShipPhys->velocity().length() / Real(6000)));
-
-		// Update the position of the physics object and move the scene node
-		m_arena.updatePhysics(evt.timeSinceLastFrame);
-		m_renderModel.updateRenderList(evt.timeSinceLastFrame, m_camNode->getOrientation());
-
-		// Move the camera
-		if(m_thirdPersonCam) {
-			m_camNode->setPosition(playerShipPhys->position() + Vector3(0, 1000, 1000));
-			m_camNode->lookAt(playerShipPhys->position(), Node::TS_WORLD);
-		} else {
-			m_camNode->setPosition(playerShipPhys->position() + playerShipPhys->normal() * 80 - playerShipPhys->heading() * 200);
-			m_camNode->setOrientation(playerShipPhys->orientation());
+		// Take the arena's events, then match the scene to the snapshot
+		m_renderModel.drainEvents(m_events);
+		m_renderModel.updateRenderList(snapshot, evt.timeSinceLastFrame, m_camNode->getOrientation());
+
+		if(player != NULL) {
+			// Update UI
+			mp_healthBar->width((mp_vp->getActualWidth() * 0.25) * (player->health / player->maxHealth));
+			mp_energyBar->width((mp_vp->getActualWidth() * 0.25) * (player->energy / player->maxEnergy));
+			mp_speedBar->width((mp_vp->getActualWidth() * 0.25) * (player->velocity.length() / Real(6000)));
+
+			// Move the camera
+			if(m_thirdPersonCam) {
+				m_camNode->setPosition(player->position + Vector3(0, 1000, 1000));
+				m_camNode->lookAt(player->position, Node::TS_WORLD);
+			} else {
+				m_camNode->setPosition(player->position + player->normal() * 80 - player->heading() * 200);
+				m_camNode->setOrientation(player->orientation);
+			}
+			m_camParticleNode->setPosition(player->position + player->velocity);
 		}
-		m_camParticleNode->setPosition(playerShipPhys->position() + playerShipPhys->velocity());
 
         return !m_Keyboard->isKeyDown(OIS::KC_ESCAPE);
     }
@@ -276,7 +242,19 @@ private:
 	Camera *m_cam;
 	int m_camHeight;
 	int m_camOffset;
+	EventChannel m_events;
+
+	/** The player's input being recorded, or the recording being played back */
+	InputRecording m_recording;
+
+	/** True if a recording is being played back */
+	bool m_replaying;
+
+	/** True while the arena is appending to the recording */
+	bool m_recordingInput;
+
 	GameArena m_arena;
+	SimulationThread m_simulation;
 	bool m_thirdPersonCam;
 
 	SceneManager * m_mgr;
@@ -285,7 +263,6 @@ private:
 	Gorilla::Caption * mp_fps;
 	Real m_timer;
 	RenderWindow * mp_renderWindow;
-	Constraint * m_con;
 	ParticleSystem * m_camParticle;
 	SceneNode * m_camNode;
 	SceneNode * m_camParticleNode;
@@ -300,8 +277,10 @@ private:
 class Application
 {
 public:
-    void go()
+    /** Runs the game (playing back the named input recording, if one is passed) */
+    void go(const std::string & replayFile)
     {
+		mReplayFile = replayFile;
         createRoot();
         defineResources();
         setupRenderSystem();
@@ -328,6 +307,7 @@ private:
 	OIS::Mouse * mMouse;
     OIS::InputManager *mInputManager;
     TestFrameListener *mListener;
+	std::string mReplayFile;
  
     void createRoot()
     {
@@ -450,7 +430,7 @@ private:
 		// Note: Input devices can have only one listener
 		mListener = new TestFrameListener(mKeyboard, mMouse, mRoot->getSceneManager("Default SceneManager"), 
 			mRoot->getSceneManager("Default SceneManager")->getCamera("Camera"),
-			mRoot->getAutoCreatedWindow());
+			mRoot->getAutoCreatedWindow(), mReplayFile);
         mRoot->addFrameListener(mListener);
     }
  
@@ -478,8 +458,23 @@ private:
 			// Create application object
 			Application app;
 
+			// Read the recording to play back, if any (--replay <file>)
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+			std::istringstream commandLine(strCmdLine);
+			std::vector<std::string> args((std::istream_iterator<std::string>(commandLine)),
+				std::istream_iterator<std::string>());
+#else
+			std::vector<std::string> args(argv + 1, argv + argc);
+#endif
+			std::string replayFile;
+			for(int i = 0; i + 1 < (int)args.size(); i++) {
+				if(args[i] == "--replay") {
+					replayFile = args[i + 1];
+				}
+			}
+
 			try {
-				app.go();
+				app.go(replayFile);
 			} catch( Ogre::Exception& e ) {
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
 				MessageBox( NULL, e.getFullDescription().c_str(), "An exception has occured!", MB_OK | MB_ICONERROR | MB_TASKMODAL);
@@ -494,4 +489,4 @@ private:
 
 #ifdef __cplusplus
 	}
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
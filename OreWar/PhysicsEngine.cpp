@@ -1,6 +1,6 @@
 #include "PhysicsEngine.h"
+#include <map>
 #include <OgreMath.h>
-#include <OgrePlane.h>
 
 using namespace Ogre;
 
@@ -8,42 +8,42 @@ using namespace Ogre;
 // BaseObject Implementation
 // ========================================================================
 
-BaseObject::BaseObject(Vector3 position) :
-	m_position(position), m_orientation(Quaternion::IDENTITY)
+BaseObject::BaseObject(Vector3 position) : mp_store(NULL), m_entity(NULL_ENTITY),
+	m_localTransform(position, Quaternion::IDENTITY), m_serial(0)
 {
 }
 
-BaseObject::BaseObject(const BaseObject& copy) : m_position(copy.m_position), 
-	m_orientation(copy.m_orientation)
+BaseObject::BaseObject(const BaseObject& copy) : mp_store(NULL), m_entity(NULL_ENTITY),
+	m_localTransform(copy.transform()), m_serial(0)
 {
 }
 
-BaseObject::BaseObject() : 
-	m_position(0, 0, 0), m_orientation(Radian(1), Vector3(0, 0, 0))
+BaseObject::BaseObject() : mp_store(NULL), m_entity(NULL_ENTITY),
+	m_localTransform(Vector3(0, 0, 0), Quaternion(Radian(1), Vector3(0, 0, 0))), m_serial(0)
 {
 }
 
 void BaseObject::yaw(Radian radians)
 {
 	Quaternion q(Radian(radians), Vector3::UNIT_Y);
-	orientation(m_orientation * q);
+	orientation(orientation() * q);
 }
 
 void BaseObject::roll(Radian radians)
 {
 	Quaternion q(Radian(radians), Vector3::UNIT_Z);
-	orientation(m_orientation * q);
+	orientation(orientation() * q);
 }
 
 void BaseObject::pitch(Radian radians)
 {
 	Quaternion q(Radian(radians), Vector3::UNIT_X);
-	orientation(m_orientation * q);
+	orientation(orientation() * q);
 }
 
 void BaseObject::position(Vector3 position)
 {
-	m_position = position;
+	transform().position = position;
 }
 
 Vector3 BaseObject::displacement(const BaseObject& other) {
@@ -52,112 +52,299 @@ Vector3 BaseObject::displacement(const BaseObject& other) {
 
 Vector3 BaseObject::position() const
 {
-	return m_position;
+	return transform().position;
 }
 
 Vector3 BaseObject::heading() const
 {
-	return m_orientation * Vector3(0, 0, -1);
+	return transform().orientation * Vector3(0, 0, -1);
 }
 
 Vector3 BaseObject::normal() const
 {
-	return m_orientation * Vector3(0, 1, 0);
+	return transform().orientation * Vector3(0, 1, 0);
 }
 
 Quaternion BaseObject::orientation() const 
 {
-	return m_orientation;
+	return transform().orientation;
 }
 
 void BaseObject::orientation(Quaternion orientation) {
-	m_orientation = orientation;
-	m_orientation.normalise();
+	TransformComponent & t = transform();
+	t.orientation = orientation;
+	t.orientation.normalise();
+}
+
+EntityStore * BaseObject::store() const
+{
+	return mp_store;
+}
+
+EntityId BaseObject::entity() const
+{
+	return m_entity;
+}
+
+unsigned long BaseObject::serial() const
+{
+	return m_serial;
+}
+
+void BaseObject::serial(unsigned long serial)
+{
+	m_serial = serial;
+}
+
+TransformComponent & BaseObject::transform()
+{
+	return mp_store == NULL ? m_localTransform : *mp_store->transforms().get(m_entity);
+}
+
+const TransformComponent & BaseObject::transform() const
+{
+	return mp_store == NULL ? m_localTransform : *mp_store->transforms().get(m_entity);
+}
+
+void BaseObject::attach(EntityStore * store, EntityId entity)
+{
+	store->transforms().add(entity, transform());
+	mp_store = store;
+	m_entity = entity;
+}
+
+void BaseObject::detach()
+{
+	if(mp_store == NULL) {
+		return;
+	}
+
+	m_localTransform = transform();
+	mp_store->transforms().remove(m_entity);
+	mp_store = NULL;
+	m_entity = NULL_ENTITY;
 }
 
 
 // ========================================================================
 // PhysicsObject Implementation
 // ========================================================================
+Real PhysicsObject::m_sleepSpeed = 1;
+Real PhysicsObject::m_sleepDelay = 0.5;
+Real PhysicsObject::m_substepTravel = 0.5;
+Real PhysicsObject::m_substepAngle = 0.05;
+int PhysicsObject::m_maxSubsteps = 8;
 
 PhysicsObject::PhysicsObject(Real mass, Vector3 position) :
-	BaseObject(position), m_mass(mass), m_velocity(0, 0, 0),
-	m_acceleration(0, 0, 0), m_force(0, 0, 0), m_tempForce(0, 0, 0)
+	BaseObject(position), m_localPhysics(mass, 0), mp_constraints(NULL)
 {
 }
 
-PhysicsObject::PhysicsObject(Real mass) : BaseObject(), m_mass(mass), 
-	m_velocity(0, 0, 0), m_acceleration(0, 0, 0), m_force(0, 0 ,0), m_tempForce(0, 0, 0)
+PhysicsObject::PhysicsObject(Real mass) : BaseObject(), m_localPhysics(mass, 0), mp_constraints(NULL)
 {
 }
 
 PhysicsObject::PhysicsObject(const PhysicsObject& copy) : BaseObject(copy), 
-	m_mass(copy.m_mass), m_velocity(copy.m_velocity), m_acceleration(copy.m_acceleration),
-	m_force(copy.m_force), m_tempForce(copy.m_tempForce)
+	m_localPhysics(copy.physicsComponent()), mp_constraints(NULL)
 {
 }
 
 Real PhysicsObject::mass() const
 {
-	return m_mass;
+	return physicsComponent().mass;
 }
 
 void PhysicsObject::velocity(Vector3 velocity) 
 {
-	m_velocity = velocity;
+	physicsComponent().velocity = velocity;
+	if(velocity != Vector3::ZERO) {
+		wake();
+	}
 }
 
 void PhysicsObject::acceleration(Vector3 acceleration) 
 {
-	m_acceleration = acceleration;
+	physicsComponent().acceleration = acceleration;
 }
 
 Vector3 PhysicsObject::velocity() const
 {
-	return m_velocity;
+	return physicsComponent().velocity;
 }
 
 Vector3 PhysicsObject::acceleration() const
 {
-	return m_acceleration;
+	return physicsComponent().acceleration;
 }
 
 Vector3 PhysicsObject::sumForces() const
 {
-	return m_force;
+	return physicsComponent().force;
 }
 
 Vector3 PhysicsObject::sumTempForces() const
 {
-	return m_tempForce;
+	return physicsComponent().tempForce;
 }
 
 void PhysicsObject::applyForce(Vector3 force) 
 {
-	m_force = m_force + force;
+	PhysicsComponent & physics = physicsComponent();
+	physics.force = physics.force + force;
+	if(force != Vector3::ZERO) {
+		wake();
+	}
 }
 
 void PhysicsObject::applyTempForce(Vector3 force) 
 {
-	m_tempForce = m_tempForce + force;
+	PhysicsComponent & physics = physicsComponent();
+	physics.tempForce = physics.tempForce + force;
+	if(force != Vector3::ZERO) {
+		wake();
+	}
 }
 
 void PhysicsObject::clearForces() 
 {
-	m_force = Vector3(0, 0, 0);
-	m_tempForce = Vector3(0, 0, 0);
+	PhysicsComponent & physics = physicsComponent();
+	physics.force = Vector3(0, 0, 0);
+	physics.tempForce = Vector3(0, 0, 0);
 }
 
-void PhysicsObject::updatePhysics(Real timeElapsed) 
+bool PhysicsObject::sleeping() const
+{
+	return physicsComponent().asleep;
+}
+
+void PhysicsObject::wake()
+{
+	PhysicsComponent & physics = physicsComponent();
+	physics.asleep = false;
+	physics.idleTime = 0;
+}
+
+bool PhysicsObject::kinematic() const
+{
+	return physicsComponent().kinematic;
+}
+
+void PhysicsObject::kinematic(bool kinematic)
+{
+	physicsComponent().kinematic = kinematic;
+}
+
+PhysicsComponent & PhysicsObject::physicsComponent()
+{
+	return store() == NULL ? m_localPhysics : *store()->physics().get(entity());
+}
+
+const PhysicsComponent & PhysicsObject::physicsComponent() const
+{
+	return store() == NULL ? m_localPhysics : *store()->physics().get(entity());
+}
+
+Constraint * PhysicsObject::constraints() const
+{
+	return mp_constraints;
+}
+
+void PhysicsObject::constraints(Constraint * first)
+{
+	mp_constraints = first;
+}
+
+void PhysicsObject::attach(EntityStore * store, EntityId entity)
+{
+	store->physics().add(entity, physicsComponent());
+	BaseObject::attach(store, entity);
+}
+
+void PhysicsObject::detach()
 {
-	// if(m_mass == 0) {
+	if(store() == NULL) {
+		return;
+	}
+
+	m_localPhysics = physicsComponent();
+	store()->physics().remove(entity());
+	BaseObject::detach();
+}
+
+void PhysicsObject::sleepThreshold(Real speed, Real delay)
+{
+	m_sleepSpeed = speed;
+	m_sleepDelay = delay;
+}
+
+void PhysicsObject::substepThreshold(Real travel, Real angle, int maxSubsteps)
+{
+	m_substepTravel = travel;
+	m_substepAngle = angle;
+	m_maxSubsteps = maxSubsteps > 1 ? maxSubsteps : 1;
+}
+
+Real PhysicsObject::substepTravel()
+{
+	return m_substepTravel;
+}
+
+Real PhysicsObject::substepAngle()
+{
+	return m_substepAngle;
+}
+
+int PhysicsObject::substepCount(Real distance, Real limit)
+{
+	if(limit <= 0 || distance <= limit) {
+		return 1;
+	}
+
+	Real substeps = Math::Ceil(distance / limit);
+	return substeps < m_maxSubsteps ? (int)substeps : m_maxSubsteps;
+}
+
+int PhysicsObject::substeps(const PhysicsComponent & physics, Real timeElapsed)
+{
+	if(physics.asleep || (physics.force + physics.tempForce) == Vector3::ZERO) {
+		return 1;
+	}
+
+	return substepCount(physics.velocity.length() * timeElapsed, physics.radius * m_substepTravel);
+}
+
+void PhysicsObject::integrate(TransformComponent & transform, PhysicsComponent & physics, Real timeElapsed)
+{
+	// if(physics.mass == 0) {
 	// TODO: Throw exception
 	// }
+
+	if(physics.asleep || physics.kinematic) {
+		return;
+	}
 	
-	m_acceleration = (m_force + m_tempForce) / m_mass;
-	m_velocity = m_velocity + (m_acceleration * timeElapsed);
-	position(position() + (m_velocity * timeElapsed));
-	m_tempForce = Vector3(0, 0, 0);
+	Vector3 netForce = physics.force + physics.tempForce;
+	physics.acceleration = netForce / physics.mass;
+	physics.velocity = physics.velocity + (physics.acceleration * timeElapsed);
+	transform.position = transform.position + (physics.velocity * timeElapsed);
+	physics.tempForce = Vector3(0, 0, 0);
+
+	// Put the object to sleep once it has been at rest for long enough
+	if(netForce == Vector3::ZERO && physics.velocity.squaredLength() < Math::Sqr(m_sleepSpeed)) {
+		physics.idleTime += timeElapsed;
+		if(physics.idleTime >= m_sleepDelay) {
+			physics.asleep = true;
+			physics.velocity = Vector3(0, 0, 0);
+			physics.acceleration = Vector3(0, 0, 0);
+		}
+	} else {
+		physics.idleTime = 0;
+	}
+}
+
+void PhysicsObject::updatePhysics(Real timeElapsed) 
+{
+	integrate(transform(), physicsComponent(), timeElapsed);
 }
 
 
@@ -168,14 +355,106 @@ Constraint::Constraint(PhysicsObject * origin, PhysicsObject * target, bool rigi
 	m_origin(origin), m_target(target), 
 	m_distance(origin->displacement(*((BaseObject *)target)).length()),
 	m_rigidSpeed((origin->velocity() - target->velocity()).length()),
-	m_rigid(rigid)
+	m_rigid(rigid), m_arenaIndex(-1), m_dead(false), m_linked(false)
 {
+	mp_next[0] = mp_next[1] = NULL;
+	mp_prev[0] = mp_prev[1] = NULL;
+	m_origin->wake();
+	m_target->wake();
+}
+
+Constraint::Constraint(PhysicsObject * origin, PhysicsObject * target, bool rigid, Real distance, Real rigidSpeed) :
+	m_origin(origin), m_target(target), m_distance(distance), m_rigidSpeed(rigidSpeed),
+	m_rigid(rigid), m_arenaIndex(-1), m_dead(false), m_linked(false)
+{
+	mp_next[0] = mp_next[1] = NULL;
+	mp_prev[0] = mp_prev[1] = NULL;
 }
 
 Constraint::Constraint(const Constraint& copy) :
 	m_origin(copy.m_origin), m_target(copy.m_target), m_distance(copy.m_distance),
-	m_rigidSpeed(copy.m_rigidSpeed), m_rigid(copy.m_rigid)
+	m_rigidSpeed(copy.m_rigidSpeed), m_rigid(copy.m_rigid), m_arenaIndex(-1), m_dead(false),
+	m_linked(false)
+{
+	mp_next[0] = mp_next[1] = NULL;
+	mp_prev[0] = mp_prev[1] = NULL;
+}
+
+int Constraint::arenaIndex() const
+{
+	return m_arenaIndex;
+}
+
+void Constraint::arenaIndex(int index)
+{
+	m_arenaIndex = index;
+}
+
+bool Constraint::dead() const
+{
+	return m_dead;
+}
+
+void Constraint::dead(bool dead)
+{
+	m_dead = dead;
+}
+
+int Constraint::end(const PhysicsObject * object) const
+{
+	return object == m_origin ? 0 : 1;
+}
+
+PhysicsObject * Constraint::endObject(int end) const
 {
+	return end == 0 ? m_origin : m_target;
+}
+
+void Constraint::link()
+{
+	if(m_linked) {
+		return;
+	}
+
+	// Push the constraint onto the front of each object's list
+	for(int i = 0; i < 2; i++) {
+		PhysicsObject * object = endObject(i);
+		Constraint * first = object->constraints();
+		mp_prev[i] = NULL;
+		mp_next[i] = first;
+		if(first != NULL) {
+			first->mp_prev[first->end(object)] = this;
+		}
+		object->constraints(this);
+	}
+	m_linked = true;
+}
+
+void Constraint::unlink()
+{
+	if(!m_linked) {
+		return;
+	}
+
+	for(int i = 0; i < 2; i++) {
+		PhysicsObject * object = endObject(i);
+		if(mp_prev[i] != NULL) {
+			mp_prev[i]->mp_next[mp_prev[i]->end(object)] = mp_next[i];
+		} else {
+			object->constraints(mp_next[i]);
+		}
+		if(mp_next[i] != NULL) {
+			mp_next[i]->mp_prev[mp_next[i]->end(object)] = mp_prev[i];
+		}
+		mp_next[i] = NULL;
+		mp_prev[i] = NULL;
+	}
+	m_linked = false;
+}
+
+Constraint * Constraint::next(const PhysicsObject * object) const
+{
+	return mp_next[end(object)];
 }
 
 PhysicsObject * Constraint::getOrigin()
@@ -188,49 +467,213 @@ PhysicsObject * Constraint::getTarget()
 	return m_target;
 }
 
-void Constraint::applyForces(Real timeElapsed)
+bool Constraint::isRigid() {
+	return m_rigid;
+}
+
+Real Constraint::distance() const
+{
+	return m_distance;
+}
+
+Real Constraint::rigidSpeed() const
+{
+	return m_rigidSpeed;
+}
+
+int Constraint::substeps(Real timeElapsed)
 {
-	if(timeElapsed == 0) {
+	if(m_origin->sleeping() && m_target->sleeping()) {
+		return 1;
+	}
+
+	if(!isRigid() && m_origin->displacement(*((BaseObject *)m_target)).length() < m_distance) {
+		return 1;
+	}
+
+	// The arc swept by the origin in one substep is limited to the substep angle
+	Real arcLength = (m_origin->velocity() - m_target->velocity()).length() * timeElapsed;
+	return PhysicsObject::substepCount(arcLength, m_distance * PhysicsObject::substepAngle());
+}
+
+void Constraint::solvePosition()
+{
+	if(m_origin->sleeping() && m_target->sleeping()) {
 		return;
 	}
-	// Spring based constraint
-	/*
-	Real distance = m_origin->displacement(*m_target).length();
-	Real appliedForce = Math::Pow((distance - m_distance), 2) * 1 + Math::Abs(distance - m_distance) * 3;
-	if(distance < m_distance) {
-		appliedForce = -appliedForce;
+
+	Vector3 offset = m_target->displacement(*m_origin);
+	Real distance = offset.length();
+	if(distance == 0 || (!isRigid() && distance <= m_distance)) {
+		return;
 	}
 
-	m_origin->applyTempForce((m_origin->displacement(*m_target)).normalisedCopy()
-		* appliedForce);
+	m_origin->position(m_target->position() + (offset * (m_distance / distance)));
+	if(m_origin->sleeping()) {
+		m_origin->wake();
+	}
+}
 
-	m_target->applyTempForce((m_target->displacement(*m_origin)).normalisedCopy()
-		* appliedForce);
-	*/
+void Constraint::solveVelocity()
+{
+	if(m_origin->sleeping() && m_target->sleeping()) {
+		return;
+	}
 
-	// Orbit constraint
 	Vector3 normalVector = m_target->displacement(*m_origin);
-	if(isRigid() || normalVector.length() > m_distance) {
-		normalVector.normalise();
-		Plane normalPlane = Plane(normalVector, 0);
-		normalPlane.normalise();
-		Vector3 relVelocity = m_origin->velocity() - m_target->velocity();
-		Vector3 desiredVelocity;
-		if(isRigid()) {
-			m_origin->position(m_target->position() + (m_distance * normalVector));
-			desiredVelocity = (normalPlane.projectVector(relVelocity).normalisedCopy() * m_rigidSpeed) + m_target->velocity();
-		} else {
-			desiredVelocity = (normalPlane.projectVector(relVelocity) + m_target->velocity()).normalisedCopy() * relVelocity.length();
+	Real distance = normalVector.normalise();
+	if(distance == 0) {
+		return;
+	}
+
+	Vector3 relVelocity = m_origin->velocity() - m_target->velocity();
+	Real radialSpeed = relVelocity.dotProduct(normalVector);
+	if(isRigid()) {
+		Vector3 tangent = relVelocity - (normalVector * radialSpeed);
+		if(!tangent.isZeroLength()) {
+			m_origin->velocity(m_target->velocity() + (tangent.normalisedCopy() * m_rigidSpeed));
+		}
+	} else if(radialSpeed > 0 && distance >= m_distance) {
+		m_origin->velocity(m_origin->velocity() - (normalVector * radialSpeed));
+	}
+}
+
+
+// ========================================================================
+// ConstraintSolver Implementation
+// ========================================================================
+
+/** Runs Constraint::solvePosition() over a range of a single colour */
+class SolvePositionTask : public WorkerTask
+{
+private:
+	const std::vector<Constraint *> & m_constraints;
+public:
+	SolvePositionTask(const std::vector<Constraint *> & constraints) : m_constraints(constraints) {}
+
+	virtual void run(int begin, int end)
+	{
+		for(int i = begin; i < end; i++) {
+			m_constraints[i]->solvePosition();
 		}
+	}
+};
+
+/** Runs Constraint::solveVelocity() over a range of a single colour */
+class SolveVelocityTask : public WorkerTask
+{
+private:
+	const std::vector<Constraint *> & m_constraints;
+public:
+	SolveVelocityTask(const std::vector<Constraint *> & constraints) : m_constraints(constraints) {}
 
-		Vector3 velocityOffset = desiredVelocity - m_origin->velocity();
-		m_origin->applyTempForce(((velocityOffset * m_origin->mass()) / timeElapsed));
+	virtual void run(int begin, int end)
+	{
+		for(int i = begin; i < end; i++) {
+			m_constraints[i]->solveVelocity();
+		}
 	}
+};
+
+ConstraintSolver::ConstraintSolver(int iterations, WorkerPool * workers)
+	: m_iterations(iterations), mp_workers(workers), m_colours(), m_dirty(true)
+{
 }
 
+void ConstraintSolver::iterations(int iterations)
+{
+	m_iterations = iterations < 1 ? 1 : iterations;
+}
 
-bool Constraint::isRigid() {
-	return m_rigid;
+int ConstraintSolver::iterations() const
+{
+	return m_iterations;
+}
+
+int ConstraintSolver::numColours() const
+{
+	return m_colours.size();
+}
+
+void ConstraintSolver::invalidate()
+{
+	m_dirty = true;
+}
+
+void ConstraintSolver::colourConstraints(const std::vector<Constraint *>& constraints)
+{
+	// Bitmasks of the colours in which each object is written (as an origin) or read (as a target)
+	std::map<PhysicsObject *, unsigned int> writeColours;
+	std::map<PhysicsObject *, unsigned int> readColours;
+
+	m_colours.clear();
+	m_colours.resize(MAX_COLOURS + 1);
+	int usedColours = 0;
+
+	for(std::vector<Constraint * >::const_iterator conIter = constraints.begin(); 
+		conIter != constraints.end();
+		conIter++)
+	{
+		PhysicsObject * origin = (*conIter)->getOrigin();
+		PhysicsObject * target = (*conIter)->getTarget();
+
+		// An origin can't share a colour with any other use of the same object, but a
+		// target only conflicts with constraints that write it
+		unsigned int blocked = writeColours[origin] | readColours[origin] | writeColours[target];
+		int colour = 0;
+		while(colour < MAX_COLOURS && (blocked & (1u << colour))) {
+			colour++;
+		}
+
+		m_colours[colour].push_back(*conIter);
+		if(colour < MAX_COLOURS) {
+			writeColours[origin] |= (1u << colour);
+			readColours[target] |= (1u << colour);
+			usedColours = colour + 1 > usedColours ? colour + 1 : usedColours;
+		}
+	}
+
+	// Keep the uncoloured group last, dropping any unused colours before it
+	std::vector<Constraint *> uncoloured = m_colours[MAX_COLOURS];
+	m_colours.resize(usedColours);
+	if(!uncoloured.empty()) {
+		m_colours.push_back(uncoloured);
+	}
+
+	m_dirty = false;
+}
+
+void ConstraintSolver::solve(const std::vector<Constraint *>& constraints)
+{
+	if(m_dirty) {
+		colourConstraints(constraints);
+	}
+
+	for(int i = 0; i < m_iterations; i++) {
+		for(std::vector<std::vector<Constraint *>>::iterator colourIter = m_colours.begin(); 
+			colourIter != m_colours.end();
+			colourIter++)
+		{
+			SolvePositionTask task(*colourIter);
+			if(mp_workers != NULL && colourIter - m_colours.begin() < MAX_COLOURS) {
+				mp_workers->parallelFor(task, colourIter->size(), 64);
+			} else {
+				task.run(0, colourIter->size());
+			}
+		}
+	}
+
+	for(std::vector<std::vector<Constraint *>>::iterator colourIter = m_colours.begin(); 
+		colourIter != m_colours.end();
+		colourIter++)
+	{
+		SolveVelocityTask task(*colourIter);
+		if(mp_workers != NULL && colourIter - m_colours.begin() < MAX_COLOURS) {
+			mp_workers->parallelFor(task, colourIter->size(), 64);
+		} else {
+			task.run(0, colourIter->size());
+		}
+	}
 }
 
 
@@ -239,26 +682,73 @@ bool Constraint::isRigid() {
 // ========================================================================
 
 SphereCollisionObject::SphereCollisionObject(Real radius, Real mass, Vector3 position)
-	: PhysicsObject(mass, position), m_radius(radius)
+	: PhysicsObject(mass, position)
 {
+	physicsComponent().radius = radius;
 }
 
 SphereCollisionObject::SphereCollisionObject(Real radius, Real mass)
-	: PhysicsObject(mass), m_radius(radius)
+	: PhysicsObject(mass)
 {
+	physicsComponent().radius = radius;
 }
 
 SphereCollisionObject::SphereCollisionObject(const SphereCollisionObject& copy)
-	: PhysicsObject(copy), m_radius(copy.m_radius)
+	: PhysicsObject(copy)
 {
 }
 
 Real SphereCollisionObject::radius() const
 {
-	return m_radius;
+	return physicsComponent().radius;
+}
+
+int SphereCollisionObject::substeps(Real timeElapsed) const
+{
+	return PhysicsObject::substeps(physicsComponent(), timeElapsed);
 }
 
 bool SphereCollisionObject::checkCollision(const SphereCollisionObject& object) const
 { 
 	return position().squaredDistance(object.position()) <= Math::Pow(radius() + object.radius(), 2);
-}
\ No newline at end of file
+}
+
+bool SphereCollisionObject::sweptCollision(const SphereCollisionObject& object, Real timeElapsed) const
+{
+	// Find the time in the update at which the spheres were closest (stepping the relative
+	// position back in time), and test their separation then
+	Vector3 relPosition = position() - object.position();
+	Vector3 relVelocity = velocity() - object.velocity();
+	Real a = relVelocity.squaredLength();
+	Real closest = 0;
+	if(a > 0) {
+		closest = relPosition.dotProduct(relVelocity) / a;
+		closest = closest < 0 ? 0 : (closest > timeElapsed ? timeElapsed : closest);
+	}
+	return (relPosition - relVelocity * closest).squaredLength() <= Math::Sqr(radius() + object.radius());
+}
+
+Real SphereCollisionObject::contactAge(const SphereCollisionObject& object, Real timeElapsed) const
+{
+	// Step the relative position back in time, and find the larger root of
+	// |d - v * t| = r (the last time the spheres were apart)
+	Vector3 relPosition = position() - object.position();
+	Vector3 relVelocity = velocity() - object.velocity();
+	Real a = relVelocity.squaredLength();
+	if(a <= 0) {
+		return timeElapsed;
+	}
+
+	Real b = relPosition.dotProduct(relVelocity);
+	Real c = relPosition.squaredLength() - Math::Sqr(radius() + object.radius());
+	Real discriminant = b * b - a * c;
+	if(discriminant < 0) {
+		return 0;
+	}
+
+	Real age = (b + Math::Sqrt(discriminant)) / a;
+	if(age < 0) {
+		return 0;
+	}
+	return age < timeElapsed ? age : timeElapsed;
+}
@@ -4,9 +4,13 @@
 #include <vector>
 #include <OgreVector3.h>
 #include <OgreQuaternion.h>
+#include "WorkerPool.h"
+#include "EntityStore.h"
 
 using namespace Ogre;
 
+class Constraint;
+
 /**
  * The BaseObject class represents an entity in the OreWar game world.
  * BaseObjects use an X, Y, Z coordinate system following Ogre's axis conventions.
@@ -14,15 +18,28 @@ using namespace Ogre;
  * The coordinate system is centered with 0,0,0 in the exact center of the game
  * world. Orientation is stored as a quaternion with <0, 0, -1> as the base
  * heading (to correspond with the default for Ogre cameras, scene nodes, etc.)
+ *
+ * Once attached to an EntityStore, the object is a facade over its entity's components,
+ * and all of its state is read from and written to the store. Detached objects (and
+ * copies, which are always detached) hold their state themselves.
  */
 class BaseObject
 {
 private:
-	/** The current position of the object */
-	Vector3 m_position;
+	/** The store holding the object's components (NULL while the object is detached) */
+	EntityStore * mp_store;
+
+	/** The object's entity in the store (NULL_ENTITY while the object is detached) */
+	EntityId m_entity;
 
-	/** The current orientation of the object (as a rotation from the base <0, 0, -1> heading) */
-	Quaternion m_orientation;
+	/** The object's position and orientation while it is detached */
+	TransformComponent m_localTransform;
+
+	/** 
+	 * A number identifying the object for as long as its GameArena exists (0 if it has
+	 * never been added to one, and never copied)
+	 */
+	unsigned long m_serial;
 
 public:
 	/** Construct a new BaseObject at a specified position with default heading (<0, 0,-1>) */
@@ -63,6 +80,30 @@ public:
 
 	/** Sets the orientation of the object */
 	void orientation(Quaternion orientation);
+
+	/** @return The store holding the object's components (NULL if the object is detached) */
+	EntityStore * store() const;
+
+	/** @return The object's entity (NULL_ENTITY if the object is detached) */
+	EntityId entity() const;
+
+	/** @return The number identifying the object in its GameArena (0 if it has never been added to one) */
+	unsigned long serial() const;
+
+	/** Sets the number identifying the object in its GameArena (only used by the GameArena) */
+	void serial(unsigned long serial);
+
+	/** @return The object's transform component (in its store, or held locally while detached) */
+	TransformComponent & transform();
+
+	/** @return The object's transform component (in its store, or held locally while detached) */
+	const TransformComponent & transform() const;
+
+	/** Moves the object's state into new components of the passed entity */
+	virtual void attach(EntityStore * store, EntityId entity);
+
+	/** Moves the object's state out of its store (the entity itself is left to the caller) */
+	virtual void detach();
 };
 
 
@@ -76,23 +117,29 @@ public:
 class PhysicsObject : public BaseObject
 {
 private:
-	/** The mass of the object */
-	Real m_mass;
+	/** 
+	 * The object's mass, velocity, forces and sleep state while it is detached.
+	 * Temporary forces are cleared on each physics update.
+	 */
+	PhysicsComponent m_localPhysics;
 
-	/** The velocity of the object */
-	Vector3 m_velocity;
+	/** The first constraint attached to the object (NULL if there are none, never copied) */
+	Constraint * mp_constraints;
 
-	/** The acceleration of the object */
-	Vector3 m_acceleration;
+	/** Objects moving slower than this speed (with no applied force) are considered idle */
+	static Real m_sleepSpeed;
 
-	/** The sum vector of all persistent forces current applied on the object. */
-	Vector3 m_force;
+	/** The amount of time an object must be idle before it is put to sleep */
+	static Real m_sleepDelay;
 
-	/** 
-	 * The sum vector of all temporary forces currently applied on the object.
-	 * Temporary forces are cleared on each physics update.
-	 */
-	Vector3 m_tempForce;
+	/** The distance (as a fraction of its radius) an accelerating object may travel in one substep */
+	static Real m_substepTravel;
+
+	/** The angle (in radians) a constrained object may swing around its target in one substep */
+	static Real m_substepAngle;
+
+	/** The maximum number of substeps any object is split into */
+	static int m_maxSubsteps;
 
 public:
 	/** 
@@ -113,7 +160,7 @@ public:
 	/** @return The mass of the object */
 	Real mass() const;
 
-	/** Sets the velocity of the object */
+	/** Sets the velocity of the object (a non-zero velocity wakes the object) */
 	void velocity(Vector3 velocity);
 
 	/** Sets the acceleration of the object */
@@ -133,23 +180,93 @@ public:
 
 	/** 
 	 * Applies an addititve force on the object which will be taken into account
-	 * on the next physics update.
+	 * on the next physics update. A non-zero force wakes the object.
 	 */
 	void applyForce(Vector3 force);
 
 	/** 
 	 * Applies an addititve force on the object which will be taken into account
-	 * and cleared on the next physics update.
+	 * and cleared on the next physics update. A non-zero force wakes the object.
 	 */
 	void applyTempForce(Vector3 force);
 
 	/** Remove all forces (temporary and persistent) all force currently applied to the object */
 	void clearForces();
 
+	/** @return True if the object is asleep (at rest and skipped by physics updates) */
+	bool sleeping() const;
+
+	/** Wakes the object, resetting its idle timer */
+	void wake();
+
+	/** @return True if the object is moved by another system, and is never integrated */
+	bool kinematic() const;
+
+	/** Sets whether the object is moved by another system, and is never integrated */
+	void kinematic(bool kinematic);
+
+	/** @return The object's physics component (in its store, or held locally while detached) */
+	PhysicsComponent & physicsComponent();
+
+	/** @return The object's physics component (in its store, or held locally while detached) */
+	const PhysicsComponent & physicsComponent() const;
+
+	/** 
+	 * @return The first constraint attached to the object as either origin or target (NULL
+	 * if there are none). The rest are reached through Constraint::next().
+	 */
+	Constraint * constraints() const;
+
+	/** Sets the first constraint attached to the object (only used by Constraint) */
+	void constraints(Constraint * first);
+
+	/** @see BaseObject::attach() */
+	virtual void attach(EntityStore * store, EntityId entity);
+
+	/** @see BaseObject::detach() */
+	virtual void detach();
+
+	/**
+	 * Sets the speed below which force free objects are considered idle, and the
+	 * amount of idle time (in seconds) after which they are put to sleep.
+	 */
+	static void sleepThreshold(Real speed, Real delay);
+
+	/**
+	 * Sets how finely updates are split into substeps: the fraction of its radius an
+	 * accelerating object may travel, and the angle (in radians) a constrained object may
+	 * swing around its target, in one substep. No update is split into more than maxSubsteps.
+	 */
+	static void substepThreshold(Real travel, Real angle, int maxSubsteps);
+
+	/** @return The fraction of its radius an accelerating object may travel in one substep */
+	static Real substepTravel();
+
+	/** @return The angle (in radians) a constrained object may swing around its target in one substep */
+	static Real substepAngle();
+
+	/** @return The number of substeps needed to cover distance in steps no longer than limit */
+	static int substepCount(Real distance, Real limit);
+
+	/**
+	 * @return The number of substeps the passed components' next update should be split
+	 * into, based on how far they travel relative to their radius. Components with no
+	 * applied force move in a straight line (which a single step integrates exactly),
+	 * so only need one.
+	 */
+	static int substeps(const PhysicsComponent & physics, Real timeElapsed);
+
+	/**
+	 * Integrates the passed components over the elapsed time (in seconds). Sleeping and
+	 * kinematic components are not updated. This is the physics system's update for a
+	 * single entity, and is shared by every PhysicsObject.
+	 */
+	static void integrate(TransformComponent & transform, PhysicsComponent & physics, Real timeElapsed);
+
 	/**
 	 * Updates the object's position, taking all physics parameters into
 	 * account as well as the time elapsed since the last position update
-	 * (in seconds).
+	 * (in seconds). Sleeping objects are not updated.
 	 */
 	virtual void updatePhysics(Real timeElapsed);
 };
@@ -177,10 +294,38 @@ private:
 	/** If set to true, the constaint will try to maintain orbit velocity at all costs */
 	bool m_rigid;
 
+	/** The constraint's position in its GameArena constraint list (-1 if it is not in one) */
+	int m_arenaIndex;
+
+	/** True if the constraint has been killed, and will be destroyed at the end of the update */
+	bool m_dead;
+
+	/** 
+	 * The next and previous constraints attached to each end of the constraint (index 0 for
+	 * the origin and 1 for the target), forming a list of the constraints on each object.
+	 */
+	Constraint * mp_next[2];
+	Constraint * mp_prev[2];
+
+	/** True while the constraint is in its objects' constraint lists */
+	bool m_linked;
+
+	/** @return The end of the constraint (0 for the origin, 1 for the target) attached to the object */
+	int end(const PhysicsObject * object) const;
+
+	/** @return The object attached to the passed end of the constraint */
+	PhysicsObject * endObject(int end) const;
+
 public:
-	/** Construct a constraint between the two provided objects */
+	/** Construct a constraint between the two provided objects (waking both) */
 	Constraint(PhysicsObject * origin, PhysicsObject * target, bool rigid);
 
+	/**
+	 * Construct a constraint between the two provided objects with the passed distance and
+	 * relative speed (used to restore a saved constraint, so neither object is woken)
+	 */
+	Constraint(PhysicsObject * origin, PhysicsObject * target, bool rigid, Real distance, Real rigidSpeed);
+
 	/** Copy constructor */
 	Constraint(const Constraint& copy);
 
@@ -190,11 +335,110 @@ public:
 	/** @return The target object of the constraint */
 	PhysicsObject * getTarget();
 
-	/** Applies temporary forces on one or both of the constraint objects based on the elapsed time */
-	void applyForces(Real timeElapsed);
+	/** @return The constraint's position in its GameArena constraint list (-1 if it is not in one) */
+	int arenaIndex() const;
+
+	/** Sets the constraint's position in its GameArena constraint list (only used by the GameArena) */
+	void arenaIndex(int index);
+
+	/** @return True if the constraint has been killed, and will be destroyed at the end of the update */
+	bool dead() const;
+
+	/** Marks the constraint as killed (only used by the GameArena) */
+	void dead(bool dead);
+
+	/** 
+	 * Adds the constraint to the constraint lists of both its objects (only used by the
+	 * GameArena, copies are never linked)
+	 */
+	void link();
+
+	/** Removes the constraint from its objects' constraint lists (if it is in them) */
+	void unlink();
+
+	/** @return The next constraint attached to the passed object (one of this constraint's objects) */
+	Constraint * next(const PhysicsObject * object) const;
 
 	/** @return True if the constraint is rigid (resists compression) */
 	bool isRigid();
+
+	/** @return The distance between the two objects at the time of creation */
+	Real distance() const;
+
+	/** @return The relative speed maintained by a rigid constraint */
+	Real rigidSpeed() const;
+
+	/**
+	 * @return The number of substeps the origin should be split into over the passed time,
+	 * so that it swings through a limited angle around the target between projections.
+	 * Slack ropes don't constrain the origin, and need no substeps.
+	 */
+	int substeps(Real timeElapsed);
+
+	/**
+	 * Projects the origin object's position so that the constraint is satisfied (at the
+	 * constraint distance for rigid constraints, within it otherwise). The target is
+	 * treated as immovable, so only the origin object is written.
+	 */
+	void solvePosition();
+
+	/**
+	 * Removes the component of the origin's velocity (relative to the target) which would
+	 * violate the constraint. Rigid constraints also restore the stored relative speed.
+	 * Only the origin object is written.
+	 */
+	void solveVelocity();
+};
+
+
+/**
+ * The ConstraintSolver class satisfies a set of constraints by iterative position
+ * projection (position based dynamics). Constraints are partitioned by graph colouring
+ * so that no two constraints of the same colour write an object the other reads, which
+ * allows each colour to be solved in parallel on a WorkerPool.
+ */
+class ConstraintSolver
+{
+private:
+	/** The number of position projection passes performed per solve */
+	int m_iterations;
+
+	/** The worker pool used to solve colours in parallel (NULL to solve serially) */
+	WorkerPool * mp_workers;
+
+	/** 
+	 * The constraints grouped by colour. The last group holds any constraints which
+	 * could not be coloured, and is always solved serially.
+	 */
+	std::vector<std::vector<Constraint *>> m_colours;
+
+	/** True if the constraint set has changed since the last colouring */
+	bool m_dirty;
+
+	/** Greedily partitions the passed constraints into independent colours */
+	void colourConstraints(const std::vector<Constraint *>& constraints);
+
+public:
+	/** The maximum number of colours solved in parallel */
+	static const int MAX_COLOURS = 32;
+
+	/** Constructs a solver performing the specified iterations, using the passed workers */
+	ConstraintSolver(int iterations, WorkerPool * workers);
+
+	/** Sets the number of position projection passes performed per solve */
+	void iterations(int iterations);
+
+	/** @return The number of position projection passes performed per solve */
+	int iterations() const;
+
+	/** @return The number of colours in the current partitioning */
+	int numColours() const;
+
+	/** Flags the constraint set as changed, so colours are recomputed on the next solve */
+	void invalidate();
+
+	/** Solves the passed constraints (which must not change between calls without invalidate()) */
+	void solve(const std::vector<Constraint *>& constraints);
 };
 
 
@@ -204,9 +448,6 @@ public:
  */
 class SphereCollisionObject : public PhysicsObject
 {
-private:
-	/** The radius of the object */
-	Real m_radius;
 public:
 	/** 
 	 * Construct a SphereCollisionObject at the given position coordinates with the
@@ -226,8 +467,30 @@ public:
 	/** @return The radius of the object */
 	Real radius() const;
 
+	/**
+	 * @return The number of substeps the object's next update should be split into, based on
+	 * how far it travels relative to its radius. Objects with no applied force move in a
+	 * straight line (which a single step integrates exactly), so only need one.
+	 */
+	int substeps(Real timeElapsed) const;
+
 	/** @return True if the passed object intersects with the sphere */
 	bool checkCollision(const SphereCollisionObject& object) const;
+
+	/**
+	 * @return True if the passed object intersected with the sphere at any time during the
+	 * last update of the passed length, with both moving in a straight line at their current
+	 * velocities. Unlike checkCollision(), this catches fast objects which passed through the
+	 * sphere within the update.
+	 */
+	bool sweptCollision(const SphereCollisionObject& object, Real timeElapsed) const;
+
+	/**
+	 * Estimates how long ago the passed (intersecting) object first touched the sphere,
+	 * assuming both moved in straight lines at their current velocities.
+	 * @return The time in the range [0, timeElapsed] since the objects first touched
+	 */
+	Real contactAge(const SphereCollisionObject& object, Real timeElapsed) const;
 };
 
-#endif
\ No newline at end of file
+#endif
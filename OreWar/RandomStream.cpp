@@ -0,0 +1,64 @@
+#include "RandomStream.h"
+
+// ========================================================================
+// RandomStream Implementation
+// ========================================================================
+RandomStream::RandomStream(unsigned long long seed, unsigned int stream)
+	: m_state(1)
+{
+	this->seed(seed, stream);
+}
+
+RandomStream::RandomStream(const RandomStream& copy)
+	: m_state(copy.m_state)
+{
+}
+
+void RandomStream::seed(unsigned long long seed, unsigned int stream)
+{
+	// Scramble the seed and stream together (splitmix64), so that similar seeds
+	// still produce unrelated streams
+	unsigned long long z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z = z ^ (z >> 31);
+
+	m_state = z != 0 ? z : 0x9E3779B97F4A7C15ULL;
+}
+
+unsigned long long RandomStream::state() const
+{
+	return m_state;
+}
+
+void RandomStream::state(unsigned long long state)
+{
+	m_state = state != 0 ? state : 0x9E3779B97F4A7C15ULL;
+}
+
+unsigned int RandomStream::next()
+{
+	m_state ^= m_state >> 12;
+	m_state ^= m_state << 25;
+	m_state ^= m_state >> 27;
+	return (unsigned int)((m_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+Real RandomStream::unitRandom()
+{
+	return Real(next() / 4294967295.0);
+}
+
+Real RandomStream::rangeRandom(Real low, Real high)
+{
+	return low + (high - low) * unitRandom();
+}
+
+int RandomStream::randomInt(int range)
+{
+	if(range <= 0) {
+		return 0;
+	}
+
+	return (int)(next() % (unsigned int)range);
+}
@@ -0,0 +1,52 @@
+#ifndef __RandomStream_h_
+#define __RandomStream_h_
+
+#include <OgrePrerequisites.h>
+
+using namespace Ogre;
+
+/**
+ * The RandomStream class is a small, self contained pseudo random number generator
+ * (xorshift64*). Unlike rand() or Ogre::Math::UnitRandom(), every stream has its own
+ * state, so a GameArena seeded with the same value always produces the same sequence
+ * no matter what else in the process consumes random numbers.
+ */
+class RandomStream
+{
+private:
+	/** The current generator state (never zero) */
+	unsigned long long m_state;
+
+public:
+	/** Constructs a stream from the specified seed and stream identifier */
+	RandomStream(unsigned long long seed, unsigned int stream);
+
+	/** Copy constructor (the copy continues the same sequence) */
+	RandomStream(const RandomStream& copy);
+
+	/**
+	 * Reseeds the stream. Streams sharing a seed but with different stream identifiers
+	 * produce unrelated sequences.
+	 */
+	void seed(unsigned long long seed, unsigned int stream);
+
+	/** @return The current generator state (restoring it with state() continues the same sequence) */
+	unsigned long long state() const;
+
+	/** Sets the generator state, as returned by state() (a zero state is replaced by a valid one) */
+	void state(unsigned long long state);
+
+	/** @return The next 32 random bits from the stream */
+	unsigned int next();
+
+	/** @return A random real in the range [0, 1] */
+	Real unitRandom();
+
+	/** @return A random real in the range [low, high] */
+	Real rangeRandom(Real low, Real high);
+
+	/** @return A random integer in the range [0, range) (0 if range is not positive) */
+	int randomInt(int range);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "RenderModel.h"
 #include <OgreMatrix4.h>
+#include <algorithm>
 
 using namespace Ogre;
 
@@ -36,20 +37,25 @@ bool RenderObject::operator==(const RenderObject &other) const
 // ========================================================================
 bool ConstraintRenderObject::m_resourcesLoaded = false;
 
-ConstraintRenderObject::ConstraintRenderObject(Constraint * constraint, SceneManager * mgr)
-	: RenderObject(mgr), mp_constraint(constraint), mp_node(), mp_particle(NULL)
+ConstraintRenderObject::ConstraintRenderObject(const ConstraintState & state, SceneManager * mgr)
+	: RenderObject(mgr), m_state(state), mp_node(), mp_particle(NULL)
 {
 }
 
-Constraint * ConstraintRenderObject::constraint()
+const ConstraintState & ConstraintRenderObject::state() const
 {
-	return mp_constraint;
+	return m_state;
+}
+
+void ConstraintRenderObject::state(const ConstraintState & state)
+{
+	m_state = state;
 }
 
 void ConstraintRenderObject::updateEffects(Real elapsedTime, Quaternion camOrientation)
 {
-	Vector3 offset = mp_constraint->getTarget()->position() - mp_constraint->getOrigin()->position();
-	mp_node->setPosition(mp_constraint->getOrigin()->position() + (offset * Real(0.5)));
+	Vector3 offset = m_state.target - m_state.origin;
+	mp_node->setPosition(m_state.origin + (offset * Real(0.5)));
 	mp_node->setOrientation(Vector3(0, 0, -1).getRotationTo(offset));
 
 	// Note: This relies on a single Cylinder emitter being present in the Orewar/ConstraintStream script
@@ -68,7 +74,7 @@ void ConstraintRenderObject::createEffects()
 	oss << "Constraint" << renderId();
 	mp_particle = sceneManager()->createParticleSystem(oss.str(), "Orewar/ConstraintStream");
 
-	if(mp_constraint->isRigid()) {
+	if(m_state.rigid) {
 		mp_particle->setEmitting(false);
 	} else {
 		mp_particle->setEmitting(true);
@@ -89,13 +95,19 @@ void ConstraintRenderObject::destroyEffects()
 // ========================================================================
 // PhysicsRenderObject Implementation
 // ========================================================================
-PhysicsRenderObject::PhysicsRenderObject(SphereCollisionObject * object, SceneManager * mgr)
-	: RenderObject(mgr), mp_object(object)
+PhysicsRenderObject::PhysicsRenderObject(const ObjectState & state, SceneManager * mgr)
+	: RenderObject(mgr), m_state(state)
+{
+}
+
+const ObjectState & PhysicsRenderObject::state() const
 {
+	return m_state;
 }
 
-SphereCollisionObject * PhysicsRenderObject::physics() {
-	return mp_object;
+void PhysicsRenderObject::state(const ObjectState & state)
+{
+	m_state = state;
 }
 
 // ========================================================================
@@ -103,22 +115,17 @@ SphereCollisionObject * PhysicsRenderObject::physics() {
 // ========================================================================
 bool ShipRO::m_resourcesLoaded = false;
 
-ShipRO::ShipRO(SpaceShip * ship, SceneManager * mgr)
-	: PhysicsRenderObject(ship->phys(), mgr), mp_spaceShip(ship), mp_shipNode(NULL), mp_shipRotateNode(NULL), mp_shipEntity(NULL),
+ShipRO::ShipRO(const ObjectState & state, SceneManager * mgr)
+	: PhysicsRenderObject(state, mgr), mp_shipNode(NULL), mp_shipRotateNode(NULL), mp_shipEntity(NULL),
 	mp_spotLight(NULL), mp_pointLight(NULL), mp_engineParticles(NULL)
 {
 }
 
-SpaceShip * ShipRO::ship() const
-{
-	return mp_spaceShip;
-}
-
 /** Updates the node based on passed time and camera orientation (useful for sprites) */
 void ShipRO::updateEffects(Real elapsedTime, Quaternion camOrientation)
 {
-	mp_shipNode->setPosition(physics()->position());
-	mp_shipNode->setOrientation(physics()->orientation());
+	mp_shipNode->setPosition(state().position);
+	mp_shipNode->setOrientation(state().orientation);
 }
 
 void ShipRO::loadSceneResources() 
@@ -156,7 +163,7 @@ void ShipRO::createEffects()
 	mp_pointLight = sceneManager()->createLight(oss.str());
 	mp_pointLight->setType(Ogre::Light::LT_POINT);
 	mp_pointLight->setPosition(Ogre::Vector3(0, 30, 0));
-	if (ship()->type() == ObjectType::SHIP) {
+	if (state().type == ObjectType::SHIP) {
 		mp_pointLight->setDiffuseColour(0.4, 0.1, 0.1);
 		mp_pointLight->setSpecularColour(0.4, 0.4, 0.4);
 	} else {
@@ -191,8 +198,8 @@ void ShipRO::destroyEffects()
 // ========================================================================
 bool NpcShipRO::m_resourcesLoaded = false;
 
-NpcShipRO::NpcShipRO(SpaceShip * ship, SceneManager * mgr)
-	: ShipRO(ship, mgr), mp_frameNode(NULL), mp_frameSprite(NULL), mp_screen(NULL),
+NpcShipRO::NpcShipRO(const ObjectState & state, SceneManager * mgr)
+	: ShipRO(state, mgr), mp_frameNode(NULL), mp_frameSprite(NULL), mp_screen(NULL),
 	mp_healthBar(NULL), mp_energyBar(NULL)
 {
 }
@@ -200,11 +207,11 @@ NpcShipRO::NpcShipRO(SpaceShip * ship, SceneManager * mgr)
 void NpcShipRO::updateEffects(Real elapsedTime, Quaternion camOrientation)
 {
 	ShipRO::updateEffects(elapsedTime, camOrientation);
-	mp_frameNode->setPosition(physics()->position());
+	mp_frameNode->setPosition(state().position);
 	mp_frameNode->setOrientation(camOrientation);
 
-	mp_healthBar->width((ship()->health() / ship()->maxHealth()) * 25000);
-	mp_energyBar->width((ship()->energy() / ship()->maxEnergy()) * 25000);
+	mp_healthBar->width((state().health / state().maxHealth) * 25000);
+	mp_energyBar->width((state().energy / state().maxEnergy) * 25000);
 }
 
 
@@ -274,24 +281,18 @@ void NpcShipRO::destroyEffects()
 bool CelestialBodyRO::m_resourcesLoaded = false;
 
 /** Constructor */
-CelestialBodyRO::CelestialBodyRO(CelestialBody * body, SceneManager * mgr) 
-	: PhysicsRenderObject(body->phys(), mgr), mp_body(body), mp_bodyNode(NULL),
+CelestialBodyRO::CelestialBodyRO(const ObjectState & state, SceneManager * mgr) 
+	: PhysicsRenderObject(state, mgr), mp_bodyNode(NULL),
 	mp_model(NULL), mp_pointLight(NULL), mp_particles(NULL)
 {
 }
 
-/** @return The CelestialBody game object represented by this entity */
-CelestialBody * CelestialBodyRO::body() const
-{
-	return mp_body;
-}
-
 /** Updates the node based on passed time and camera orientation (useful for sprites) */
 void CelestialBodyRO::updateEffects(Real elapsedTime, Quaternion camOrientation)
 {
-	mp_bodyNode->setPosition(mp_body->phys()->position());
-	Real speedFactor = mp_body->phys()->velocity().length() > Real(30000)? 
-		1 : mp_body->phys()->velocity().length() / Real(30000);
+	mp_bodyNode->setPosition(state().position);
+	Real speedFactor = state().velocity.length() > Real(30000)? 
+		1 : state().velocity.length() / Real(30000);
 	mp_particles->getEmitter(0)->setColour(ColourValue(speedFactor, 0, 1 - speedFactor, 1));
 	mp_particles->getEmitter(0)->setEmissionRate((int)(Real(50) * speedFactor));
 }
@@ -312,29 +313,29 @@ void CelestialBodyRO::createEffects()
 	oss << "CelestialBody" << renderId();
 
 	mp_bodyNode = sceneManager()->getRootSceneNode()->createChildSceneNode();
-	mp_bodyNode->setPosition(mp_body->phys()->position());
+	mp_bodyNode->setPosition(state().position);
 
 	mp_model = sceneManager()->createEntity(oss.str(), "sphere.mesh");
 
-	if(mp_body->type() == ObjectType::STAR) {
+	if(state().type == ObjectType::STAR) {
 		mp_model->setMaterialName("Orewar/Star");
-	} else if(mp_body->type() == ObjectType::PLANET) {
+	} else if(state().type == ObjectType::PLANET) {
 
-		if(mp_body->radius() > 6000) {
+		if(state().radius > 6000) {
 			mp_model->setMaterialName("Orewar/GasGiant");
-		} else if(mp_body->radius() > 3000) {
+		} else if(state().radius > 3000) {
 			mp_model->setMaterialName("Orewar/GasGiantMid");
-		} else if(mp_body->radius() > 2000) {
+		} else if(state().radius > 2000) {
 			mp_model->setMaterialName("Orewar/GasGiantSmall");
-		} else if(mp_body->radius() > 1500) {
+		} else if(state().radius > 1500) {
 			mp_model->setMaterialName("Orewar/Earth");
-		} else if(mp_body->radius() > 1000) {
+		} else if(state().radius > 1000) {
 			mp_model->setMaterialName("Orewar/Mars");
 		} else {
 			mp_model->setMaterialName("Orewar/RockPlanet");
 		}
 
-	} if(mp_body->type() == ObjectType::MOON) {
+	} if(state().type == ObjectType::MOON) {
 
 		if(rand() % 4 == 0) {
 			mp_model->setMaterialName("Orewar/Moon2");
@@ -346,11 +347,11 @@ void CelestialBodyRO::createEffects()
 
 	mp_bodyNode->attachObject(mp_model);
 	mp_bodyNode->setScale(
-		mp_body->radius() * modelSizeScale,
-		mp_body->radius() * modelSizeScale, 
-		mp_body->radius() * modelSizeScale);
+		state().radius * modelSizeScale,
+		state().radius * modelSizeScale, 
+		state().radius * modelSizeScale);
 	
-	if(mp_body->type() == ObjectType::STAR) {
+	if(state().type == ObjectType::STAR) {
 		oss << "L";
 		mp_pointLight = sceneManager()->createLight(oss.str());
 		mp_pointLight->setType(Ogre::Light::LT_POINT);
@@ -379,7 +380,7 @@ void CelestialBodyRO::destroyEffects()
 	sceneManager()->destroySceneNode(mp_bodyNode);
 	sceneManager()->destroyParticleSystem(mp_particles);
 
-	if(mp_body->type() == ObjectType::STAR) {
+	if(state().type == ObjectType::STAR) {
 		sceneManager()->destroyLight(mp_pointLight);
 	}
 }
@@ -389,21 +390,16 @@ void CelestialBodyRO::destroyEffects()
 // ========================================================================
 bool ProjectileRO::m_resourcesLoaded = false;
 
-ProjectileRO::ProjectileRO(Projectile * proj, SceneManager * mgr)
-	: PhysicsRenderObject(proj->phys(), mgr), mp_projectile(proj), mp_projNode(NULL), 
+ProjectileRO::ProjectileRO(const ObjectState & state, SceneManager * mgr)
+	: PhysicsRenderObject(state, mgr), mp_projNode(NULL), 
 	mp_pointLight(NULL), mp_particle(NULL)
 {
 }
 
-Projectile * ProjectileRO::projectile() const
-{
-	return mp_projectile;
-}
-
 void ProjectileRO::updateEffects(Real elapsedTime, Quaternion camOrientation)
 {
-	mp_projNode->setPosition(physics()->position());
-	mp_projNode->setOrientation(Vector3(0, 0, -1).getRotationTo(physics()->velocity()));
+	mp_projNode->setPosition(state().position);
+	mp_projNode->setOrientation(Vector3(0, 0, -1).getRotationTo(state().velocity));
 }
 
 
@@ -430,15 +426,15 @@ void ProjectileRO::createEffects()
 	mp_projNode->attachObject(mp_pointLight);
 
 	oss << "P";
-	if(mp_projectile->type() == ObjectType::PROJECTILE) {
+	if(state().type == ObjectType::PROJECTILE) {
 		mp_particle = sceneManager()->createParticleSystem(oss.str(), "Orewar/PlasmaStream");
 		mp_pointLight->setDiffuseColour(0.0, 1, 0.0);
 		mp_pointLight->setSpecularColour(0.2, 0.7, 0.2);
-	} else if (mp_projectile->type() == ObjectType::ANCHOR_PROJECTILE) {
+	} else if (state().type == ObjectType::ANCHOR_PROJECTILE) {
 		mp_particle = sceneManager()->createParticleSystem(oss.str(), "Orewar/Anchor");
 		mp_pointLight->setDiffuseColour(1, 0.0, 0.0);
 		mp_pointLight->setSpecularColour(0.7, 0.2, 0.2);
-	} else if (mp_projectile->type() == ObjectType::PLANET_CHUNK) {
+	} else if (state().type == ObjectType::PLANET_CHUNK) {
 		mp_particle = sceneManager()->createParticleSystem(oss.str(), "Orewar/PlanetChunk");
 		mp_pointLight->setDiffuseColour(1, 1, 1);
 		mp_pointLight->setSpecularColour(1, 0.2, 0.2);
@@ -460,16 +456,20 @@ void ProjectileRO::destroyEffects()
 // ========================================================================
 // RenderModel Implementation
 // ========================================================================
-RenderModel::RenderModel(GameArena& model, SceneManager * mgr, int pageSize, int initPages) 
-	: m_model(model), m_physicsRenderList(),
-	mp_mgr(mgr), m_memory(pageSize, initPages)
+RenderModel::RenderModel(SceneManager * mgr, int pageSize, int initPages) 
+	: m_physicsRenderList(), m_constraintRenderList(), m_nextPhysicsRenderList(),
+	m_nextConstraintRenderList(), mp_mgr(mgr), m_memory(pageSize, initPages)
 {
-	m_model.addGameArenaListener(this);
+	for(int i = 0; i < NUM_EVENT_TYPES; i++) {
+		m_eventCounts[i] = 0;
+	}
 }
 
 
-void RenderModel::updateRenderList(Real elapsedTime, Quaternion camOrientation)
+void RenderModel::updateRenderList(const ArenaSnapshot & snapshot, Real elapsedTime, Quaternion camOrientation)
 {
+	matchSnapshot(snapshot);
+
 	for(std::vector<PhysicsRenderObject *>::iterator physIter = m_physicsRenderList.begin();
 		physIter != m_physicsRenderList.end();
 		physIter++) 
@@ -485,71 +485,106 @@ void RenderModel::updateRenderList(Real elapsedTime, Quaternion camOrientation)
 	}
 }
 
-void RenderModel::newGameObject(GameObject * object)
+void RenderModel::matchSnapshot(const ArenaSnapshot & snapshot)
+{
+	// Both the render list and the snapshot are sorted by serial, so they are merged in step
+	const std::vector<ObjectState> & objects = snapshot.objects();
+	m_nextPhysicsRenderList.clear();
+	m_nextPhysicsRenderList.reserve(objects.size());
+	unsigned int renderIndex = 0;
+	unsigned int objectIndex = 0;
+	while(renderIndex < m_physicsRenderList.size() || objectIndex < objects.size()) {
+		if(objectIndex == objects.size() || (renderIndex < m_physicsRenderList.size()
+			&& m_physicsRenderList[renderIndex]->state().serial < objects[objectIndex].serial))
+		{
+			// The object has left the arena
+			destroyRenderObject(m_physicsRenderList[renderIndex++]);
+		} else if(renderIndex == m_physicsRenderList.size() 
+			|| objects[objectIndex].serial < m_physicsRenderList[renderIndex]->state().serial)
+		{
+			m_nextPhysicsRenderList.push_back(createRenderObject(objects[objectIndex++]));
+		} else {
+			m_physicsRenderList[renderIndex]->state(objects[objectIndex++]);
+			m_nextPhysicsRenderList.push_back(m_physicsRenderList[renderIndex++]);
+		}
+	}
+	m_physicsRenderList.swap(m_nextPhysicsRenderList);
+
+	const std::vector<ConstraintState> & constraints = snapshot.constraints();
+	m_nextConstraintRenderList.clear();
+	m_nextConstraintRenderList.reserve(constraints.size());
+	renderIndex = 0;
+	unsigned int constraintIndex = 0;
+	while(renderIndex < m_constraintRenderList.size() || constraintIndex < constraints.size()) {
+		if(constraintIndex == constraints.size() || (renderIndex < m_constraintRenderList.size()
+			&& m_constraintRenderList[renderIndex]->state().key < constraints[constraintIndex].key))
+		{
+			destroyRenderObject(m_constraintRenderList[renderIndex++]);
+		} else if(renderIndex == m_constraintRenderList.size() 
+			|| constraints[constraintIndex].key < m_constraintRenderList[renderIndex]->state().key)
+		{
+			m_nextConstraintRenderList.push_back(createRenderObject(constraints[constraintIndex++]));
+		} else {
+			m_constraintRenderList[renderIndex]->state(constraints[constraintIndex++]);
+			m_nextConstraintRenderList.push_back(m_constraintRenderList[renderIndex++]);
+		}
+	}
+	m_constraintRenderList.swap(m_nextConstraintRenderList);
+}
+
+PhysicsRenderObject * RenderModel::createRenderObject(const ObjectState & state)
 {
 	PhysicsRenderObject * p_renderObj = NULL;
-	if(object->type() == ObjectType::SHIP) {
-		p_renderObj = m_memory.storeObject(ShipRO((SpaceShip*)object, mp_mgr));
-	} else if (object->type() == ObjectType::NPC_SHIP) {
-		p_renderObj = m_memory.storeObject(NpcShipRO((SpaceShip*)object, mp_mgr));
-	} else if (object->type() == ObjectType::PROJECTILE
-		|| object->type() == ObjectType::ANCHOR_PROJECTILE
-		|| object->type() == ObjectType::PLANET_CHUNK) 
+	if(state.type == ObjectType::SHIP) {
+		p_renderObj = m_memory.storeObject(ShipRO(state, mp_mgr));
+	} else if (state.type == ObjectType::NPC_SHIP) {
+		p_renderObj = m_memory.storeObject(NpcShipRO(state, mp_mgr));
+	} else if (state.type == ObjectType::PROJECTILE
+		|| state.type == ObjectType::ANCHOR_PROJECTILE
+		|| state.type == ObjectType::PLANET_CHUNK) 
 	{
-		p_renderObj = m_memory.storeObject(ProjectileRO((Projectile*)object, mp_mgr));
-	} else if (object->type() == ObjectType::STAR
-		|| object->type() == ObjectType::PLANET
-		|| object->type() == ObjectType::MOON) 
+		p_renderObj = m_memory.storeObject(ProjectileRO(state, mp_mgr));
+	} else if (state.type == ObjectType::STAR
+		|| state.type == ObjectType::PLANET
+		|| state.type == ObjectType::MOON) 
 	{
-		p_renderObj = m_memory.storeObject(CelestialBodyRO((CelestialBody*)object, mp_mgr));
+		p_renderObj = m_memory.storeObject(CelestialBodyRO(state, mp_mgr));
 	}
 
 	p_renderObj->loadSceneResources();
 	p_renderObj->createEffects();
-	m_physicsRenderList.push_back(p_renderObj);
+	return p_renderObj;
 }
 
-void RenderModel::destroyedGameObject(GameObject * object)
+ConstraintRenderObject * RenderModel::createRenderObject(const ConstraintState & state)
 {
-	for(std::vector<PhysicsRenderObject *>::iterator renderIter =  m_physicsRenderList.begin(); 
-		renderIter != m_physicsRenderList.end();
-		renderIter++) {
-
-			if((*(*renderIter)).physics() == object->phys()) {
-			(*(*renderIter)).destroyEffects();
-			m_memory.destroyObject(*renderIter);
-			m_physicsRenderList.erase(std::remove(m_physicsRenderList.begin(), 
-				m_physicsRenderList.end(), (*renderIter)), m_physicsRenderList.end());
-			return;
-		}
-	}
-}
-
-void RenderModel::newConstraint(Constraint * constraint)
-{
-	ConstraintRenderObject * p_renderObj = m_memory.storeObject(ConstraintRenderObject(constraint, mp_mgr));
+	ConstraintRenderObject * p_renderObj = m_memory.storeObject(ConstraintRenderObject(state, mp_mgr));
 
 	p_renderObj->loadSceneResources();
 	p_renderObj->createEffects();
-	m_constraintRenderList.push_back(p_renderObj);
+	return p_renderObj;
 }
 
-void RenderModel::destroyedConstraint(Constraint * constraint)
+void RenderModel::destroyRenderObject(RenderObject * renderObj)
 {
-	for(std::vector<ConstraintRenderObject *>::iterator renderIter =  m_constraintRenderList.begin(); 
-		renderIter != m_constraintRenderList.end();
-		renderIter++) {
+	renderObj->destroyEffects();
+	m_memory.destroyObject(renderObj);
+}
 
-		if((*(*renderIter)).constraint() == constraint) {
-			(*(*renderIter)).destroyEffects();
-			m_memory.destroyObject(*renderIter);
-			m_constraintRenderList.erase(std::remove(m_constraintRenderList.begin(), 
-				m_constraintRenderList.end(), (*renderIter)), m_constraintRenderList.end());
-			return;
-		}
+void RenderModel::drainEvents(EventChannel & channel)
+{
+	// Objects are created and destroyed by matching snapshots, so events are only tallied
+	ArenaEvent event;
+	while(channel.pop(event)) {
+		m_eventCounts[event.type]++;
 	}
 }
 
+unsigned long RenderModel::eventCount(ArenaEventType type) const
+{
+	return m_eventCounts[type];
+}
+
 int RenderModel::getNumObjects() const
 {
 	return m_physicsRenderList.size() + m_constraintRenderList.size();
@@ -557,4 +592,4 @@ int RenderModel::getNumObjects() const
 
 PagedMemoryPool * RenderModel::memoryManager() {
 	return &m_memory;
-}
\ No newline at end of file
+}
\ No newline at end of file
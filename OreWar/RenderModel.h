@@ -6,6 +6,8 @@
 #include <sstream>
 #include <OgreParticleSystem.h>
 #include "GameObjects.h"
+#include "ArenaSnapshot.h"
+#include "EventChannel.h"
 #include "Gorilla.h"
 #include "MemoryMgr.h"
 
@@ -60,8 +62,8 @@ public:
 class ConstraintRenderObject : public RenderObject
 {
 private:
-	/** The constraint object to render */
-	Constraint * mp_constraint;
+	/** The latest state of the constraint to render */
+	ConstraintState m_state;
 	
 	/** SceneNode to anchor effects to */
 	SceneNode * mp_node;
@@ -72,11 +74,14 @@ private:
 	/** Static flag to ensure resources are loaded only once */
 	static bool m_resourcesLoaded;
 public:
-	/** Constructs a new PhysicsRenderObject */
-	ConstraintRenderObject(Constraint * constraint, SceneManager * mgr);
+	/** Constructs a new ConstraintRenderObject for the constraint in the passed state */
+	ConstraintRenderObject(const ConstraintState & state, SceneManager * mgr);
 
-	/** @return A pointer to the model object */
-	Constraint * constraint();
+	/** @return The latest state of the rendered constraint */
+	const ConstraintState & state() const;
+
+	/** Sets the latest state of the rendered constraint (applied by the next updateEffects()) */
+	void state(const ConstraintState & state);
 
 	/** #see RenderObject::updateEffects() */
 	virtual void updateEffects(Real elapsedTime, Quaternion camOrientation);
@@ -94,20 +99,24 @@ public:
 
 /**
  * A PhysicsRenderObject represents a single logical object from the game model
- * that should be rendered to screen.
+ * that should be rendered to screen. Render objects only see the state of their
+ * object copied into an ArenaSnapshot, never the live object.
  */
 class PhysicsRenderObject : public RenderObject
 {
 private:
-	/** A pointer to the model object */
-	SphereCollisionObject * mp_object;
+	/** The latest state of the model object */
+	ObjectState m_state;
 
 public:
-	/** Constructs a new PhysicsRenderObject */
-	PhysicsRenderObject(SphereCollisionObject * object, SceneManager * mgr);
+	/** Constructs a new PhysicsRenderObject for the object in the passed state */
+	PhysicsRenderObject(const ObjectState & state, SceneManager * mgr);
+
+	/** @return The latest state of the model object */
+	const ObjectState & state() const;
 
-	/** @return A pointer to the model object */
-	SphereCollisionObject * physics();
+	/** Sets the latest state of the model object (applied by the next updateEffects()) */
+	void state(const ObjectState & state);
 
 	/** Updates the node based on passed time and camera orientation (useful for sprites) */
 	virtual void updateEffects(Real elapsedTime, Quaternion camOrientation) = 0;
@@ -133,9 +142,6 @@ public:
 class ShipRO : public PhysicsRenderObject
 {
 private:
-	/** The game object represented by this render object */
-	SpaceShip * mp_spaceShip;
-
 	/** The scene node to anchor effects onto */
 	SceneNode * mp_shipNode;
 
@@ -151,10 +157,7 @@ private:
 
 	static bool m_resourcesLoaded;
 public:
-	ShipRO(SpaceShip * ship, SceneManager * mgr);
-
-	/** @return The SpaceShip game object represented by this entity */
-	SpaceShip * ship() const;
+	ShipRO(const ObjectState & state, SceneManager * mgr);
 
 	/** Updates the node based on passed time and camera orientation (useful for sprites) */
 	virtual void updateEffects(Real elapsedTime, Quaternion camOrientation);
@@ -181,7 +184,7 @@ private:
 
 	static bool m_resourcesLoaded;
 public:
-	NpcShipRO(SpaceShip * ship, SceneManager * mgr);
+	NpcShipRO(const ObjectState & state, SceneManager * mgr);
 
 	/** Updates the node based on passed time and camera orientation (useful for sprites) */
 	virtual void updateEffects(Real elapsedTime, Quaternion camOrientation);
@@ -203,9 +206,6 @@ public:
 class CelestialBodyRO : public PhysicsRenderObject
 {
 private:
-	/** The celestial body represented by this render object */
-	CelestialBody * mp_body;
-
 	/** The scene node to anchor effects onto */
 	SceneNode * mp_bodyNode;
 	
@@ -223,10 +223,7 @@ private:
 
 public:
 	/** Constructor */
-	CelestialBodyRO(CelestialBody * body, SceneManager * mgr);
-
-	/** @return The CelestialBody game object represented by this entity */
-	CelestialBody * body() const;
+	CelestialBodyRO(const ObjectState & state, SceneManager * mgr);
 
 	/** Updates the node based on passed time and camera orientation (useful for sprites) */
 	virtual void updateEffects(Real elapsedTime, Quaternion camOrientation);
@@ -245,8 +242,6 @@ public:
 class ProjectileRO : public PhysicsRenderObject
 {
 private:
-	Projectile * mp_projectile;
-
 	SceneNode * mp_projNode;
 
 	Light * mp_pointLight;
@@ -255,9 +250,7 @@ private:
 
 	static bool m_resourcesLoaded;
 public:
-	ProjectileRO(Projectile * proj, SceneManager * mgr);
-
-	Projectile * projectile() const;
+	ProjectileRO(const ObjectState & state, SceneManager * mgr);
 
 	/** Updates the node based on passed time and camera orientation (useful for sprites) */
 	virtual void updateEffects(Real elapsedTime, Quaternion camOrientation);
@@ -272,47 +265,69 @@ public:
 
 /**
  * The RenderModel stores the complete list of RenderObjects that should be rendered each frame
- * for a scene.
+ * for a scene. The list is kept in step with the latest ArenaSnapshot, rather than with the
+ * live GameArena, so rendering never touches state being simulated on another thread.
  */
-class RenderModel : public GameArenaListener
+class RenderModel
 {
 private:
-	/** Reference to the GameArena object that should be observed */
-	GameArena & m_model;
-
-	/** List of all PhysicsRenderObjects that should be updated and rendered each frame */
+	/** List of all PhysicsRenderObjects that should be updated and rendered each frame (sorted by serial) */
 	std::vector<PhysicsRenderObject * > m_physicsRenderList;
 
+	/** List of all ConstraintRenderObjects that should be updated and rendered each frame (sorted by key) */
 	std::vector<ConstraintRenderObject * > m_constraintRenderList;
 
+	/** The render lists being built while matching a snapshot (kept to avoid reallocation) */
+	std::vector<PhysicsRenderObject * > m_nextPhysicsRenderList;
+	std::vector<ConstraintRenderObject * > m_nextConstraintRenderList;
+
 	/** The SceneManager for the scene represented by the RenderModel */
 	SceneManager * mp_mgr;
 
 	/** The memory pool which will handle all RenderObjects */
 	PagedMemoryPool m_memory;
 
+	/** The number of events of each type drained from the arena */
+	unsigned long m_eventCounts[NUM_EVENT_TYPES];
+
+	/** Creates the render object for an object which has appeared in a snapshot */
+	PhysicsRenderObject * createRenderObject(const ObjectState & state);
+
+	/** Creates the render object for a constraint which has appeared in a snapshot */
+	ConstraintRenderObject * createRenderObject(const ConstraintState & state);
+
+	/** Destroys a render object whose model object has left the snapshot */
+	void destroyRenderObject(RenderObject * renderObj);
+
+	/** 
+	 * Matches the render lists to the passed snapshot in a single merging pass, creating
+	 * render objects for new objects, destroying those whose objects are gone, and passing
+	 * the latest state to the rest
+	 */
+	void matchSnapshot(const ArenaSnapshot & snapshot);
+
 public:
 	/**
-	 * Constructs a RenderModel which observes the specified GameArena, and creates
-	 * scene nodes through the passed SceneManager. The specified number of inital pages
-	 * at the specified page size (in bytes) will be created in the memory manager.
+	 * Constructs a RenderModel which creates scene nodes through the passed SceneManager.
+	 * The specified number of inital pages at the specified page size (in bytes) will be
+	 * created in the memory manager.
 	 */
-	RenderModel(GameArena& model, SceneManager * mgr, int pageSize, int initPages);
-
-	/** Calls the updateEffects() method of all RenderObjects stored in the RenderModel's render list */
-	void updateRenderList(Real elapsedTime, Quaternion camOrientation);
+	RenderModel(SceneManager * mgr, int pageSize, int initPages);
 
-	/** Called whenever a new GameObject is created by the observed GameArena */
-	virtual void newGameObject(GameObject * object);
-
-	/** Called whenever a GameObject is destroyed by the observed GameArena */
-	virtual void destroyedGameObject(GameObject * object);
+	/** 
+	 * Matches the render list to the passed snapshot, then calls the updateEffects() method
+	 * of all RenderObjects stored in the RenderModel's render list
+	 */
+	void updateRenderList(const ArenaSnapshot & snapshot, Real elapsedTime, Quaternion camOrientation);
 
-	/** Called whenever a new Constraint is generated in the GameArena */
-	virtual void newConstraint(Constraint * object);
+	/** 
+	 * Pops every event waiting on the passed channel. The RenderModel must be the channel's
+	 * only consumer.
+	 */
+	void drainEvents(EventChannel & channel);
 
-	/** Called just before a Constraint is destroyed in the GameArena */
-	virtual void destroyedConstraint(Constraint * object);
+	/** @return The number of events of the passed type drained so far */
+	unsigned long eventCount(ArenaEventType type) const;
 
 	/** @return THe number of render objects currently managed by this RenderModel */
 	int getNumObjects() const;
@@ -321,4 +336,4 @@ public:
 	PagedMemoryPool * memoryManager();
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "SimulationThread.h"
+#include "InputRecording.h"
+#include <algorithm>
+#include <OgreTimer.h>
+
+// ========================================================================
+// SimulationThread Implementation
+// ========================================================================
+SimulationThread::SimulationThread(GameArena & arena, Real tickLength) : m_arena(arena),
+	m_tickLength(tickLength), m_writeIndex(0), m_readyIndex(1), m_readIndex(2), m_fresh(false),
+	m_input(), m_ticks(0), mp_replay(NULL), m_replayStep(0), m_replayAccumulator(0),
+	m_stopping(false), m_stateMutex(), m_arenaMutex(), m_thread()
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+	stop();
+}
+
+void SimulationThread::start()
+{
+	if(running()) {
+		return;
+	}
+
+	m_arena.fixedStep(m_tickLength);
+	publish();
+
+	m_stopping = false;
+	m_thread = boost::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop()
+{
+	if(!m_thread.joinable()) {
+		return;
+	}
+
+	{
+		boost::lock_guard<boost::mutex> lock(m_stateMutex);
+		m_stopping = true;
+	}
+	m_thread.join();
+}
+
+bool SimulationThread::running()
+{
+	return m_thread.joinable();
+}
+
+void SimulationThread::playerInput(const PlayerInput & input)
+{
+	boost::lock_guard<boost::mutex> lock(m_stateMutex);
+	Real pitch = m_input.pitch + input.pitch;
+	Real yaw = m_input.yaw + input.yaw;
+	m_input = input;
+	m_input.pitch = pitch;
+	m_input.yaw = yaw;
+}
+
+void SimulationThread::replay(const InputRecording * recording)
+{
+	mp_replay = recording;
+	m_replayStep = 0;
+	m_replayAccumulator = 0;
+}
+
+bool SimulationThread::replayFinished()
+{
+	boost::lock_guard<boost::mutex> lock(m_arenaMutex);
+	return mp_replay != NULL && m_replayStep >= mp_replay->numSteps();
+}
+
+const ArenaSnapshot & SimulationThread::latestSnapshot()
+{
+	boost::lock_guard<boost::mutex> lock(m_stateMutex);
+	if(m_fresh) {
+		std::swap(m_readIndex, m_readyIndex);
+		m_fresh = false;
+	}
+	return m_buffers[m_readIndex];
+}
+
+boost::mutex & SimulationThread::arenaMutex()
+{
+	return m_arenaMutex;
+}
+
+Real SimulationThread::tickLength() const
+{
+	return m_tickLength;
+}
+
+void SimulationThread::publish()
+{
+	// The write buffer belongs to this thread alone, so only the swap needs the lock
+	m_buffers[m_writeIndex].capture(m_arena, m_ticks);
+
+	boost::lock_guard<boost::mutex> lock(m_stateMutex);
+	std::swap(m_writeIndex, m_readyIndex);
+	m_fresh = true;
+}
+
+int SimulationThread::replayTicks(Real elapsed)
+{
+	const int maxSteps = 8;
+	int steps = 0;
+	m_replayAccumulator += elapsed;
+	while(m_replayAccumulator >= m_tickLength && steps < maxSteps
+		&& m_replayStep < mp_replay->numSteps())
+	{
+		m_arena.step(mp_replay->input(m_replayStep));
+		m_replayStep++;
+		m_replayAccumulator -= m_tickLength;
+		steps++;
+	}
+
+	if(steps == maxSteps || m_replayStep >= mp_replay->numSteps()) {
+		m_replayAccumulator = 0;
+	}
+	return steps;
+}
+
+void SimulationThread::run()
+{
+	Timer timer;
+	unsigned long tickMicroseconds = (unsigned long)(m_tickLength * 1000000);
+	unsigned long lastTime = timer.getMicroseconds();
+	while(true) {
+		// Take the input received since the last tick (held controls stay held)
+		PlayerInput input;
+		{
+			boost::lock_guard<boost::mutex> lock(m_stateMutex);
+			if(m_stopping) {
+				break;
+			}
+			input = m_input;
+			m_input.pitch = 0;
+			m_input.yaw = 0;
+		}
+
+		unsigned long now = timer.getMicroseconds();
+		Real elapsed = (now - lastTime) / Real(1000000);
+		lastTime = now;
+
+		{
+			boost::lock_guard<boost::mutex> lock(m_arenaMutex);
+			int steps = 0;
+			if(mp_replay != NULL) {
+				steps = replayTicks(elapsed);
+			} else {
+				m_arena.playerInput(input);
+				steps = m_arena.update(elapsed);
+			}
+			if(steps > 0) {
+				m_ticks += steps;
+				publish();
+			}
+		}
+
+		// Sleep for whatever is left of the tick
+		unsigned long spent = timer.getMicroseconds() - now;
+		if(spent < tickMicroseconds) {
+			boost::this_thread::sleep(boost::posix_time::microseconds(tickMicroseconds - spent));
+		}
+	}
+}
@@ -0,0 +1,146 @@
+#ifndef __SimulationThread_h_
+#define __SimulationThread_h_
+
+#include <boost/thread.hpp>
+#include "GameObjects.h"
+#include "ArenaSnapshot.h"
+
+class InputRecording;
+
+/**
+ * The SimulationThread class runs a GameArena on its own thread at a fixed tick, so that
+ * the cost of simulating and the cost of rendering no longer add up within a frame.
+ *
+ * After every tick the arena's state is captured into one of three snapshot buffers and
+ * published. The reading thread always takes the latest complete snapshot without waiting
+ * for a tick to finish, and the simulating thread never waits for a reader: one buffer is
+ * being written, one holds the latest published snapshot, and one is held by the reader.
+ *
+ * Player input is handed over through the thread, and anything else which touches the arena
+ * (such as adding or clearing bodies) must hold arenaMutex(), which is held by the
+ * simulating thread for the whole of each tick.
+ *
+ * The thread can instead play back an InputRecording, taking each tick's input from the
+ * recording rather than the player, so a recorded session can be watched through the renderer.
+ */
+class SimulationThread
+{
+private:
+	/** The number of snapshot buffers */
+	static const int NUM_BUFFERS = 3;
+
+	/** The arena simulated by the thread */
+	GameArena & m_arena;
+
+	/** The length of a tick (in seconds) */
+	Real m_tickLength;
+
+	/** The snapshot buffers */
+	ArenaSnapshot m_buffers[NUM_BUFFERS];
+
+	/** The buffer being written by the simulating thread */
+	int m_writeIndex;
+
+	/** The buffer holding the latest published snapshot */
+	int m_readyIndex;
+
+	/** The buffer held by the reading thread */
+	int m_readIndex;
+
+	/** True if a snapshot has been published since the reader last took one */
+	bool m_fresh;
+
+	/** Input received since the last tick (pitch and yaw are accumulated) */
+	PlayerInput m_input;
+
+	/** The number of ticks performed */
+	unsigned long m_ticks;
+
+	/** The recording being played back (NULL if the player's input is applied) */
+	const InputRecording * mp_replay;
+
+	/** The next step of the recording to play back */
+	int m_replayStep;
+
+	/** The time accumulated towards the next played back tick */
+	Real m_replayAccumulator;
+
+	/** True once the thread has been asked to stop */
+	bool m_stopping;
+
+	/** Guards the buffer indices, the pending input and the stop flag */
+	boost::mutex m_stateMutex;
+
+	/** Held by the simulating thread for each tick, and by anyone else touching the arena */
+	boost::mutex m_arenaMutex;
+
+	/** The simulating thread (not-a-thread until started) */
+	boost::thread m_thread;
+
+	/** Main loop of the simulating thread */
+	void run();
+
+	/** Captures the arena into the write buffer, and publishes it as the latest snapshot */
+	void publish();
+
+	/**
+	 * Plays back the recorded ticks which fit in the elapsed time (at most 8)
+	 * @return The number of ticks performed
+	 */
+	int replayTicks(Real elapsed);
+
+	/** Disabled, as the thread refers to its buffers by index */
+	SimulationThread(const SimulationThread & copy);
+
+	/** Disabled, as the thread refers to its buffers by index */
+	SimulationThread & operator=(const SimulationThread & copy);
+
+public:
+	/**
+	 * Constructs a stopped SimulationThread which will run the passed arena with the
+	 * passed tick length (in seconds)
+	 */
+	SimulationThread(GameArena & arena, Real tickLength);
+
+	/** Deconstructor, stops the thread */
+	~SimulationThread();
+
+	/**
+	 * Publishes a snapshot of the arena's current state (so one is always available), then
+	 * starts simulating. The arena is given a fixed step of one tick.
+	 */
+	void start();
+
+	/** Stops simulating, returning once the thread has finished its current tick */
+	void stop();
+
+	/** @return True if the thread is simulating */
+	bool running();
+
+	/** Sets the input applied to the player's ship on following ticks (see GameArena::playerInput()) */
+	void playerInput(const PlayerInput & input);
+
+	/**
+	 * Plays back the passed recording instead of applying the player's input. Must be called
+	 * before the thread is started, on an arena configured and populated for the recording
+	 * (see InputRecording::configure()). Ticks stop when the recording runs out.
+	 */
+	void replay(const InputRecording * recording);
+
+	/** @return True if a recording is being played back, and every recorded tick has been performed */
+	bool replayFinished();
+
+	/**
+	 * @return The latest complete snapshot of the arena. The snapshot is not modified until
+	 * the next call, which may return a newer one.
+	 */
+	const ArenaSnapshot & latestSnapshot();
+
+	/** @return The mutex which must be held to touch the arena while the thread is running */
+	boost::mutex & arenaMutex();
+
+	/** @return The length of a tick (in seconds) */
+	Real tickLength() const;
+};
+
+#endif
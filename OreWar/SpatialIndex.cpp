@@ -0,0 +1,440 @@
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <OgreMath.h>
+
+// ========================================================================
+// SpatialEntry Implementation
+// ========================================================================
+SpatialEntry::SpatialEntry(const Vector3 & position, Real radius, unsigned int typeBit, GameObject * object)
+	: position(position), radius(radius), typeBit(typeBit), object(object)
+{
+}
+
+
+// ========================================================================
+// RayHit Implementation
+// ========================================================================
+RayHit::RayHit() : object(NULL), distance(0), point(0, 0, 0)
+{
+}
+
+RayHit::RayHit(GameObject * object, Real distance, const Vector3 & point)
+	: object(object), distance(distance), point(point)
+{
+}
+
+bool RayHit::operator<(const RayHit & other) const
+{
+	return distance < other.distance;
+}
+
+
+// ========================================================================
+// SpatialIndex Implementation
+// ========================================================================
+
+/** Orders entries by their position along one axis (used to split nodes) */
+class EntryAxisLess
+{
+private:
+	int m_axis;
+
+public:
+	EntryAxisLess(int axis) : m_axis(axis)
+	{
+	}
+
+	bool operator()(const SpatialEntry & a, const SpatialEntry & b) const
+	{
+		return a.position[m_axis] < b.position[m_axis];
+	}
+};
+
+SpatialIndex::SpatialIndex() : m_entries(), m_nodes()
+{
+}
+
+void SpatialIndex::clear()
+{
+	m_entries.clear();
+	m_nodes.clear();
+}
+
+void SpatialIndex::add(const SpatialEntry & entry)
+{
+	m_entries.push_back(entry);
+}
+
+void SpatialIndex::build()
+{
+	m_nodes.clear();
+	if(m_entries.empty()) {
+		return;
+	}
+
+	m_nodes.reserve((m_entries.size() / LEAF_SIZE + 1) * 2);
+	m_nodes.push_back(Node());
+	buildNode(0, 0, m_entries.size());
+}
+
+void SpatialIndex::buildNode(int nodeIndex, int begin, int end)
+{
+	// Bound the spheres, and separately their centers (used to pick the split axis)
+	Vector3 minimum = m_entries[begin].position - m_entries[begin].radius;
+	Vector3 maximum = m_entries[begin].position + m_entries[begin].radius;
+	Vector3 centerMin = m_entries[begin].position;
+	Vector3 centerMax = m_entries[begin].position;
+	unsigned int typeMask = 0;
+	for(int i = begin; i < end; i++) {
+		const SpatialEntry & entry = m_entries[i];
+		minimum.makeFloor(entry.position - entry.radius);
+		maximum.makeCeil(entry.position + entry.radius);
+		centerMin.makeFloor(entry.position);
+		centerMax.makeCeil(entry.position);
+		typeMask |= entry.typeBit;
+	}
+
+	m_nodes[nodeIndex].minimum = minimum;
+	m_nodes[nodeIndex].maximum = maximum;
+	m_nodes[nodeIndex].typeMask = typeMask;
+
+	if(end - begin <= LEAF_SIZE) {
+		m_nodes[nodeIndex].first = begin;
+		m_nodes[nodeIndex].count = end - begin;
+		return;
+	}
+
+	// Split at the median along the axis with the widest spread of centers
+	Vector3 extent = centerMax - centerMin;
+	int axis = 0;
+	if(extent.y > extent[axis]) {
+		axis = 1;
+	}
+	if(extent.z > extent[axis]) {
+		axis = 2;
+	}
+
+	int middle = begin + (end - begin) / 2;
+	std::nth_element(m_entries.begin() + begin, m_entries.begin() + middle, m_entries.begin() + end,
+		EntryAxisLess(axis));
+
+	// Children are stored next to each other, so only the first needs to be recorded
+	int firstChild = m_nodes.size();
+	m_nodes[nodeIndex].first = firstChild;
+	m_nodes[nodeIndex].count = 0;
+	m_nodes.push_back(Node());
+	m_nodes.push_back(Node());
+
+	buildNode(firstChild, begin, middle);
+	buildNode(firstChild + 1, middle, end);
+}
+
+int SpatialIndex::size() const
+{
+	return m_entries.size();
+}
+
+const SpatialEntry & SpatialIndex::entry(int index) const
+{
+	return m_entries[index];
+}
+
+void SpatialIndex::move(int index, const Vector3 & position, Real radius)
+{
+	m_entries[index].position = position;
+	m_entries[index].radius = radius;
+}
+
+void SpatialIndex::refit()
+{
+	// Children are always stored after their parent, so a backwards pass bounds every
+	// node's children before the node itself
+	for(int nodeIndex = (int)m_nodes.size() - 1; nodeIndex >= 0; nodeIndex--) {
+		Node & node = m_nodes[nodeIndex];
+		if(node.count == 0) {
+			const Node & first = m_nodes[node.first];
+			const Node & second = m_nodes[node.first + 1];
+			node.minimum = first.minimum;
+			node.maximum = first.maximum;
+			node.minimum.makeFloor(second.minimum);
+			node.maximum.makeCeil(second.maximum);
+			continue;
+		}
+
+		node.minimum = m_entries[node.first].position - m_entries[node.first].radius;
+		node.maximum = m_entries[node.first].position + m_entries[node.first].radius;
+		for(int i = node.first + 1; i < node.first + node.count; i++) {
+			node.minimum.makeFloor(m_entries[i].position - m_entries[i].radius);
+			node.maximum.makeCeil(m_entries[i].position + m_entries[i].radius);
+		}
+	}
+}
+
+Real SpatialIndex::intersectBox(const Node & node, const Vector3 & origin, const Vector3 & invDirection,
+	Real inflate, Real maxDistance)
+{
+	Real entryDistance = 0;
+	Real exitDistance = maxDistance;
+	for(int axis = 0; axis < 3; axis++) {
+		Real t1 = (node.minimum[axis] - inflate - origin[axis]) * invDirection[axis];
+		Real t2 = (node.maximum[axis] + inflate - origin[axis]) * invDirection[axis];
+		if(t1 > t2) {
+			std::swap(t1, t2);
+		}
+
+		// Comparisons are written so that NaN (a ray lying in a slab plane) is ignored
+		if(t1 > entryDistance) {
+			entryDistance = t1;
+		}
+		if(t2 < exitDistance) {
+			exitDistance = t2;
+		}
+		if(entryDistance > exitDistance) {
+			return -1;
+		}
+	}
+
+	return entryDistance;
+}
+
+Real SpatialIndex::intersectSphere(const SpatialEntry & entry, const Vector3 & origin, const Vector3 & direction,
+	Real inflate, Real maxDistance)
+{
+	Vector3 relOrigin = origin - entry.position;
+	Real radius = entry.radius + inflate;
+	Real c = relOrigin.squaredLength() - radius * radius;
+	if(c <= 0) {
+		// The ray starts inside the sphere
+		return 0;
+	}
+
+	Real b = relOrigin.dotProduct(direction);
+	Real discriminant = b * b - c;
+	if(b > 0 || discriminant < 0) {
+		return -1;
+	}
+
+	Real distance = -b - Math::Sqrt(discriminant);
+	return distance <= maxDistance ? distance : -1;
+}
+
+bool SpatialIndex::cast(const Vector3 & origin, const Vector3 & direction, Real radius, Real maxDistance,
+	unsigned int typeMask, RayHit * nearest, std::vector<RayHit> * hits) const
+{
+	if(m_nodes.empty() || direction.isZeroLength()) {
+		return false;
+	}
+
+	Vector3 unitDirection = direction.normalisedCopy();
+	Vector3 invDirection = Vector3(1 / unitDirection.x, 1 / unitDirection.y, 1 / unitDirection.z);
+	Real range = maxDistance;
+	bool found = false;
+	std::vector<RayHit>::size_type firstHit = hits != NULL ? hits->size() : 0;
+
+	// The tree is balanced, so its depth never comes close to the stack size
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while(stackSize > 0) {
+		const Node & node = m_nodes[stack[--stackSize]];
+		if((node.typeMask & typeMask) == 0 || intersectBox(node, origin, invDirection, radius, range) < 0) {
+			continue;
+		}
+
+		if(node.count == 0) {
+			// When looking for the nearest hit, visit the nearer child first so that
+			// the range shrinks as early as possible
+			int nearChild = node.first;
+			int farChild = node.first + 1;
+			if(hits == NULL) {
+				Real nearDistance = intersectBox(m_nodes[nearChild], origin, invDirection, radius, range);
+				Real farDistance = intersectBox(m_nodes[farChild], origin, invDirection, radius, range);
+				if(farDistance >= 0 && (nearDistance < 0 || farDistance < nearDistance)) {
+					std::swap(nearChild, farChild);
+				}
+			}
+			stack[stackSize++] = farChild;
+			stack[stackSize++] = nearChild;
+			continue;
+		}
+
+		for(int i = node.first; i < node.first + node.count; i++) {
+			const SpatialEntry & entry = m_entries[i];
+			if((entry.typeBit & typeMask) == 0) {
+				continue;
+			}
+
+			Real distance = intersectSphere(entry, origin, unitDirection, radius, range);
+			if(distance < 0) {
+				continue;
+			}
+
+			RayHit hit(entry.object, distance, origin + unitDirection * distance);
+			if(hits != NULL) {
+				hits->push_back(hit);
+			} else {
+				// Only nearer hits are of interest from here on
+				*nearest = hit;
+				range = distance;
+			}
+			found = true;
+		}
+	}
+
+	if(hits != NULL) {
+		std::sort(hits->begin() + firstHit, hits->end());
+	}
+
+	return found;
+}
+
+bool SpatialIndex::raycast(const Vector3 & origin, const Vector3 & direction, Real maxDistance,
+	unsigned int typeMask, RayHit & hit) const
+{
+	return cast(origin, direction, 0, maxDistance, typeMask, &hit, NULL);
+}
+
+int SpatialIndex::raycastAll(const Vector3 & origin, const Vector3 & direction, Real maxDistance,
+	unsigned int typeMask, std::vector<RayHit> & hits) const
+{
+	int previousHits = hits.size();
+	cast(origin, direction, 0, maxDistance, typeMask, NULL, &hits);
+	return hits.size() - previousHits;
+}
+
+bool SpatialIndex::sphereCast(const Vector3 & origin, Real radius, const Vector3 & direction, Real maxDistance,
+	unsigned int typeMask, RayHit & hit) const
+{
+	return cast(origin, direction, radius, maxDistance, typeMask, &hit, NULL);
+}
+
+int SpatialIndex::sphereCastAll(const Vector3 & origin, Real radius, const Vector3 & direction, Real maxDistance,
+	unsigned int typeMask, std::vector<RayHit> & hits) const
+{
+	int previousHits = hits.size();
+	cast(origin, direction, radius, maxDistance, typeMask, NULL, &hits);
+	return hits.size() - previousHits;
+}
+
+Real SpatialIndex::boxSquaredDistance(const Node & node, const Vector3 & position)
+{
+	Real squaredDistance = 0;
+	for(int axis = 0; axis < 3; axis++) {
+		if(position[axis] < node.minimum[axis]) {
+			squaredDistance += Math::Sqr(node.minimum[axis] - position[axis]);
+		} else if(position[axis] > node.maximum[axis]) {
+			squaredDistance += Math::Sqr(position[axis] - node.maximum[axis]);
+		}
+	}
+	return squaredDistance;
+}
+
+int SpatialIndex::queryNearest(const Vector3 & position, int k, unsigned int typeMask, SpatialResult * results) const
+{
+	if(m_nodes.empty() || k <= 0) {
+		return 0;
+	}
+
+	int found = 0;
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while(stackSize > 0) {
+		const Node & node = m_nodes[stack[--stackSize]];
+		if((node.typeMask & typeMask) == 0) {
+			continue;
+		}
+
+		// Once k objects are found, only nodes which could hold a nearer one are visited
+		Real boxDistance = boxSquaredDistance(node, position);
+		if(found == k && boxDistance > Math::Sqr(results[k - 1].distance)) {
+			continue;
+		}
+
+		if(node.count == 0) {
+			int nearChild = node.first;
+			int farChild = node.first + 1;
+			if(boxSquaredDistance(m_nodes[farChild], position) < boxSquaredDistance(m_nodes[nearChild], position)) {
+				std::swap(nearChild, farChild);
+			}
+			stack[stackSize++] = farChild;
+			stack[stackSize++] = nearChild;
+			continue;
+		}
+
+		for(int i = node.first; i < node.first + node.count; i++) {
+			const SpatialEntry & entry = m_entries[i];
+			if((entry.typeBit & typeMask) == 0) {
+				continue;
+			}
+
+			Real distance = position.distance(entry.position) - entry.radius;
+			if(distance < 0) {
+				distance = 0;
+			}
+			if(found == k && distance >= results[k - 1].distance) {
+				continue;
+			}
+
+			// Insert into the sorted results, dropping the farthest if they are full
+			int slot = found < k ? found++ : k - 1;
+			while(slot > 0 && results[slot - 1].distance > distance) {
+				results[slot] = results[slot - 1];
+				slot--;
+			}
+			results[slot].object = entry.object;
+			results[slot].distance = distance;
+		}
+	}
+
+	return found;
+}
+
+int SpatialIndex::queryRadius(const Vector3 & position, Real radius, unsigned int typeMask, SpatialResult * results,
+	int maxResults) const
+{
+	if(m_nodes.empty()) {
+		return 0;
+	}
+
+	int found = 0;
+	Real squaredRadius = radius * radius;
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while(stackSize > 0) {
+		const Node & node = m_nodes[stack[--stackSize]];
+		if((node.typeMask & typeMask) == 0 || boxSquaredDistance(node, position) > squaredRadius) {
+			continue;
+		}
+
+		if(node.count == 0) {
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+			continue;
+		}
+
+		for(int i = node.first; i < node.first + node.count; i++) {
+			const SpatialEntry & entry = m_entries[i];
+			if((entry.typeBit & typeMask) == 0) {
+				continue;
+			}
+
+			Real distance = position.distance(entry.position) - entry.radius;
+			if(distance > radius) {
+				continue;
+			}
+
+			if(found < maxResults) {
+				results[found].object = entry.object;
+				results[found].distance = distance > 0 ? distance : 0;
+			}
+			found++;
+		}
+	}
+
+	return found;
+}
@@ -0,0 +1,196 @@
+#ifndef __SpatialIndex_h_
+#define __SpatialIndex_h_
+
+#include <vector>
+#include <OgreVector3.h>
+
+using namespace Ogre;
+
+class GameObject;
+
+/**
+ * A single sphere stored in a SpatialIndex, along with the object it represents
+ */
+struct SpatialEntry
+{
+	/** The center of the sphere */
+	Vector3 position;
+
+	/** The radius of the sphere */
+	Real radius;
+
+	/** The type mask bit of the object (1 << ObjectType) */
+	unsigned int typeBit;
+
+	/** The object represented by the sphere */
+	GameObject * object;
+
+	/** Constructor */
+	SpatialEntry(const Vector3 & position, Real radius, unsigned int typeBit, GameObject * object);
+};
+
+/**
+ * The result of a ray or sphere cast against a SpatialIndex
+ */
+struct RayHit
+{
+	/** The object which was hit */
+	GameObject * object;
+
+	/** The distance along the ray at which the object was hit */
+	Real distance;
+
+	/** The position of the ray (or the center of the cast sphere) at the hit */
+	Vector3 point;
+
+	/** Constructs an empty hit */
+	RayHit();
+
+	/** Constructor */
+	RayHit(GameObject * object, Real distance, const Vector3 & point);
+
+	/** @return True if this hit is nearer than the passed hit */
+	bool operator<(const RayHit & other) const;
+};
+
+/**
+ * An object found by a nearest or radius query against a SpatialIndex
+ */
+struct SpatialResult
+{
+	/** The object found */
+	GameObject * object;
+
+	/** The distance from the query position to the surface of the object (0 if inside) */
+	Real distance;
+};
+
+/**
+ * The SpatialIndex class is a bounding volume hierarchy over a set of spheres. Each
+ * node stores an axis aligned box enclosing its spheres and the union of their type
+ * masks, so queries can skip whole subtrees which are out of range or hold no objects
+ * of the requested types. When objects move the existing hierarchy is refit around
+ * their new positions, and it is only rebuilt when objects are added or removed.
+ */
+class SpatialIndex
+{
+private:
+	/** A node in the hierarchy. Leaves reference a range of entries, inner nodes two children. */
+	struct Node
+	{
+		/** The minimum corner of the node's bounding box */
+		Vector3 minimum;
+
+		/** The maximum corner of the node's bounding box */
+		Vector3 maximum;
+
+		/** The union of the type bits of all entries below the node */
+		unsigned int typeMask;
+
+		/** Index of the first entry (leaves) or of the first child (inner nodes) */
+		int first;
+
+		/** The number of entries in a leaf (0 for inner nodes) */
+		int count;
+	};
+
+	/** The maximum number of entries stored in a leaf */
+	static const int LEAF_SIZE = 4;
+
+	/** The entries indexed, ordered so that each leaf's entries are contiguous */
+	std::vector<SpatialEntry> m_entries;
+
+	/** The nodes of the hierarchy (the root is node 0) */
+	std::vector<Node> m_nodes;
+
+	/** Builds the subtree for the entries in the range [begin, end) into the passed node */
+	void buildNode(int nodeIndex, int begin, int end);
+
+	/** @return The distance along the ray to the box, or a negative value if it is missed */
+	static Real intersectBox(const Node & node, const Vector3 & origin, const Vector3 & invDirection,
+		Real inflate, Real maxDistance);
+
+	/** @return The squared distance from the passed position to the node's bounding box */
+	static Real boxSquaredDistance(const Node & node, const Vector3 & position);
+
+	/** @return The distance along the ray to the sphere, or a negative value if it is missed */
+	static Real intersectSphere(const SpatialEntry & entry, const Vector3 & origin, const Vector3 & direction,
+		Real inflate, Real maxDistance);
+
+	/**
+	 * Casts a sphere of the passed radius through the hierarchy. If hits is NULL, only
+	 * the nearest hit is found and stored in nearest.
+	 */
+	bool cast(const Vector3 & origin, const Vector3 & direction, Real radius, Real maxDistance,
+		unsigned int typeMask, RayHit * nearest, std::vector<RayHit> * hits) const;
+
+public:
+	/** Constructs an empty SpatialIndex */
+	SpatialIndex();
+
+	/** Removes all entries from the index */
+	void clear();
+
+	/** Adds an entry to the set which will be indexed by the next call to build() */
+	void add(const SpatialEntry & entry);
+
+	/** Builds the hierarchy over all added entries */
+	void build();
+
+	/** @return The number of entries in the index */
+	int size() const;
+
+	/** @return The entry at the passed index (entries are reordered by build()) */
+	const SpatialEntry & entry(int index) const;
+
+	/** Moves the sphere of the entry at the passed index (queries are inexact until refit()) */
+	void move(int index, const Vector3 & position, Real radius);
+
+	/**
+	 * Recomputes every node's bounding box from the current spheres of its entries, keeping
+	 * the hierarchy's structure. This is far cheaper than build(), and the boxes stay tight
+	 * while objects move coherently between changes to the entry set.
+	 */
+	void refit();
+
+	/**
+	 * Finds the first object of one of the masked types hit by a ray within maxDistance
+	 * @return True if an object was hit (stored in hit)
+	 */
+	bool raycast(const Vector3 & origin, const Vector3 & direction, Real maxDistance,
+		unsigned int typeMask, RayHit & hit) const;
+
+	/**
+	 * Finds all objects of the masked types hit by a ray within maxDistance, appending
+	 * them to hits in order of distance.
+	 * @return The number of hits found
+	 */
+	int raycastAll(const Vector3 & origin, const Vector3 & direction, Real maxDistance,
+		unsigned int typeMask, std::vector<RayHit> & hits) const;
+
+	/** @see SpatialIndex::raycast(), for a sphere of the passed radius swept along the ray */
+	bool sphereCast(const Vector3 & origin, Real radius, const Vector3 & direction, Real maxDistance,
+		unsigned int typeMask, RayHit & hit) const;
+
+	/** @see SpatialIndex::raycastAll(), for a sphere of the passed radius swept along the ray */
+	int sphereCastAll(const Vector3 & origin, Real radius, const Vector3 & direction, Real maxDistance,
+		unsigned int typeMask, std::vector<RayHit> & hits) const;
+
+	/**
+	 * Finds the k objects of the masked types nearest to the passed position (measured to
+	 * their surfaces), storing them in results in order of distance. results must have
+	 * room for k entries.
+	 * @return The number of objects found (at most k)
+	 */
+	int queryNearest(const Vector3 & position, int k, unsigned int typeMask, SpatialResult * results) const;
+
+	/**
+	 * Finds the objects of the masked types within radius of the passed position (measured
+	 * to their surfaces), storing up to maxResults of them in results in no particular order.
+	 * @return The number of objects found, which may exceed maxResults
+	 */
+	int queryRadius(const Vector3 & position, Real radius, unsigned int typeMask, SpatialResult * results,
+		int maxResults) const;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "TimingWheel.h"
+#include <algorithm>
+
+// ========================================================================
+// TimerEvent Implementation
+// ========================================================================
+TimerEvent::TimerEvent() : time(0), type(0), id(0), object(NULL), sequence(0)
+{
+}
+
+TimerEvent::TimerEvent(double time, int type, unsigned long long id, void * object, unsigned long sequence)
+	: time(time), type(type), id(id), object(object), sequence(sequence)
+{
+}
+
+bool TimerEvent::operator<(const TimerEvent & other) const
+{
+	if(time != other.time) {
+		return time < other.time;
+	}
+	return sequence < other.sequence;
+}
+
+
+// ========================================================================
+// TimingWheel Implementation
+// ========================================================================
+TimingWheel::TimingWheel(Real tickLength) : m_tickLength(tickLength), m_currentTick(0),
+	m_nextSequence(0), m_size(0), m_pending()
+{
+	m_slots[0].resize(1 << ROOT_BITS);
+	for(int level = 1; level < LEVELS; level++) {
+		m_slots[level].resize(1 << LEVEL_BITS);
+	}
+}
+
+unsigned long long TimingWheel::tickOf(double time) const
+{
+	if(time <= 0) {
+		return 0;
+	}
+	return (unsigned long long)(time / m_tickLength);
+}
+
+int TimingWheel::levelShift(int level)
+{
+	return level == 0 ? 0 : ROOT_BITS + (level - 1) * LEVEL_BITS;
+}
+
+void TimingWheel::insert(const TimerEvent & event)
+{
+	unsigned long long tick = tickOf(event.time);
+	if(tick <= m_currentTick) {
+		// The event's slot has already been emptied
+		m_pending.push_back(event);
+		return;
+	}
+
+	// Find the finest ring which reaches the event (events beyond the coarsest ring
+	// are placed at its far end, and placed again when they are moved down)
+	unsigned long long delta = tick - m_currentTick;
+	int level = 0;
+	while(level < LEVELS - 1 && delta >= (1ULL << levelShift(level + 1))) {
+		level++;
+	}
+
+	unsigned long long maxDelta = (1ULL << (levelShift(LEVELS - 1) + LEVEL_BITS)) - 1;
+	if(delta > maxDelta) {
+		tick = m_currentTick + maxDelta;
+	}
+
+	int slotMask = (int)m_slots[level].size() - 1;
+	m_slots[level][(tick >> levelShift(level)) & slotMask].push_back(event);
+}
+
+void TimingWheel::cascade(int level)
+{
+	int slotMask = (int)m_slots[level].size() - 1;
+	std::vector<TimerEvent> events;
+	events.swap(m_slots[level][(m_currentTick >> levelShift(level)) & slotMask]);
+	for(std::vector<TimerEvent>::iterator eventIter = events.begin();
+		eventIter != events.end();
+		eventIter++)
+	{
+		insert(*eventIter);
+	}
+}
+
+void TimingWheel::schedule(double time, int type, unsigned long long id, void * object)
+{
+	insert(TimerEvent(time, type, id, object, m_nextSequence++));
+	m_size++;
+}
+
+int TimingWheel::advance(double time, std::vector<TimerEvent> & fired)
+{
+	unsigned long long targetTick = tickOf(time);
+	while(m_currentTick < targetTick) {
+		m_currentTick++;
+
+		// Move events down from each coarser ring whose slot has just been reached
+		for(int level = 1; level < LEVELS; level++) {
+			if((m_currentTick & ((1ULL << levelShift(level)) - 1)) != 0) {
+				break;
+			}
+			cascade(level);
+		}
+
+		std::vector<TimerEvent> & slot = m_slots[0][m_currentTick & ((1 << ROOT_BITS) - 1)];
+		m_pending.insert(m_pending.end(), slot.begin(), slot.end());
+		slot.clear();
+	}
+
+	// Fire the events which are due, keeping those later in the current tick
+	int firstFired = fired.size();
+	int kept = 0;
+	for(unsigned int i = 0; i < m_pending.size(); i++) {
+		if(m_pending[i].time <= time) {
+			fired.push_back(m_pending[i]);
+		} else {
+			m_pending[kept++] = m_pending[i];
+		}
+	}
+	m_pending.resize(kept);
+
+	std::sort(fired.begin() + firstFired, fired.end());
+	m_size -= fired.size() - firstFired;
+	return fired.size() - firstFired;
+}
+
+int TimingWheel::size() const
+{
+	return m_size;
+}
+
+Real TimingWheel::tickLength() const
+{
+	return m_tickLength;
+}
+
+void TimingWheel::clear()
+{
+	for(int level = 0; level < LEVELS; level++) {
+		for(unsigned int slot = 0; slot < m_slots[level].size(); slot++) {
+			m_slots[level][slot].clear();
+		}
+	}
+	m_pending.clear();
+	m_size = 0;
+}
+
+void TimingWheel::reset(double time)
+{
+	clear();
+	m_currentTick = tickOf(time);
+}
+
+int TimingWheel::pending(std::vector<TimerEvent> & events) const
+{
+	int first = events.size();
+	for(int level = 0; level < LEVELS; level++) {
+		for(unsigned int slot = 0; slot < m_slots[level].size(); slot++) {
+			events.insert(events.end(), m_slots[level][slot].begin(), m_slots[level][slot].end());
+		}
+	}
+	events.insert(events.end(), m_pending.begin(), m_pending.end());
+
+	std::sort(events.begin() + first, events.end());
+	return events.size() - first;
+}
@@ -0,0 +1,129 @@
+#ifndef __TimingWheel_h_
+#define __TimingWheel_h_
+
+#include <vector>
+#include <OgrePrerequisites.h>
+
+using namespace Ogre;
+
+/**
+ * A timed event stored in a TimingWheel. The wheel only orders events, the meaning of
+ * the type, id and object is left to its owner.
+ */
+struct TimerEvent
+{
+	/** The time at which the event is due */
+	double time;
+
+	/** What the event does */
+	int type;
+
+	/** Identifies the event's target */
+	unsigned long long id;
+
+	/** The event's target (may be NULL) */
+	void * object;
+
+	/** The order the event was scheduled in (breaks ties between events due at the same time) */
+	unsigned long sequence;
+
+	/** Constructs an empty event */
+	TimerEvent();
+
+	/** Constructor */
+	TimerEvent(double time, int type, unsigned long long id, void * object, unsigned long sequence);
+
+	/** @return True if this event is due before the passed event */
+	bool operator<(const TimerEvent & other) const;
+};
+
+/**
+ * The TimingWheel class schedules timed events in a hierarchy of slot rings, so that
+ * advancing time only touches the events which are due (and, occasionally, moves a
+ * batch of events down from a coarser ring) rather than every scheduled event.
+ *
+ * The finest ring has one slot per tick, and each coarser ring has one slot per full
+ * turn of the ring below it. Events are placed in the finest ring which covers their due
+ * time, and are moved down a ring when time reaches their slot. Events are never removed
+ * once scheduled, so owners cancel events by ignoring them when they fire.
+ */
+class TimingWheel
+{
+private:
+	/** The number of rings */
+	static const int LEVELS = 4;
+
+	/** log2 of the number of slots in the finest ring */
+	static const int ROOT_BITS = 8;
+
+	/** log2 of the number of slots in each coarser ring */
+	static const int LEVEL_BITS = 6;
+
+	/** The length of a tick (in the same units as event times) */
+	Real m_tickLength;
+
+	/** The last tick whose slot has been emptied */
+	unsigned long long m_currentTick;
+
+	/** The sequence number given to the next event scheduled */
+	unsigned long m_nextSequence;
+
+	/** The number of events scheduled which have not yet fired */
+	int m_size;
+
+	/** The slots of each ring */
+	std::vector<std::vector<TimerEvent> > m_slots[LEVELS];
+
+	/** Events from slots which have been emptied, but which are not yet due */
+	std::vector<TimerEvent> m_pending;
+
+	/** @return The tick containing the passed time */
+	unsigned long long tickOf(double time) const;
+
+	/** @return The number of bits of a tick below the passed ring's slot index */
+	static int levelShift(int level);
+
+	/** Places an event in the slot covering its due time */
+	void insert(const TimerEvent & event);
+
+	/** Moves every event in the passed ring's current slot down to finer rings */
+	void cascade(int level);
+
+public:
+	/** Constructs an empty TimingWheel with the passed tick length */
+	TimingWheel(Real tickLength);
+
+	/** Schedules an event, due at the passed time */
+	void schedule(double time, int type, unsigned long long id, void * object);
+
+	/**
+	 * Advances the wheel to the passed time, appending every event due by then to fired
+	 * in the order they are due (events due at the same time in the order they were scheduled)
+	 * @return The number of events fired
+	 */
+	int advance(double time, std::vector<TimerEvent> & fired);
+
+	/** @return The number of events scheduled which have not yet fired */
+	int size() const;
+
+	/** @return The length of a tick */
+	Real tickLength() const;
+
+	/** Removes all scheduled events */
+	void clear();
+
+	/**
+	 * Removes all scheduled events, and moves the wheel to the passed time (as if it had
+	 * been advanced to it). Events scheduled afterwards keep the order they are scheduled in.
+	 */
+	void reset(double time);
+
+	/**
+	 * Appends every event which has been scheduled but not yet fired to events, in the
+	 * order they are due
+	 * @return The number of events appended
+	 */
+	int pending(std::vector<TimerEvent> & events) const;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "WorkerPool.h"
+
+// ========================================================================
+// WorkerPool Implementation
+// ========================================================================
+WorkerPool::WorkerPool(int numThreads)
+	: m_threads(), m_mutex(), m_workAvailable(), m_workDone(), mp_task(NULL), m_taskSize(0),
+	m_grainSize(1), m_nextIndex(0), m_remaining(0), m_generation(0), m_shutdown(false)
+{
+	if(numThreads < 0) {
+		numThreads = (int)boost::thread::hardware_concurrency() - 1;
+	}
+
+	for(int i = 0; i < numThreads; i++) {
+		m_threads.create_thread(boost::bind(&WorkerPool::workerLoop, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_workAvailable.notify_all();
+	m_threads.join_all();
+}
+
+int WorkerPool::concurrency() const
+{
+	return (int)m_threads.size() + 1;
+}
+
+void WorkerPool::workerLoop()
+{
+	unsigned int lastGeneration = 0;
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+
+	while(true) {
+		while(!m_shutdown && (mp_task == NULL || m_generation == lastGeneration)) {
+			m_workAvailable.wait(lock);
+		}
+
+		if(m_shutdown) {
+			return;
+		}
+
+		lastGeneration = m_generation;
+		runChunks(lock);
+	}
+}
+
+void WorkerPool::runChunks(boost::unique_lock<boost::mutex>& lock)
+{
+	while(mp_task != NULL && m_nextIndex < m_taskSize) {
+		WorkerTask * task = mp_task;
+		int begin = m_nextIndex;
+		int end = begin + m_grainSize < m_taskSize ? begin + m_grainSize : m_taskSize;
+		m_nextIndex = end;
+
+		lock.unlock();
+		task->run(begin, end);
+		lock.lock();
+
+		m_remaining -= (end - begin);
+		if(m_remaining == 0) {
+			mp_task = NULL;
+			m_workDone.notify_all();
+		}
+	}
+}
+
+void WorkerPool::parallelFor(WorkerTask& task, int count, int grainSize)
+{
+	if(count <= 0) {
+		return;
+	}
+
+	if(grainSize < 1) {
+		grainSize = 1;
+	}
+
+	// Not worth waking the workers for a single chunk
+	if(m_threads.size() == 0 || count <= grainSize) {
+		task.run(0, count);
+		return;
+	}
+
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+	mp_task = &task;
+	m_taskSize = count;
+	m_grainSize = grainSize;
+	m_nextIndex = 0;
+	m_remaining = count;
+	m_generation++;
+	m_workAvailable.notify_all();
+
+	runChunks(lock);
+	while(m_remaining > 0) {
+		m_workDone.wait(lock);
+	}
+}
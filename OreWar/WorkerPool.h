@@ -0,0 +1,120 @@
+#ifndef __WorkerPool_h_
+#define __WorkerPool_h_
+
+#include <boost/thread.hpp>
+
+/**
+ * Interface for work which can be split into independent index ranges and
+ * executed in parallel by a WorkerPool.
+ */
+class WorkerTask
+{
+public:
+	/** Destructor */
+	virtual ~WorkerTask() {}
+
+	/** Processes all indices in the range [begin, end) */
+	virtual void run(int begin, int end) = 0;
+};
+
+
+/**
+ * Adapts a member function taking an index range into a WorkerTask, so that
+ * classes can run their own private methods on a WorkerPool.
+ */
+template <class T>
+class MemberTask : public WorkerTask
+{
+private:
+	/** The object the member function should be called on */
+	T * mp_object;
+
+	/** The member function which processes a range of indices */
+	void (T::*mp_function)(int, int);
+
+public:
+	/** Constructor */
+	MemberTask(T * object, void (T::*function)(int, int)) : mp_object(object), mp_function(function)
+	{
+	}
+
+	/** @see WorkerTask::run() */
+	virtual void run(int begin, int end)
+	{
+		(mp_object->*mp_function)(begin, end);
+	}
+};
+
+
+/**
+ * The WorkerPool class maintains a fixed set of worker threads which cooperatively
+ * execute WorkerTasks. The thread calling parallelFor() participates in the work,
+ * and does not return until every index of the task has been processed.
+ */
+class WorkerPool
+{
+private:
+	/** The worker threads owned by the pool */
+	boost::thread_group m_threads;
+
+	/** Guards all task state below */
+	boost::mutex m_mutex;
+
+	/** Signalled when a new task is posted or the pool is shutting down */
+	boost::condition_variable m_workAvailable;
+
+	/** Signalled when the last chunk of the current task has been completed */
+	boost::condition_variable m_workDone;
+
+	/** The task currently being executed (NULL if idle) */
+	WorkerTask * mp_task;
+
+	/** The number of indices in the current task */
+	int m_taskSize;
+
+	/** The number of indices claimed by a thread at a time */
+	int m_grainSize;
+
+	/** The first index of the current task which has not yet been claimed */
+	int m_nextIndex;
+
+	/** The number of indices of the current task which have not yet been completed */
+	int m_remaining;
+
+	/** Incremented every time a task is posted, so sleeping workers can detect new work */
+	unsigned int m_generation;
+
+	/** Set to true when the pool is being destroyed */
+	bool m_shutdown;
+
+	/** Main loop for each worker thread */
+	void workerLoop();
+
+	/** 
+	 * Claims and runs chunks of the current task until none remain.
+	 * Must be called with the lock held, which is released while chunks are run.
+	 */
+	void runChunks(boost::unique_lock<boost::mutex>& lock);
+
+public:
+	/** 
+	 * Constructs a pool with the specified number of worker threads. If numThreads is
+	 * negative, one thread is created for every hardware thread besides the caller's.
+	 */
+	WorkerPool(int numThreads);
+
+	/** Deconstructor, joins all worker threads */
+	~WorkerPool();
+
+	/** @return The number of threads which execute tasks (including the calling thread) */
+	int concurrency() const;
+
+	/**
+	 * Runs the passed task over the index range [0, count), split into chunks of at
+	 * most grainSize indices. Ranges are processed in no particular order, so each index
+	 * must be independent of the others. Returns once every index has been processed.
+	 */
+	void parallelFor(WorkerTask& task, int count, int grainSize);
+};
+
+#endif
@@ -0,0 +1,361 @@
+#include <OgreTimer.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "GameObjects.h"
+#include "ArenaSerializer.h"
+#include "InputRecording.h"
+
+using namespace Ogre;
+
+/**
+ * Headless benchmark for GameArena::updatePhysics(). Each scenario preset builds an
+ * arena, runs a number of untimed warmup ticks, then times a fixed number of ticks and
+ * reports the average nanoseconds per tick for each update phase as one CSV row.
+ *
+ * With --record, a single scenario is flown by a scripted pilot and its input saved (see
+ * InputRecording). With --replay, a recording (from --record, or a session recorded by the
+ * game) is played back at full speed, and checked against the state it was recorded with,
+ * so any change which breaks determinism or slows a real session down shows up here.
+ *
+ * Usage: OreWarBench [--scenario name|all] [--ticks n] [--seed n] [--step seconds] [--list]
+ *                    [--record file] [--replay file]
+ */
+
+/** Length of a simulated tick (in seconds) unless overridden with --step */
+const Real DEFAULT_STEP = 1.0f / 60.0f;
+
+/** Names of the update phases, as used in the CSV header */
+const char * PHASE_NAMES[NUM_UPDATE_PHASES] = { "constrained", "integration", "orbits", "components",
+	"constraints", "collisions", "contacts", "cleanup" };
+
+/** Adds the player's ship (every scenario has one, as GameArena::updatePhysics() requires it) */
+void addPlayerShip(GameArena & arena)
+{
+	SpaceShip playerShip = SpaceShip(ObjectType::SHIP, 1, Vector3(20000, 40000, 20000), 15, arena.memoryManager());
+	playerShip.addPlasmaCannon(PlasmaCannon(arena.memoryManager()));
+	playerShip.addAnchorLauncher(AnchorLauncher(arena.memoryManager()));
+	arena.setPlayerShip(playerShip);
+}
+
+/** A single solar system with 5 NPC ships */
+void setupSolarSystem(GameArena & arena)
+{
+	arena.generateSolarSystem();
+	addPlayerShip(arena);
+	arena.npcShipTarget(5);
+}
+
+/** The game's galaxy, whose systems are generated as the player reaches them */
+void setupGalaxy(GameArena & arena)
+{
+	arena.generateGalaxy(Galaxy::DEFAULT_SECTORS_PER_SIDE, Galaxy::DEFAULT_SECTOR_SIZE, Galaxy::DEFAULT_DENSITY);
+	addPlayerShip(arena);
+	arena.npcShipTarget(5);
+}
+
+/** A solar system with 1000 NPC ships */
+void setupNpcShips(GameArena & arena)
+{
+	arena.generateSolarSystem();
+	addPlayerShip(arena);
+	arena.npcShipTarget(1000);
+}
+
+/** A solar system with 10000 long lived projectiles spread through the arena */
+void setupProjectiles(GameArena & arena)
+{
+	arena.generateSolarSystem();
+	addPlayerShip(arena);
+	arena.npcShipTarget(5);
+
+	RandomStream random(1, 0);
+	for(int i = 0; i < 10000; i++) {
+		Real x = random.rangeRandom(-100000, 100000);
+		Real y = random.rangeRandom(-100000, 100000);
+		Real z = random.rangeRandom(-100000, 100000);
+		SphereCollisionObject projectilePhysics = SphereCollisionObject(75, 1, Vector3(x, y, z));
+
+		x = random.rangeRandom(-12000, 12000);
+		y = random.rangeRandom(-12000, 12000);
+		z = random.rangeRandom(-12000, 12000);
+		projectilePhysics.velocity(Vector3(x, y, z));
+		arena.addProjectile(Projectile(projectilePhysics, ObjectType::PROJECTILE, 35, 1000, arena.memoryManager()));
+	}
+}
+
+/** A solar system in which every planet and moon detonates on the first tick */
+void setupDetonation(GameArena & arena)
+{
+	arena.generateSolarSystem();
+	addPlayerShip(arena);
+	arena.npcShipTarget(5);
+
+	for(std::vector<CelestialBody * >::iterator bodyIter = arena.bodies()->begin();
+		bodyIter != arena.bodies()->end();
+		bodyIter++)
+	{
+		if((*bodyIter)->type() != STAR) {
+			(*bodyIter)->inflictDamage((*bodyIter)->health() + 1);
+		}
+	}
+}
+
+/** A benchmark scenario preset */
+struct Scenario
+{
+	/** The name used to select the scenario */
+	const char * name;
+
+	/** Populates an empty arena */
+	void (*setup)(GameArena & arena);
+
+	/** Untimed ticks run before measurement (0 to time the scenario from its first tick) */
+	int warmupTicks;
+
+	/** The number of ticks timed by default */
+	int ticks;
+};
+
+const Scenario SCENARIOS[] = {
+	{ "solar_system", setupSolarSystem, 60, 1200 },
+	{ "galaxy", setupGalaxy, 60, 1200 },
+	{ "npc_1k", setupNpcShips, 60, 600 },
+	{ "projectiles_10k", setupProjectiles, 10, 300 },
+	{ "mass_detonation", setupDetonation, 0, 300 }
+};
+
+const int NUM_SCENARIOS = sizeof(SCENARIOS) / sizeof(Scenario);
+
+/** The number of ticks the scripted pilot of a recording holds each set of controls */
+const int PILOT_HOLD_TICKS = 30;
+
+/**
+ * @return The named scenario (NULL if there is none). The game's sessions are recorded with
+ *         the setup "game", which populates the arena just as the galaxy scenario does.
+ */
+const Scenario * findScenario(const char * name)
+{
+	if(strcmp(name, "game") == 0) {
+		name = "galaxy";
+	}
+	for(int i = 0; i < NUM_SCENARIOS; i++) {
+		if(strcmp(name, SCENARIOS[i].name) == 0) {
+			return &SCENARIOS[i];
+		}
+	}
+	return NULL;
+}
+
+/** @return The size of the named file in bytes (0 if it can't be read) */
+long fileSize(const char * fileName)
+{
+	FILE * file = fopen(fileName, "rb");
+	if(file == NULL) {
+		return 0;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+/** Runs a scenario, and prints its results as a CSV row */
+void runScenario(const Scenario & scenario, unsigned long long seed, int ticks, Real step)
+{
+	GameArena * arena = new GameArena(200000, 2048, 10);
+	arena->seed(seed);
+	arena->fixedStep(step);
+	scenario.setup(*arena);
+
+	for(int i = 0; i < scenario.warmupTicks; i++) {
+		arena->update(step);
+	}
+
+	arena->resetProfile();
+	arena->profiling(true);
+	Timer timer;
+	timer.reset();
+	for(int i = 0; i < ticks; i++) {
+		arena->update(step);
+	}
+	unsigned long totalTime = timer.getMicroseconds();
+	arena->profiling(false);
+
+	// The total covers all of update(), so it also includes spawning NPC ships and
+	// applying player input on top of the profiled phases
+	unsigned long updates = arena->profiledUpdates() > 0 ? arena->profiledUpdates() : 1;
+	printf("%s,%llu,%d,%f,%d,%d,%d,%d,%.0f", scenario.name, seed, ticks, step,
+		(int)arena->npcShips()->size(), (int)arena->projectiles()->size(), (int)arena->bodies()->size(),
+		(int)arena->constraints()->size(), totalTime * 1000.0 / updates);
+	for(int phase = 0; phase < NUM_UPDATE_PHASES; phase++) {
+		printf(",%.0f", arena->phaseTime((UpdatePhase)phase) * 1000.0 / updates);
+	}
+	printf("\n");
+	fflush(stdout);
+
+	delete arena;
+}
+
+/**
+ * Runs a scenario flown by a scripted pilot, and saves its input to the named file
+ * @return The process exit code
+ */
+int recordScenario(const Scenario & scenario, unsigned long long seed, int ticks, Real step, const char * fileName)
+{
+	GameArena * arena = new GameArena(200000, 2048, 10);
+	arena->seed(seed);
+	arena->fixedStep(step);
+	scenario.setup(*arena);
+
+	InputRecording recording;
+	recording.begin(*arena, scenario.name);
+	arena->recordInput(&recording);
+
+	// The pilot picks new controls (and turns) every PILOT_HOLD_TICKS
+	RandomStream pilot(seed, 2);
+	PlayerInput input;
+	for(int i = 0; i < ticks; i++) {
+		if(i % PILOT_HOLD_TICKS == 0) {
+			input.controls(pilot.next());
+			input.pitch = pilot.rangeRandom(-0.05f, 0.05f);
+			input.yaw = pilot.rangeRandom(-0.05f, 0.05f);
+		} else {
+			input.pitch = 0;
+			input.yaw = 0;
+		}
+		arena->step(input);
+	}
+
+	arena->recordInput(NULL);
+	recording.end(*arena);
+	std::vector<char> state;
+	ArenaSerializer::save(*arena, state);
+	delete arena;
+
+	if(!recording.save(fileName)) {
+		fprintf(stderr, "Could not write the recording '%s'\n", fileName);
+		return 1;
+	}
+
+	printf("setup,seed,steps,step,replay_bytes,state_bytes,checksum\n");
+	printf("%s,%llu,%d,%f,%ld,%d,%016llx\n", scenario.name, seed, recording.numSteps(), step,
+		fileSize(fileName), (int)state.size(), recording.checksum());
+	return 0;
+}
+
+/**
+ * Plays back the named recording at full speed, and checks the arena ends in the recorded state
+ * @return The process exit code (1 if the state differs)
+ */
+int replayRecording(const char * fileName)
+{
+	InputRecording recording;
+	if(!recording.load(fileName)) {
+		fprintf(stderr, "Could not read the recording '%s'\n", fileName);
+		return 1;
+	}
+
+	const Scenario * scenario = findScenario(recording.setup().c_str());
+	if(scenario == NULL) {
+		fprintf(stderr, "The recording's setup '%s' is not a known scenario\n", recording.setup().c_str());
+		return 1;
+	}
+
+	GameArena * arena = new GameArena(recording.config().size, 2048, 10);
+	recording.configure(*arena);
+	scenario->setup(*arena);
+
+	Timer timer;
+	timer.reset();
+	for(int i = 0; i < recording.numSteps(); i++) {
+		arena->step(recording.input(i));
+	}
+	unsigned long totalTime = timer.getMicroseconds();
+
+	unsigned long long checksum = InputRecording::checksum(*arena);
+	bool matched = recording.checksum() == 0 || checksum == recording.checksum();
+	delete arena;
+
+	printf("setup,seed,steps,total_us,steps_per_sec,checksum,match\n");
+	printf("%s,%llu,%d,%lu,%.0f,%016llx,%s\n", recording.setup().c_str(), recording.config().seed,
+		recording.numSteps(), totalTime, recording.numSteps() * 1000000.0 / (totalTime > 0 ? totalTime : 1),
+		checksum, recording.checksum() == 0 ? "unchecked" : (matched ? "yes" : "no"));
+	fflush(stdout);
+	return matched ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char * scenarioName = "all";
+	int ticks = 0;
+	unsigned long long seed = 1;
+	Real step = DEFAULT_STEP;
+	const char * recordFile = NULL;
+	const char * replayFile = NULL;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--list") == 0) {
+			for(int j = 0; j < NUM_SCENARIOS; j++) {
+				printf("%s\n", SCENARIOS[j].name);
+			}
+			return 0;
+		} else if(strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+			scenarioName = argv[++i];
+		} else if(strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+			ticks = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			// strtoul is only 32 bits on Win32, which would truncate the seed
+#ifdef _MSC_VER
+			seed = _strtoui64(argv[++i], NULL, 10);
+#else
+			seed = strtoull(argv[++i], NULL, 10);
+#endif
+		} else if(strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+			step = (Real)atof(argv[++i]);
+		} else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			recordFile = argv[++i];
+		} else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replayFile = argv[++i];
+		} else {
+			fprintf(stderr, "Usage: %s [--scenario name|all] [--ticks n] [--seed n] [--step seconds] [--list]\n"
+				"       [--record file] [--replay file]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if(replayFile != NULL) {
+		return replayRecording(replayFile);
+	}
+
+	if(recordFile != NULL) {
+		const Scenario * scenario = findScenario(scenarioName);
+		if(scenario == NULL) {
+			fprintf(stderr, "--record needs a single scenario (use --list to see all scenarios)\n");
+			return 1;
+		}
+		return recordScenario(*scenario, seed, ticks > 0 ? ticks : scenario->ticks, step, recordFile);
+	}
+
+	// Header row, times are average nanoseconds per tick
+	printf("scenario,seed,ticks,step,npc_ships,projectiles,bodies,constraints,total_ns");
+	for(int phase = 0; phase < NUM_UPDATE_PHASES; phase++) {
+		printf(",%s_ns", PHASE_NAMES[phase]);
+	}
+	printf("\n");
+
+	bool foundScenario = false;
+	for(int i = 0; i < NUM_SCENARIOS; i++) {
+		if(strcmp(scenarioName, "all") == 0 || strcmp(scenarioName, SCENARIOS[i].name) == 0) {
+			runScenario(SCENARIOS[i], seed, ticks > 0 ? ticks : SCENARIOS[i].ticks, step);
+			foundScenario = true;
+		}
+	}
+
+	if(!foundScenario) {
+		fprintf(stderr, "Unknown scenario '%s' (use --list to see all scenarios)\n", scenarioName);
+		return 1;
+	}
+
+	return 0;
+}